@@ -0,0 +1,56 @@
+// Assembly emission: time of compile_program writing the NASM text of an
+// optimized module, and how much the peak RSS grows while it runs, the
+// output goes through the sink so it should stay near its buffer.
+//
+// usage: bench/codegen_bench <file> <output asm>
+// Run from the root of the repository, where std/ and builtin/ are.
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "compiler.hpp"
+#include "inliner.hpp"
+#include "ir_builder.hpp"
+#include "optimizer.hpp"
+#include "parser.hpp"
+#include "preprocessor.hpp"
+#include "token_cache.hpp"
+
+static long peak_rss_kb() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "Syntax: " << argv[0] << " <file> <output asm>" << std::endl;
+		return 1;
+	}
+	TokenCache::set_directory("");
+
+	std::vector<Token> tokens;
+	Preprocessor::preprocess_includes(argv[1], tokens);
+	std::unique_ptr<Lexer> lexer = std::make_unique<Lexer>();
+	lexer->set_tokens(std::move(tokens));
+	Ast ast = Parser(std::move(lexer)).parse_code();
+	IrModule module = IrBuilder(ast).build();
+	Optimizer(module, {.stats = false, .inline_threshold = DEFAULT_INLINE_THRESHOLD, .inline_report = false}).optimize();
+
+	long rss_before = peak_rss_kb();
+	auto start = std::chrono::steady_clock::now();
+	{
+		Compiler compiler = Compiler(module);
+		OutputSink out(argv[2]);
+		compiler.compile_program(out);
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	long rss_after = peak_rss_kb();
+
+	struct stat st;
+	stat(argv[2], &st);
+	std::cout << "codegen: " << st.st_size / 1e6 << " MB of assembly, " << elapsed * 1e3 << " ms, peak RSS " << rss_before / 1024 << " MB before and " << rss_after / 1024 << " MB after" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+# Synthetic akalang programs for the benchmarks on bench/, every program is
+# valid and the same arguments always generate the same text.
+#
+# usage: bench/generate.py <generator> <arguments...>
+# functions <count>                    large module of loops, conditions and
+#                                      calls on stdout
+# includes <modules> <directory>        include graph, root.aka includes the
+#                                      last modules and every module up to 8
+#                                      earlier ones, run it from directory
+# includes_mixed <modules> <directory>  same graph, every module is spelled
+#                                      in three different ways
+# expressions <count>                  functions of random expressions over
+#                                      every operator on stdout
+# nested <depth> <functions>           functions nesting while and if blocks
+#                                      alternately depth levels on stdout
+
+import os
+import random
+import sys
+
+# modules included by root.aka and by every module at most
+ROOT_INCLUDES = 40
+MODULE_INCLUDES = 8
+MODULE_FUNCTIONS = 10
+
+BINARY_OPERATORS = ['||', '&&', '|', '^', '&', '==', '!=', '<', '>', '<=', '>=', '<<', '>>', '+', '-', '*', '/', '%']
+UNARY_OPERATORS = ['-', '~']
+# operators nested in every expression at most
+EXPRESSION_DEPTH = 4
+
+
+def functions(count):
+	count = int(count)
+	out = ['include "std/stdio.aka";', '']
+	for i in range(count):
+		out.append('function func_%d(arg_a: int, arg_b: *char) -> int {' % i)
+		out.append('\tvar counter_%d: int = 0;' % i)
+		out.append('\tvar limit: int = arg_a * 3 + 17;')
+		out.append('\twhile counter_%d < limit {' % i)
+		out.append('\t\tif counter_%d %% 7 == 3 {' % i)
+		out.append('\t\t\tcounter_%d = counter_%d + 2;' % (i, i))
+		out.append('\t\t} else {')
+		out.append('\t\t\tcounter_%d = counter_%d + 1;' % (i, i))
+		out.append('\t\t}')
+		out.append('\t}')
+		out.append('\tvar msg: *char = "generated string literal number %d with padding text";' % i)
+		if i > 0:
+			out.append('\tcounter_%d = counter_%d + func_%d(arg_a - 1, msg);' % (i, i, i - 1))
+		out.append('\treturn counter_%d / 2;' % i)
+		out.append('}')
+		out.append('')
+	out.append('function main() -> int {')
+	out.append('\tprintint(func_%d(3, "x"));' % (count - 1))
+	out.append('\tputs("\\n");')
+	out.append('\treturn 0;')
+	out.append('}')
+	print('\n'.join(out))
+
+
+def write_includes(modules, directory, spellings):
+	random.seed(modules)
+	os.makedirs(os.path.join(directory, 'inc'), exist_ok=True)
+	for i in range(modules):
+		out = []
+		for k in sorted(random.sample(range(i), min(i, MODULE_INCLUDES))):
+			out.append('include "%s";' % spellings[(i + k) % len(spellings)] % k)
+		for f in range(MODULE_FUNCTIONS):
+			out.append('function mod_%d_fn_%d(a: int) -> int {' % (i, f))
+			out.append('\tvar b: int = a * %d + 1;' % f)
+			out.append('\treturn b;')
+			out.append('}')
+		with open(os.path.join(directory, 'inc', 'mod_%d.aka' % i), 'w') as file:
+			file.write('\n'.join(out) + '\n')
+
+	out = ['include "%s";' % spellings[0] % k for k in range(max(0, modules - ROOT_INCLUDES), modules)]
+	out.append('function main() -> int {')
+	out.append('\treturn 0;')
+	out.append('}')
+	with open(os.path.join(directory, 'root.aka'), 'w') as file:
+		file.write('\n'.join(out) + '\n')
+
+
+def includes(modules, directory):
+	write_includes(int(modules), directory, ['inc/mod_%d.aka'])
+
+
+def includes_mixed(modules, directory):
+	write_includes(int(modules), directory, ['inc/mod_%d.aka', './inc/mod_%d.aka', 'inc/../inc/mod_%d.aka'])
+
+
+def expression(depth):
+	if depth == 0 or random.random() < 0.2:
+		return random.choice(['a', 'b', 'c', str(random.randint(1, 999))])
+	if random.random() < 0.1:
+		return random.choice(UNARY_OPERATORS) + '(' + expression(depth - 1) + ')'
+	text = expression(depth - 1) + ' ' + random.choice(BINARY_OPERATORS) + ' ' + expression(depth - 1)
+	return '(' + text + ')' if random.random() < 0.2 else text
+
+
+def expressions(count):
+	count = int(count)
+	random.seed(count)
+	out = []
+	for i in range(count):
+		out.append('function e_%d(a: int, b: int, c: int) -> int {' % i)
+		for k in range(8):
+			out.append('\tvar v%d: int = %s;' % (k, expression(EXPRESSION_DEPTH)))
+		out.append('\treturn v0 + v1 * v2 - v3 + v4 * v5 - v6 + v7;')
+		out.append('}')
+		out.append('')
+	out.append('function main() -> int {')
+	out.append('\treturn 0;')
+	out.append('}')
+	print('\n'.join(out))
+
+
+def nested(depth, functions):
+	depth = int(depth)
+	functions = int(functions)
+	out = ['include "std/stdio.aka";', '']
+	for f in range(functions):
+		out.append('function f%d(n: int) -> int {' % f)
+		out.append('\tvar s: int = 0;')
+		for d in range(depth):
+			indent = '\t' * (d + 1)
+			if d % 2 == 0:
+				out.append(indent + 'var i%d: int = 0;' % d)
+				out.append(indent + 'while i%d < n {' % d)
+			else:
+				out.append(indent + 'if (s + %d) %% 3 == 0 {' % d)
+		for d in reversed(range(depth)):
+			indent = '\t' * (d + 1)
+			if d % 2 == 0:
+				out.append(indent + '\ts = s + i%d;' % d)
+				out.append(indent + '\ti%d = i%d + 1;' % (d, d))
+				out.append(indent + '}')
+			else:
+				out.append(indent + '} else {')
+				out.append(indent + '\ts = s + 1;')
+				out.append(indent + '}')
+		out.append('\treturn s;')
+		out.append('}')
+		out.append('')
+	out.append('function main() -> int {')
+	out.append('\tvar t: int = 0;')
+	for f in range(functions):
+		out.append('\tt = t + f%d(2);' % f)
+	out.append('\tprintint(t);')
+	out.append('\tputs("\\n");')
+	out.append('\treturn 0;')
+	out.append('}')
+	print('\n'.join(out))
+
+
+generators = {
+	'functions': (functions, 'functions <count>'),
+	'includes': (includes, 'includes <modules> <directory>'),
+	'includes_mixed': (includes_mixed, 'includes_mixed <modules> <directory>'),
+	'expressions': (expressions, 'expressions <count>'),
+	'nested': (nested, 'nested <depth> <functions>'),
+}
+
+if len(sys.argv) < 2 or sys.argv[1] not in generators:
+	sys.exit('usage: ' + '\n       '.join(sys.argv[0] + ' ' + syntax for _, syntax in generators.values()))
+generator, syntax = generators[sys.argv[1]]
+if len(sys.argv) != len(syntax.split()) + 1:
+	sys.exit('usage: ' + sys.argv[0] + ' ' + syntax)
+generator(*sys.argv[2:])
@@ -0,0 +1,42 @@
+// Lexer throughput: tokens per second over a large file, and lexers per
+// second over a small one, what every included file pays before its first
+// token.
+//
+// usage: bench/lexer_bench <large file> <small file> [repetitions]
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "lexer.hpp"
+
+#define SMALL_LEXERS 20000
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "Syntax: " << argv[0] << " <large file> <small file> [repetitions]" << std::endl;
+		return 1;
+	}
+	int repetitions = argc > 3 ? std::stoi(argv[3]) : 5;
+
+	double best = 1e9;
+	size_t tokens = 0;
+	for (int i = 0; i < repetitions; i++) {
+		auto start = std::chrono::steady_clock::now();
+		Lexer lexer(argv[1]);
+		tokens = lexer.get_tokens().size();
+		best = std::min(best, seconds_since(start));
+	}
+	std::cout << "lexer: " << tokens << " tokens, best " << best * 1e3 << " ms, " << tokens / best / 1e6 << " Mtokens/s" << std::endl;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < SMALL_LEXERS; i++) {
+		Lexer lexer(argv[2]);
+	}
+	double elapsed = seconds_since(start);
+	std::cout << "lexer: " << SMALL_LEXERS << " lexers over " << argv[2] << ", " << elapsed * 1e3 << " ms, " << SMALL_LEXERS / elapsed / 1e3 << " k/s" << std::endl;
+
+	return 0;
+}
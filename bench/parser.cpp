@@ -0,0 +1,51 @@
+// Parser throughput over a pre-lexed program: tokens per second of the
+// sequential parser and of the one splitting the functions on a pool.
+//
+// usage: bench/parser_bench <file> [threads] [repetitions]
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "parser.hpp"
+#include "preprocessor.hpp"
+#include "thread_pool.hpp"
+#include "token_cache.hpp"
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cerr << "Syntax: " << argv[0] << " <file> [threads] [repetitions]" << std::endl;
+		return 1;
+	}
+	size_t threads = argc > 2 ? std::stoul(argv[2]) : 4;
+	int repetitions = argc > 3 ? std::stoi(argv[3]) : 7;
+	TokenCache::set_directory("");
+
+	std::vector<Token> tokens;
+	Preprocessor::preprocess_includes(argv[1], tokens);
+
+	double best = 1e9;
+	size_t exprs = 0;
+	for (int i = 0; i < repetitions; i++) {
+		std::unique_ptr<Lexer> lexer = std::make_unique<Lexer>();
+		lexer->set_tokens(std::span<const Token>(tokens));
+		auto start = std::chrono::steady_clock::now();
+		Ast ast = Parser(std::move(lexer)).parse_code();
+		best = std::min(best, seconds_since(start));
+		exprs = ast.exprs.size();
+	}
+	std::cout << "parser: " << tokens.size() << " tokens, " << exprs << " expressions, best " << best * 1e3 << " ms, " << tokens.size() / best / 1e6 << " Mtokens/s" << std::endl;
+
+	ThreadPool pool(threads);
+	best = 1e9;
+	for (int i = 0; i < repetitions; i++) {
+		auto start = std::chrono::steady_clock::now();
+		Ast ast = Parser::parse_code(tokens, pool);
+		best = std::min(best, seconds_since(start));
+	}
+	std::cout << "parser: pool of " << threads << ", best " << best * 1e3 << " ms, " << tokens.size() / best / 1e6 << " Mtokens/s" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,54 @@
+// Include preprocessing over a generated include graph, the token cache is
+// disabled so every file is lexed. One mode per process, so no mode finds
+// the files already mapped by another: batch, streaming (the tokens the
+// parser pulls with -j 1) or pool (batch lexing the files on threads).
+//
+// usage: bench/preprocessor_bench <root file> <batch | streaming | pool> [threads]
+// Run from the directory of the root file, includes are relative to it.
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "preprocessor.hpp"
+#include "thread_pool.hpp"
+#include "token_cache.hpp"
+
+static void usage(char* program) {
+	std::cerr << "Syntax: " << program << " <root file> <batch | streaming | pool> [threads]" << std::endl;
+	exit(1);
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		usage(argv[0]);
+	}
+	std::string filename = argv[1];
+	std::string mode = argv[2];
+	size_t threads = argc > 3 ? std::stoul(argv[3]) : 4;
+	TokenCache::set_directory("");
+
+	auto start = std::chrono::steady_clock::now();
+	size_t tokens = 0;
+	if (mode == "batch") {
+		std::vector<Token> program;
+		Preprocessor::preprocess_includes(filename, program);
+		tokens = program.size();
+	} else if (mode == "streaming") {
+		Preprocessor preprocessor(filename);
+		Token token;
+		while (preprocessor.next_token(token)) {
+			tokens++;
+		}
+	} else if (mode == "pool") {
+		ThreadPool pool(threads);
+		std::vector<Token> program;
+		Preprocessor::preprocess_includes(filename, program, pool);
+		tokens = program.size();
+		mode += " of " + std::to_string(threads);
+	} else {
+		usage(argv[0]);
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "preprocessor: " << mode << ", " << tokens << " tokens, " << elapsed * 1e3 << " ms" << std::endl;
+
+	return 0;
+}
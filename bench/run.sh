@@ -0,0 +1,33 @@
+#!/bin/bash
+# Generate the inputs of every benchmark on a temporary directory and run
+# them, the harnesses are built by `make bench`.
+#
+# usage: bench/run.sh
+# Run from the root of the repository, where std/ and builtin/ are. Times are
+# the best of a few repetitions, compare runs on the same machine only.
+
+set -e
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# lexer: 20k functions, 8.7 MB and 1.8M tokens
+bench/generate.py functions 20000 > "$work/functions.aka"
+bench/lexer_bench "$work/functions.aka" std/syscall.aka
+
+# preprocessor: 3000 modules including up to 8 earlier ones, 580k tokens,
+# then the same graph spelling every path in three ways
+for graph in includes includes_mixed; do
+	bench/generate.py $graph 3000 "$work/$graph"
+	for mode in batch streaming pool; do
+		(cd "$work/$graph" && "$OLDPWD/bench/preprocessor_bench" root.aka $mode)
+	done
+done
+
+# parser: 20k functions of random expressions, 4.4M tokens
+bench/generate.py expressions 20000 > "$work/expressions.aka"
+bench/parser_bench "$work/expressions.aka"
+
+# codegen: 300 functions nesting while and if blocks 64 levels deep, 6.7 MB
+# of assembly
+bench/generate.py nested 64 300 > "$work/nested.aka"
+bench/codegen_bench "$work/nested.aka" "$work/nested.asm"
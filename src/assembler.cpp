@@ -0,0 +1,448 @@
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include "assembler.hpp"
+#include "utils.hpp"
+
+// Condition codes of jcc and setcc, added to their first opcode
+static const uint8_t condition_codes[] = {0xC, 0xF, 0x4, 0x5, 0xE, 0xD};
+static_assert(std::size(condition_codes) == X86_CC_COUNTER, "Unhandled X86_CC_COUNTER on condition_codes at assembler.cpp");
+
+static std::string_view trim(std::string_view text) {
+	while (!text.empty() && Utils::is_blankspace(text.front())) {
+		text.remove_prefix(1);
+	}
+	while (!text.empty() && Utils::is_blankspace(text.back())) {
+		text.remove_suffix(1);
+	}
+	return text;
+}
+
+static bool equals_ignore_case(std::string_view a, std::string_view b) {
+	return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+static int64_t parse_number(std::string_view text) {
+	int64_t number = 0;
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), number);
+	if (error != std::errc() || end != text.data() + text.size()) {
+		Utils::error("Invalid number on assembly: " + std::string(text));
+	}
+	return number;
+}
+
+/**
+ * @brief [base + index*scale + displacement], terms in any order
+ */
+static X86_Operand parse_memory(std::string_view text, uint8_t size) {
+	X86_Operand memory = x86_memory(size, X86_RAX);
+	bool has_base = false;
+	size_t start = 0;
+	bool negative = false;
+	while (start < text.size()) {
+		size_t end = text.find_first_of("+-", start + 1);
+		end = end == std::string_view::npos ? text.size() : end;
+		std::string_view term = trim(text.substr(start, end - start));
+		if (term.front() == '+' || term.front() == '-') {
+			negative = term.front() == '-';
+			term = trim(term.substr(1));
+		}
+
+		X86_Operand reg;
+		size_t star = term.find('*');
+		if (star != std::string_view::npos && x86_parse_register(trim(term.substr(0, star)), reg)) {
+			memory.index = reg.reg;
+			memory.scale = parse_number(trim(term.substr(star + 1)));
+		} else if (x86_parse_register(term, reg) && !has_base) {
+			memory.reg = reg.reg;
+			has_base = true;
+		} else if (x86_parse_register(term, reg)) {
+			memory.index = reg.reg;
+			memory.scale = 1;
+		} else {
+			memory.imm += negative ? -parse_number(term) : parse_number(term);
+		}
+		start = end;
+	}
+
+	if (!has_base) {
+		Utils::error("Memory operand without a base on assembly: " + std::string(text));
+	}
+	return memory;
+}
+
+static X86_Operand parse_operand(std::string_view text) {
+	if (text.empty()) {
+		Utils::error("Missing operand on assembly");
+	}
+	static const std::pair<const char*, uint8_t> sizes[] = {{"byte", 1}, {"dword", 4}, {"qword", 8}};
+	uint8_t size = 0;
+	for (const auto& [name, bytes]: sizes) {
+		size_t length = strlen(name);
+		if (text.size() > length && equals_ignore_case(text.substr(0, length), name) && !std::isalnum(text[length])) {
+			size = bytes;
+			text = trim(text.substr(length));
+		}
+	}
+
+	X86_Operand operand;
+	if (text.front() == '[' && text.back() == ']') {
+		return parse_memory(text.substr(1, text.size() - 2), size);
+	} else if (x86_parse_register(text, operand)) {
+		return operand;
+	} else if (std::isdigit(text.front()) || text.front() == '-') {
+		return x86_immediate(parse_number(text));
+	} else if (text == ".retpoint") {
+		return x86_label(X86_RETURN_LABEL);
+	} else if (text.rfind(".L", 0) == 0) {
+		return x86_label(parse_number(text.substr(2)));
+	}
+	return x86_function(Interner::intern(text));
+}
+
+static X86Opcode parse_mnemonic(std::string_view mnemonic, X86Condition& condition) {
+	X86Opcode opcode;
+	if (x86_parse_opcode(mnemonic, opcode)) {
+		return opcode;
+	} else if (mnemonic == "sal") {
+		return X86_SHL;
+	} else if (mnemonic == "movsx") {
+		return X86_MOVSXD;
+	} else if (mnemonic.rfind("set", 0) == 0 && x86_parse_condition(mnemonic.substr(3), condition)) {
+		return X86_SETCC;
+	} else if (mnemonic.rfind("j", 0) == 0 && x86_parse_condition(mnemonic.substr(1), condition)) {
+		return X86_JCC;
+	}
+	Utils::error("Unknown instruction on assembly: " + std::string(mnemonic));
+	exit(1);
+}
+
+std::vector<X86_Instruction> X86Assembler::parse(std::string_view source) {
+	std::vector<X86_Instruction> code;
+	size_t start = 0;
+	while (start < source.size()) {
+		size_t end = source.find('\n', start);
+		end = end == std::string_view::npos ? source.size() : end;
+		std::string_view line = source.substr(start, end - start);
+		start = end + 1;
+		line = trim(line.substr(0, line.find(';')));
+		if (line.empty()) {
+			continue;
+		}
+
+		if (line.back() == ':') {
+			code.push_back(x86_instruction(X86_LABEL, parse_operand(line.substr(0, line.size() - 1))));
+			continue;
+		}
+
+		size_t space = line.find_first_of(" \t");
+		std::string_view mnemonic = line.substr(0, space);
+		std::vector<X86_Operand> operands;
+		while (space != std::string_view::npos) {
+			line = line.substr(space + 1);
+			space = line.find(',');
+			operands.push_back(parse_operand(trim(line.substr(0, space))));
+		}
+
+		X86_Instruction instruction = x86_instruction(X86_NOP);
+		instruction.opcode = parse_mnemonic(mnemonic, instruction.condition);
+		// imul reg, reg, imm is the two operand form on the same register
+		if (operands.size() == 3 && instruction.opcode == X86_IMUL && x86_same_operand(operands[0], operands[1])) {
+			operands.erase(operands.begin() + 1);
+		}
+		// shifts by cl are the form without a count
+		bool shifts = instruction.opcode == X86_SHL || instruction.opcode == X86_SAR || instruction.opcode == X86_SHR;
+		if (shifts && operands.size() == 2 && x86_same_operand(operands[1], x86_register(X86_RCX, 1))) {
+			operands.pop_back();
+		}
+		if (operands.size() > 2) {
+			Utils::error("Unsupported operands on assembly: " + std::string(mnemonic));
+		}
+		instruction.a = operands.size() > 0 ? operands[0] : X86_Operand{};
+		instruction.b = operands.size() > 1 ? operands[1] : X86_Operand{};
+
+		// memory without a size takes the one of the register it goes to or from
+		if (instruction.opcode != X86_LEA) {
+			if (instruction.a.kind == X86_OPERAND_MEMORY && instruction.a.size == 0 && instruction.b.kind == X86_OPERAND_REGISTER) {
+				instruction.a.size = instruction.b.size;
+			} else if (instruction.b.kind == X86_OPERAND_MEMORY && instruction.b.size == 0 && instruction.a.kind == X86_OPERAND_REGISTER) {
+				instruction.b.size = instruction.opcode == X86_MOVSXD ? 4 : instruction.a.size;
+			}
+		}
+		code.push_back(instruction);
+	}
+
+	return code;
+}
+
+void X86Assembler::emit_byte(uint8_t byte) {
+	text.push_back(byte);
+}
+
+void X86Assembler::emit_immediate(int64_t value, size_t bytes) {
+	for (size_t i = 0; i < bytes; i++) {
+		text.push_back((uint64_t) value >> (8 * i));
+	}
+}
+
+void X86Assembler::emit_rel32(std::vector<Fixup>& fixups, int64_t target, Symbol symbol) {
+	fixups.push_back({.position = text.size(), .target = target, .symbol = symbol});
+	emit_immediate(0, 4);
+}
+
+/**
+ * @brief spl, bpl, sil and dil only exist with a REX prefix
+ */
+static bool is_rex_byte_register(const X86_Operand& operand) {
+	return operand.kind == X86_OPERAND_REGISTER && operand.size == 1 && operand.reg >= X86_RSP && operand.reg <= X86_RDI;
+}
+
+void X86Assembler::emit_rm(std::initializer_list<uint8_t> opcode, uint8_t size, uint8_t reg, const X86_Operand& rm, bool byte_register) {
+	bool memory = rm.kind == X86_OPERAND_MEMORY;
+	uint8_t rex = 0x40 | (size == 8 ? 0x08 : 0) | (reg & 8 ? 0x04 : 0) | (rm.reg & 8 ? 0x01 : 0);
+	if (memory && rm.scale != 0 && (rm.index & 8)) {
+		rex |= 0x02;
+	}
+	if (rex != 0x40 || byte_register || is_rex_byte_register(rm)) {
+		emit_byte(rex);
+	}
+	for (uint8_t byte: opcode) {
+		emit_byte(byte);
+	}
+
+	if (!memory) {
+		emit_byte(0xC0 | (reg & 7) << 3 | (rm.reg & 7));
+		return;
+	}
+
+	// rbp and r13 as a base always take a displacement, rsp and r12 a SIB byte
+	uint8_t mod = rm.imm == 0 && (rm.reg & 7) != X86_RBP ? 0 : rm.imm == (int8_t) rm.imm ? 1 : 2;
+	if (rm.scale != 0 || (rm.reg & 7) == X86_RSP) {
+		uint8_t scale = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+		emit_byte(mod << 6 | (reg & 7) << 3 | 4);
+		emit_byte(scale << 6 | (rm.scale != 0 ? rm.index & 7 : 4) << 3 | (rm.reg & 7));
+	} else {
+		emit_byte(mod << 6 | (reg & 7) << 3 | (rm.reg & 7));
+	}
+	if (mod != 0) {
+		emit_immediate(rm.imm, mod == 1 ? 1 : 4);
+	}
+}
+
+void X86Assembler::encode(const X86_Instruction& instruction) {
+	static_assert(X86_OPCODE_COUNTER == 31, "Unhandled X86_OPCODE_COUNTER on encode at assembler.cpp");
+	const X86_Operand& a = instruction.a;
+	const X86_Operand& b = instruction.b;
+	// operand size, of the destination when there is one
+	uint8_t size = a.kind == X86_OPERAND_REGISTER || a.kind == X86_OPERAND_MEMORY ? a.size : 8;
+	bool byte_register = is_rex_byte_register(a) || is_rex_byte_register(b);
+
+	switch (instruction.opcode) {
+		case X86_LABEL:
+			if (a.kind == X86_OPERAND_FUNCTION) {
+				finish_function();
+				if (functions.find(a.symbol) != nullptr) {
+					Utils::error("Function defined twice on assembly: " + std::string(Interner::name(a.symbol)));
+				}
+				functions[a.symbol] = text.size();
+			} else {
+				if ((size_t) (a.imm + 1) >= labels.size()) {
+					labels.resize(a.imm + 2, SIZE_MAX);
+				}
+				if (labels[a.imm + 1] != SIZE_MAX) {
+					Utils::error("Label defined twice on assembly: " + std::to_string(a.imm));
+				}
+				labels[a.imm + 1] = text.size();
+			}
+			break;
+
+		case X86_MOV:
+			if (b.kind == X86_OPERAND_REGISTER) {
+				emit_rm({(uint8_t) (size == 1 ? 0x88 : 0x89)}, size, b.reg, a, byte_register);
+			} else if (b.kind == X86_OPERAND_MEMORY) {
+				emit_rm({(uint8_t) (size == 1 ? 0x8A : 0x8B)}, size, a.reg, b, byte_register);
+			} else if (b.kind == X86_OPERAND_STRING) {
+				// the data is loaded below 2GB, its addresses fit on a sign extended imm32
+				emit_rm({0xC7}, 8, 0, a, false);
+				emit_rel32(strings, b.imm, SYMBOL_NONE);
+			} else if (a.kind == X86_OPERAND_MEMORY || size == 1) {
+				emit_rm({(uint8_t) (size == 1 ? 0xC6 : 0xC7)}, size, 0, a, byte_register);
+				emit_immediate(b.imm, size == 1 ? 1 : 4);
+			} else if (size == 8 && b.imm == (int32_t) b.imm) {
+				emit_rm({0xC7}, 8, 0, a, false);
+				emit_immediate(b.imm, 4);
+			} else {
+				// mov r32, imm32 zero extends, anything larger takes the whole imm64
+				bool wide = size == 8 && (uint64_t) b.imm > UINT32_MAX;
+				if (wide || (a.reg & 8)) {
+					emit_byte(0x40 | (wide ? 0x08 : 0) | (a.reg & 8 ? 0x01 : 0));
+				}
+				emit_byte(0xB8 + (a.reg & 7));
+				emit_immediate(b.imm, wide ? 8 : 4);
+			}
+			break;
+
+		case X86_MOVSXD: emit_rm({0x63}, 8, a.reg, b, false); break;
+		case X86_MOVZX: emit_rm({0x0F, 0xB6}, size, a.reg, b, byte_register); break;
+		case X86_LEA: emit_rm({0x8D}, size, a.reg, b, false); break;
+
+		case X86_ADD:
+		case X86_OR:
+		case X86_AND:
+		case X86_SUB:
+		case X86_XOR:
+		case X86_CMP: {
+			uint8_t extension = instruction.opcode == X86_ADD ? 0 : instruction.opcode == X86_OR ? 1 : instruction.opcode == X86_AND ? 4
+				: instruction.opcode == X86_SUB ? 5 : instruction.opcode == X86_XOR ? 6 : 7;
+			if (b.kind == X86_OPERAND_REGISTER) {
+				emit_rm({(uint8_t) (extension << 3 | (size == 1 ? 0 : 1))}, size, b.reg, a, byte_register);
+			} else if (b.kind == X86_OPERAND_MEMORY) {
+				emit_rm({(uint8_t) (extension << 3 | (size == 1 ? 2 : 3))}, size, a.reg, b, byte_register);
+			} else if (size == 1 || b.imm == (int8_t) b.imm) {
+				emit_rm({(uint8_t) (size == 1 ? 0x80 : 0x83)}, size, extension, a, byte_register);
+				emit_immediate(b.imm, 1);
+			} else {
+				emit_rm({0x81}, size, extension, a, byte_register);
+				emit_immediate(b.imm, 4);
+			}
+			break;
+		}
+
+		case X86_TEST:
+			if (b.kind == X86_OPERAND_REGISTER) {
+				emit_rm({(uint8_t) (size == 1 ? 0x84 : 0x85)}, size, b.reg, a, byte_register);
+			} else {
+				emit_rm({(uint8_t) (size == 1 ? 0xF6 : 0xF7)}, size, 0, a, byte_register);
+				emit_immediate(b.imm, size == 1 ? 1 : 4);
+			}
+			break;
+
+		case X86_IMUL:
+			if (b.kind == X86_OPERAND_NONE) {
+				emit_rm({0xF7}, size, 5, a, false);
+			} else if (b.kind != X86_OPERAND_IMMEDIATE) {
+				emit_rm({0x0F, 0xAF}, size, a.reg, b, false);
+			} else if (b.imm == (int8_t) b.imm) {
+				emit_rm({0x6B}, size, a.reg, a, false);
+				emit_immediate(b.imm, 1);
+			} else {
+				emit_rm({0x69}, size, a.reg, a, false);
+				emit_immediate(b.imm, 4);
+			}
+			break;
+
+		case X86_NEG: emit_rm({(uint8_t) (size == 1 ? 0xF6 : 0xF7)}, size, 3, a, byte_register); break;
+		case X86_NOT: emit_rm({(uint8_t) (size == 1 ? 0xF6 : 0xF7)}, size, 2, a, byte_register); break;
+		case X86_IDIV: emit_rm({(uint8_t) (size == 1 ? 0xF6 : 0xF7)}, size, 7, a, byte_register); break;
+
+		case X86_SHL:
+		case X86_SAR:
+		case X86_SHR: {
+			uint8_t extension = instruction.opcode == X86_SHL ? 4 : instruction.opcode == X86_SHR ? 5 : 7;
+			uint8_t wide = size == 1 ? 0 : 1;
+			if (b.kind == X86_OPERAND_NONE) {
+				emit_rm({(uint8_t) (0xD2 | wide)}, size, extension, a, byte_register);
+			} else if (b.imm == 1) {
+				emit_rm({(uint8_t) (0xD0 | wide)}, size, extension, a, byte_register);
+			} else {
+				emit_rm({(uint8_t) (0xC0 | wide)}, size, extension, a, byte_register);
+				emit_immediate(b.imm, 1);
+			}
+			break;
+		}
+
+		case X86_CQO:
+			emit_byte(0x48);
+			emit_byte(0x99);
+			break;
+		case X86_CDQE:
+			emit_byte(0x48);
+			emit_byte(0x98);
+			break;
+
+		case X86_SETCC: emit_rm({0x0F, (uint8_t) (0x90 + condition_codes[instruction.condition])}, 1, 0, a, byte_register); break;
+
+		case X86_JMP:
+			emit_byte(0xE9);
+			if (a.kind == X86_OPERAND_FUNCTION) {
+				emit_rel32(calls, 0, a.symbol);
+			} else {
+				emit_rel32(jumps, a.imm, SYMBOL_NONE);
+			}
+			break;
+		case X86_JCC:
+			emit_byte(0x0F);
+			emit_byte(0x80 + condition_codes[instruction.condition]);
+			emit_rel32(jumps, a.imm, SYMBOL_NONE);
+			break;
+		case X86_CALL:
+			emit_byte(0xE8);
+			emit_rel32(calls, 0, a.symbol);
+			break;
+
+		case X86_PUSH:
+		case X86_POP:
+			if (a.reg & 8) {
+				emit_byte(0x41);
+			}
+			emit_byte((instruction.opcode == X86_PUSH ? 0x50 : 0x58) + (a.reg & 7));
+			break;
+
+		case X86_RET: emit_byte(0xC3); break;
+		case X86_LEAVE: emit_byte(0xC9); break;
+		case X86_NOP: emit_byte(0x90); break;
+		case X86_SYSCALL:
+			emit_byte(0x0F);
+			emit_byte(0x05);
+			break;
+
+		default: Utils::error("Unknown x86 instruction"); exit(1);
+	}
+}
+
+static void write_rel32(std::vector<uint8_t>& text, size_t position, size_t target) {
+	int32_t rel = (int64_t) target - (int64_t) (position + 4);
+	memcpy(&text[position], &rel, 4);
+}
+
+void X86Assembler::finish_function() {
+	for (const Fixup& jump: jumps) {
+		size_t label = jump.target + 1;
+		if (label >= labels.size() || labels[label] == SIZE_MAX) {
+			Utils::error("Jump to an undefined label on assembly: " + std::to_string(jump.target));
+		}
+		write_rel32(text, jump.position, labels[label]);
+	}
+	jumps.clear();
+	labels.clear();
+}
+
+void X86Assembler::encode(const std::vector<X86_Instruction>& code) {
+	for (const X86_Instruction& instruction: code) {
+		encode(instruction);
+	}
+	finish_function();
+}
+
+size_t X86Assembler::size() {
+	return text.size();
+}
+
+size_t X86Assembler::offset(Symbol function) {
+	size_t* position = functions.find(function);
+	if (position == nullptr) {
+		Utils::error("Undefined function: " + std::string(Interner::name(function)));
+	}
+	return *position;
+}
+
+const std::vector<uint8_t>& X86Assembler::link(const std::vector<uint64_t>& string_addresses) {
+	for (const Fixup& call: calls) {
+		write_rel32(text, call.position, offset(call.symbol));
+	}
+	for (const Fixup& string: strings) {
+		int32_t address = string_addresses[string.target];
+		memcpy(&text[string.position], &address, 4);
+	}
+	return text;
+}
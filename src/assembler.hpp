@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+#include "interner.hpp"
+#include "x86.hpp"
+
+/**
+ * @brief Encodes instructions into x86-64 machine code: the ones the backend
+ * selects, and the NASM subset the builtin routines are written in once
+ * parsed. Jumps and calls always take a rel32. Labels are local to the
+ * function they are in, calls and string addresses are resolved once every
+ * function is encoded.
+ */
+class X86Assembler {
+private:
+	// rel32 or absolute imm32 at position of text, to a label, string or function
+	typedef struct {
+		size_t position;
+		int64_t target;
+		Symbol symbol;
+	} Fixup;
+
+	std::vector<uint8_t> text;
+	Symbol_Map<size_t> functions;
+	std::vector<Fixup> calls;
+	std::vector<Fixup> strings;
+	// position of the labels of the function being encoded, by label + 1 so
+	// the return label is 0, and the jumps to them
+	std::vector<size_t> labels;
+	std::vector<Fixup> jumps;
+
+	void finish_function();
+	void emit_byte(uint8_t byte);
+	void emit_immediate(int64_t value, size_t bytes);
+	void emit_rel32(std::vector<Fixup>& fixups, int64_t target, Symbol symbol);
+
+	/**
+	 * @brief Emit opcode with a ModRM byte, reg on its reg field and rm on
+	 * the register or memory field, plus the REX prefix they need
+	 */
+	void emit_rm(std::initializer_list<uint8_t> opcode, uint8_t size, uint8_t reg, const X86_Operand& rm, bool byte_register);
+	void encode(const X86_Instruction& instruction);
+
+public:
+	/**
+	 * @brief Parse NASM source into instructions, function names are interned
+	 * as views of source, so it must outlive the compilation
+	 */
+	static std::vector<X86_Instruction> parse(std::string_view source);
+
+	/**
+	 * @brief Encode whole functions, each starting on the label of its name
+	 */
+	void encode(const std::vector<X86_Instruction>& code);
+
+	size_t size();
+
+	/**
+	 * @brief Offset of the function on the text
+	 */
+	size_t offset(Symbol function);
+
+	/**
+	 * @brief Resolve the calls between functions and the addresses of the
+	 * strings
+	 * @return the text, ready to be loaded
+	 */
+	const std::vector<uint8_t>& link(const std::vector<uint64_t>& string_addresses);
+};
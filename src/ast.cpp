@@ -0,0 +1,188 @@
+#include <algorithm>
+#include "ast.hpp"
+#include "utils.hpp"
+
+template<typename T>
+static uint32_t push_node(std::vector<T>& arena, const T& node) {
+	if (arena.size() == UINT32_MAX) {
+		Utils::error("Too many AST nodes");
+	}
+
+	arena.push_back(node);
+	return arena.size() - 1;
+}
+
+Stmt_Index Ast::add(const Statement& stmt) { return push_node(statements, stmt); }
+Expr_Index Ast::add(const Expr& expr) { return push_node(exprs, expr); }
+Func_Index Ast::add(const Func_Def& fnc) { return push_node(functions, fnc); }
+
+Node_List Ast::add_list(std::span<const uint32_t> items) {
+	Node_List list = {.first = (uint32_t) lists.size(), .count = (uint32_t) items.size()};
+	lists.insert(lists.end(), items.begin(), items.end());
+	return list;
+}
+
+Node_List Ast::add_string(std::string_view string) {
+	Node_List list = {.first = (uint32_t) strings.size(), .count = (uint32_t) string.size()};
+	strings.append(string);
+	return list;
+}
+
+std::span<const uint32_t> Ast::list(Node_List list) const {
+	return std::span<const uint32_t>(lists.data() + list.first, list.count);
+}
+
+std::span<const Func_Arg> Ast::function_arguments(const Func_Def& fnc) const {
+	return std::span<const Func_Arg>(arguments.data() + fnc.arguments.first, fnc.arguments.count);
+}
+
+std::string_view Ast::string(Node_List string) const {
+	return std::string_view(strings.data() + string.first, string.count);
+}
+
+static_assert(STMT_TYPE_COUNTER == 7, "Unhandled STMT_TYPE_COUNTER on Ast::append");
+static_assert(EXPR_TYPE_COUNTER == 7, "Unhandled EXPR_TYPE_COUNTER on Ast::append");
+
+std::vector<Ast_Offsets> Ast::grow(std::span<const Ast> others) {
+	std::vector<Ast_Offsets> places;
+	Ast_Offsets at = {
+		.statements = (uint32_t) statements.size(),
+		.exprs = (uint32_t) exprs.size(),
+		.functions = (uint32_t) functions.size(),
+		.arguments = (uint32_t) arguments.size(),
+		.lists = (uint32_t) lists.size(),
+		.strings = (uint32_t) strings.size(),
+		.program = (uint32_t) program.size()
+	};
+
+	for (const Ast& other : others) {
+		places.push_back(at);
+		size_t grown[] = {
+			at.statements + other.statements.size(),
+			at.exprs + other.exprs.size(),
+			at.functions + other.functions.size(),
+			at.arguments + other.arguments.size(),
+			at.lists + other.lists.size(),
+			at.strings + other.strings.size(),
+			at.program + other.program.size()
+		};
+		for (size_t size : grown) {
+			if (size >= UINT32_MAX) {
+				Utils::error("Too many AST nodes");
+			}
+		}
+		at = {
+			.statements = (uint32_t) grown[0],
+			.exprs = (uint32_t) grown[1],
+			.functions = (uint32_t) grown[2],
+			.arguments = (uint32_t) grown[3],
+			.lists = (uint32_t) grown[4],
+			.strings = (uint32_t) grown[5],
+			.program = (uint32_t) grown[6]
+		};
+	}
+
+	statements.resize(at.statements);
+	exprs.resize(at.exprs);
+	functions.resize(at.functions);
+	arguments.resize(at.arguments);
+	lists.resize(at.lists);
+	strings.resize(at.strings);
+	program.resize(at.program);
+	return places;
+}
+
+void Ast::place(const Ast& other, const Ast_Offsets& at) {
+	std::copy(other.arguments.begin(), other.arguments.end(), arguments.begin() + at.arguments);
+	std::copy(other.strings.begin(), other.strings.end(), strings.begin() + at.strings);
+
+	// lists hold statement or expression indices depending on their owner,
+	// relocate their contents while walking the owners
+	auto relocate_list = [&](Node_List& list, uint32_t base) {
+		for (uint32_t i = 0; i < list.count; i++) {
+			lists[at.lists + list.first + i] = other.lists[list.first + i] + base;
+		}
+		list.first += at.lists;
+	};
+
+	for (size_t i = 0; i < other.functions.size(); i++) {
+		Func_Def fnc = other.functions[i];
+		fnc.arguments.first += at.arguments;
+		relocate_list(fnc.body, at.statements);
+		functions[at.functions + i] = fnc;
+	}
+
+	for (size_t i = 0; i < other.statements.size(); i++) {
+		Statement stmt = other.statements[i];
+		switch (stmt.type) {
+			case STMT_TYPE_FUNCTION_DECLARATION:
+				stmt.fnc += at.functions;
+				break;
+			case STMT_TYPE_VAR_REASIGNATION:
+			case STMT_TYPE_VAR_DECLARATION:
+				stmt.var.value += at.exprs;
+				break;
+			case STMT_TYPE_RETURN:
+			case STMT_TYPE_EXPR:
+				stmt.expr += at.exprs;
+				break;
+			case STMT_TYPE_IF:
+				stmt.iif.condition += at.exprs;
+				relocate_list(stmt.iif.then, at.statements);
+				relocate_list(stmt.iif.elsse, at.statements);
+				break;
+			case STMT_TYPE_WHILE:
+				stmt.whilee.condition += at.exprs;
+				relocate_list(stmt.whilee.block, at.statements);
+				break;
+			case STMT_TYPE_COUNTER:
+				Utils::error("Unknown statement type");
+		}
+		statements[at.statements + i] = stmt;
+	}
+
+	for (size_t i = 0; i < other.exprs.size(); i++) {
+		Expr expr = other.exprs[i];
+		switch (expr.type) {
+			case EXPR_TYPE_FUNC_CALL:
+				relocate_list(expr.func_call.args, at.exprs);
+				break;
+			case EXPR_TYPE_LITERAL_STRING:
+				expr.string.first += at.strings;
+				break;
+			case EXPR_TYPE_OP:
+				expr.op.lhs += at.exprs;
+				expr.op.rhs += at.exprs;
+				break;
+			case EXPR_TYPE_UNARY:
+				expr.unary.operand += at.exprs;
+				break;
+			case EXPR_TYPE_LITERAL_BOOL:
+			case EXPR_TYPE_VAR_READ:
+			case EXPR_TYPE_LITERAL_NUMBER:
+				break;
+			case EXPR_TYPE_COUNTER:
+				Utils::error("Unknown expression type");
+		}
+		exprs[at.exprs + i] = expr;
+	}
+
+	for (size_t i = 0; i < other.program.size(); i++) {
+		program[at.program + i] = other.program[i] + at.statements;
+	}
+}
+
+void Ast::append(const Ast& other) {
+	Ast_Offsets at = grow(std::span<const Ast>(&other, 1))[0];
+	place(other, at);
+}
+
+size_t Ast::memory_usage() const {
+	return statements.capacity() * sizeof(Statement)
+		+ exprs.capacity() * sizeof(Expr)
+		+ functions.capacity() * sizeof(Func_Def)
+		+ arguments.capacity() * sizeof(Func_Arg)
+		+ lists.capacity() * sizeof(uint32_t)
+		+ strings.capacity()
+		+ program.capacity() * sizeof(Stmt_Index);
+}
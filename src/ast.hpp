@@ -0,0 +1,246 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "interner.hpp"
+
+#define VAR_TYPE(varType, starsC) (VarType) { \
+										.stars = starsC, \
+										.type = varType  \
+									}
+
+// Nodes reference each other by their index on the Ast arenas
+typedef uint32_t Stmt_Index;
+typedef uint32_t Expr_Index;
+typedef uint32_t Func_Index;
+
+typedef struct VarType VarType;
+typedef struct Func_Arg Func_Arg;
+typedef struct Expr Expr;
+typedef struct Func_Def Func_Def;
+typedef struct Func_Call Func_Call;
+typedef struct Var_Asign Var_Asign;
+typedef struct If If;
+typedef struct While While;
+typedef struct Op Op;
+typedef struct Unary Unary;
+typedef struct Var_Read Var_Read;
+typedef struct Statement Statement;
+
+/**
+ * @brief count consecutive elements of an arena starting at first
+ */
+typedef struct {
+	uint32_t first;
+	uint32_t count;
+} Node_List;
+
+typedef enum {
+	VAR_TYPE_INT,
+	VAR_TYPE_LONG,
+	VAR_TYPE_CHAR,
+	VAR_TYPE_BOOL,
+	VAR_TYPE_ANY, // used for syscalls
+	VAR_TYPE_COUNTER
+} VarTypeT;
+
+struct VarType {
+	uint32_t stars; // counter of pointers
+	VarTypeT type;
+};
+
+typedef enum {
+	STMT_TYPE_FUNCTION_DECLARATION,
+	STMT_TYPE_VAR_REASIGNATION,
+	STMT_TYPE_RETURN,
+	STMT_TYPE_EXPR,
+	STMT_TYPE_VAR_DECLARATION,
+	STMT_TYPE_IF,
+	STMT_TYPE_WHILE,
+	STMT_TYPE_COUNTER
+} StmtType;
+
+typedef enum {
+	OP_TYPE_ADD,
+	OP_TYPE_SUB,
+	OP_TYPE_DIV,
+	OP_TYPE_MOD,
+	OP_TYPE_MUL,
+	OP_TYPE_LT,
+	OP_TYPE_GT,
+	OP_TYPE_EQ,
+	OP_TYPE_NEQ,
+	OP_TYPE_LTE,
+	OP_TYPE_GTE,
+	OP_TYPE_AND,
+	OP_TYPE_OR,
+	OP_TYPE_BIT_AND,
+	OP_TYPE_BIT_OR,
+	OP_TYPE_BIT_XOR,
+	OP_TYPE_SHL,
+	OP_TYPE_SHR,
+	OP_TYPE_COUNT
+} OpType;
+
+struct Op {
+	OpType type;
+	Expr_Index lhs;
+	Expr_Index rhs;
+};
+
+typedef enum {
+	UNARY_TYPE_NEG,
+	UNARY_TYPE_BIT_NOT,
+	UNARY_TYPE_COUNT
+} UnaryType;
+
+struct Unary {
+	UnaryType type;
+	Expr_Index operand;
+};
+
+struct Var_Read {
+	Symbol var_name;
+	uint32_t stars;
+};
+
+struct Func_Arg {
+	VarType type;
+	Symbol name;
+};
+
+struct Func_Def {
+	Symbol name;
+	VarType return_type;
+	Node_List arguments; // on Ast::arguments
+	Node_List body; // Stmt_Index list on Ast::lists
+};
+
+struct Func_Call {
+	Symbol name;
+	Node_List args; // Expr_Index list on Ast::lists
+};
+
+typedef enum {
+	EXPR_TYPE_FUNC_CALL,
+	EXPR_TYPE_LITERAL_BOOL,
+	EXPR_TYPE_VAR_READ,
+	EXPR_TYPE_LITERAL_NUMBER,
+	EXPR_TYPE_LITERAL_STRING,
+	EXPR_TYPE_OP,
+	EXPR_TYPE_UNARY,
+	EXPR_TYPE_COUNTER
+} ExprType;
+
+static_assert(EXPR_TYPE_COUNTER == 7, "Unhandled EXPR_TYPE_COUNTER on ast.hpp");
+
+struct Expr {
+	ExprType type;
+	union {
+		Func_Call func_call;
+		bool boolean;
+		int number;
+		Var_Read var_read;
+		Node_List string; // characters on Ast::strings, escapes already resolved
+		Op op;
+		Unary unary;
+	};
+};
+
+struct Var_Asign {
+	Symbol name;
+	VarType type;
+	Expr_Index value;
+	bool is_ptr;
+};
+
+struct If {
+	Expr_Index condition;
+	Node_List then;
+	Node_List elsse;
+};
+
+struct While {
+	Expr_Index condition;
+	Node_List block;
+};
+
+struct Statement {
+	StmtType type;
+	union {
+		Func_Index fnc;
+		Var_Asign var;
+		Expr_Index expr; // STMT_TYPE_EXPR and STMT_TYPE_RETURN
+		If iif;
+		While whilee;
+	};
+};
+
+static_assert(sizeof(Expr) == 16 && sizeof(Statement) == 24, "AST nodes grew, check their layout on ast.hpp");
+
+/**
+ * @brief First free index of every arena of an Ast
+ */
+typedef struct {
+	uint32_t statements;
+	uint32_t exprs;
+	uint32_t functions;
+	uint32_t arguments;
+	uint32_t lists;
+	uint32_t strings;
+	uint32_t program;
+} Ast_Offsets;
+
+/**
+ * @brief Every node of a program on a few typed arenas, children are
+ * referenced by index so the whole tree is released at once
+ */
+class Ast {
+public:
+	std::vector<Statement> statements;
+	std::vector<Expr> exprs;
+	std::vector<Func_Def> functions;
+	std::vector<Func_Arg> arguments;
+	// children lists of statements and calls, every list is contiguous
+	std::vector<uint32_t> lists;
+	std::string strings;
+	// top level statements in source order
+	std::vector<Stmt_Index> program;
+
+	Stmt_Index add(const Statement& stmt);
+	Expr_Index add(const Expr& expr);
+	Func_Index add(const Func_Def& fnc);
+	Node_List add_list(std::span<const uint32_t> items);
+	Node_List add_string(std::string_view string);
+
+	std::span<const uint32_t> list(Node_List list) const;
+	std::span<const Func_Arg> function_arguments(const Func_Def& fnc) const;
+	std::string_view string(Node_List string) const;
+
+	/**
+	 * @brief Make room at the end of the arenas for every node of others
+	 *
+	 * @return where each one of others has to be placed
+	 */
+	std::vector<Ast_Offsets> grow(std::span<const Ast> others);
+
+	/**
+	 * @brief Copy the nodes of other on the room made by grow(), relocating
+	 * its indices. Places of different asts don't overlap so they can be
+	 * filled from different threads
+	 */
+	void place(const Ast& other, const Ast_Offsets& at);
+
+	/**
+	 * @brief Copy every node of other at the end of this ast, its top level
+	 * statements go after the current ones
+	 */
+	void append(const Ast& other);
+
+	/**
+	 * @brief Bytes reserved by the arenas
+	 */
+	size_t memory_usage() const;
+};
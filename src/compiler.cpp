@@ -1,13 +1,14 @@
+#include <algorithm>
+#include <bit>
 #include <iostream>
-#include <sstream>
 #include "compiler.hpp"
+#include "elf.hpp"
+#include "utils.hpp"
 
-Compiler::Compiler(std::vector<std::shared_ptr<Statement>> instructions) : instructions(instructions) {}
+Compiler::Compiler(const IrModule& module, ThreadPool* pool) : module(module), pool(pool) {}
 
-std::string Compiler::compile_program() {
-	std::string program = "[bits 64]\nsegment .text\n"
-						"\tglobal _start\n"
-						"_start:\n"
+// Entry point of every executable: main(argc, argv, envp) and exit with its result
+static const char START_SOURCE[] = "_start:\n"
 						"\tmov rdi, [rsp]\n"
 						"\tlea rsi, [rsp + 8]\n"
 						"\tlea rdx, [rsp + rdi*8+8+8]\n"
@@ -15,23 +16,70 @@ std::string Compiler::compile_program() {
 						"\tmov rdi, rax\n"
 						"\tmov rax, 60\n"
 						"\tsyscall\n";
-	program += compile_builtin();
 
-	for (std::shared_ptr<Statement> stmt: instructions) {
-		switch (stmt->type) {
-			case STMT_TYPE_FUNCTION_DECLARATION: 
-				program += compile_function(stmt);
-				break;
+void Compiler::compile_program(OutputSink& out) {
+	out.append("[bits 64]\nsegment .text\n"
+			"\tglobal _start\n");
+	out.append(START_SOURCE);
+	out.append(compile_builtin());
+
+	compile_functions([&out](const std::vector<X86_Instruction>& code) {
+		x86_print(code, out);
+	});
+	build_data_segment(out);
+	build_bss_segment(out);
+}
 
-			default:
-				Utils::error("Unknown top level statement");
-				exit(1);
-		}
+void Compiler::encode_program(X86Assembler& assembler) {
+	// the parsed names are views of the source, kept alive until the end
+	builtin_source = compile_builtin();
+	assembler.encode(X86Assembler::parse(builtin_source));
+	compile_functions([&assembler](const std::vector<X86_Instruction>& code) {
+		assembler.encode(code);
+	});
+}
+
+std::vector<uint8_t> Compiler::build_data(uint64_t address, std::vector<uint64_t>& string_addresses) {
+	std::vector<uint8_t> data;
+	for (const std::string& string: module.strings) {
+		string_addresses.push_back(address + data.size());
+		data.insert(data.end(), string.begin(), string.end());
+		data.push_back(0);
+	}
+	return data;
+}
+
+static size_t data_size(const IrModule& module) {
+	size_t size = 0;
+	for (const std::string& string: module.strings) {
+		size += string.size() + 1;
 	}
-	program += build_data_segment();
-	program += build_bss_segment();
+	return size;
+}
+
+void Compiler::compile_executable(const std::string& path) {
+	X86Assembler assembler;
+	assembler.encode(X86Assembler::parse(START_SOURCE));
+	encode_program(assembler);
+
+	std::vector<uint64_t> string_addresses;
+	std::vector<uint8_t> data = build_data(elf_data_address(assembler.size()), string_addresses);
+	const std::vector<uint8_t>& text = assembler.link(string_addresses);
+	uint64_t entry = elf_text_address() + assembler.offset(Interner::intern("_start"));
+	elf_write_executable(path, text, data, entry);
+}
 
-	return program;
+Jit_Image Compiler::compile_image() {
+	X86Assembler assembler;
+	encode_program(assembler);
+
+	Jit_Image image = jit_map(assembler.size(), data_size(module));
+	std::vector<uint64_t> string_addresses;
+	std::vector<uint8_t> data = build_data(jit_data_address(image), string_addresses);
+	const std::vector<uint8_t>& text = assembler.link(string_addresses);
+	image.entry = assembler.offset(Interner::intern("main"));
+	jit_load(image, text, data);
+	return image;
 }
 
 std::string Compiler::compile_builtin() {
@@ -41,449 +89,709 @@ std::string Compiler::compile_builtin() {
 		builtin_functions += Utils::read_file(BUILTIN_PATH + source);
 	}
 
-	global_function_register["printint"] = std::vector<VarType> {VAR_TYPE(VAR_TYPE_INT, 0)}; // printint.asm
-	global_function_register["__syscall1"] = std::vector<VarType> {VAR_TYPE(VAR_TYPE_ANY, 0)};
-	global_function_register["__syscall2"] = std::vector<VarType> {VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0)};
-	global_function_register["__syscall3"] = std::vector<VarType> {VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0)};
-	global_function_register["__syscall4"] = std::vector<VarType> {VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0)};
-	global_function_register["__syscall5"] = std::vector<VarType> {VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0)};
+	return builtin_functions;
+}
 
-	// disabled until fixing 6 parameter limitation on function calls
-	// global_function_register["__syscall6"] = std::vector<VarType> {VAR_TYPE(VAR_TYPE_ANY, 0)};
+static void emit(Shared_Info& si, X86Opcode opcode, X86_Operand a = {}, X86_Operand b = {}) {
+	si.code.push_back(x86_instruction(opcode, a, b));
+}
 
-	return builtin_functions;
+static void emit_condition(Shared_Info& si, X86Opcode opcode, X86Condition condition, X86_Operand a) {
+	X86_Instruction instruction = x86_instruction(opcode, a);
+	instruction.condition = condition;
+	si.code.push_back(instruction);
 }
 
-std::string Compiler::compile_function(std::shared_ptr<Statement> function) {
-	Shared_Info si;
-	std::stringstream body;
-	si.rbp_offset = 0;
-	si.if_counter = 0;
-	si.while_counter = 0;
-	if (function->fnc->arguments.size() > 6) {
-		Utils::error("No more than 6 arguments on functions are allowed.");
+/**
+ * @brief Order to emit the blocks of function in. It is the order of their
+ * indexes, except that the header of every while loop moves after the body.
+ * The test then sits at the bottom: entering the loop takes one jump to it,
+ * and every iteration after that takes a single branch back to the top.
+ */
+static std::vector<Block_Index> layout_blocks(const Ir_Function& function) {
+	size_t count = function.blocks.size();
+	std::vector<Block_Index> order(count);
+	std::vector<size_t> positions(count);
+	for (Block_Index block = 0; block < count; block++) {
+		order[block] = block;
+		positions[block] = block;
+	}
+
+	// a jump back from a later block closes a loop over every block in between
+	std::vector<Block_Index> last_latch(count, BLOCK_NONE);
+	for (Block_Index block = 0; block < count; block++) {
+		if (function.blocks[block].instructions.empty()) {
+			continue;
+		}
+		for_each_successor(function.blocks[block].instructions.back(), [&](Block_Index successor) {
+			if (successor <= block && (last_latch[successor] == BLOCK_NONE || last_latch[successor] < block)) {
+				last_latch[successor] = block;
+			}
+		});
+	}
+
+	// the function is entered on its first block, which never moves
+	std::vector<std::pair<Block_Index, Block_Index>> loops;
+	for (Block_Index header = 1; header < count; header++) {
+		Block_Index latch = last_latch[header];
+		if (latch == BLOCK_NONE || latch == header) {
+			continue;
+		}
+		auto inside = [&](Block_Index block) {
+			return block >= header && block <= latch;
+		};
+
+		// the header tests whether to leave, and the rest is only entered through it
+		const Ir_Instruction& test = function.blocks[header].instructions.back();
+		bool rotatable = test.opcode == IR_OP_BR && inside(test.target) != inside(test.other);
+		for (Block_Index block = 0; block < count && rotatable; block++) {
+			if (inside(block) || function.blocks[block].instructions.empty()) {
+				continue;
+			}
+			for_each_successor(function.blocks[block].instructions.back(), [&](Block_Index successor) {
+				rotatable = rotatable && (successor == header || !inside(successor));
+			});
+		}
+		if (rotatable) {
+			loops.push_back({header, latch});
+		}
 	}
 
-	std::vector<VarType> data_types;
-	int param_counter = 0;
-	for (std::shared_ptr<Func_Arg> arg: function->fnc->arguments) {
-		inc_rbp_offset(si.rbp_offset, arg->type);
-		std::string reg = get_reg_by_data_type_and_counter(param_counter, arg->type);
-		std::string data_size = get_data_size_by_data_type(arg->type);
-		body << "\tmov " << data_size <<  " [rbp - " << si.rbp_offset << "], " << reg << "\n";
-		si.var_declare[arg->name] = {.rbp_offset = si.rbp_offset, .type = arg->type};
-		data_types.push_back(arg->type);
-		param_counter++;
-	}
-	global_function_register[function->fnc->name] = data_types;
+	// inner loops first, rotating them keeps the blocks of the outer ones together
+	std::sort(loops.begin(), loops.end(), [](const auto& a, const auto& b) {
+		return a.second - a.first < b.second - b.first;
+	});
+	for (const auto& [header, latch] : loops) {
+		size_t first = positions[header];
+		size_t size = latch - header + 1;
+		bool together = true;
+		for (Block_Index block = header; block <= latch; block++) {
+			together = together && positions[block] >= first && positions[block] < first + size;
+		}
+		if (!together) {
+			continue;
+		}
 
-	for (std::shared_ptr<Statement> stmt: function->fnc->body) {
-		body << compile_statement(stmt, si);
+		std::rotate(order.begin() + first, order.begin() + first + 1, order.begin() + first + size);
+		for (size_t i = first; i < first + size; i++) {
+			positions[order[i]] = i;
+		}
 	}
 
-	std::stringstream compiled_function;
-	compiled_function << function->fnc->name << ":\n\tpush rbp\n\tmov rbp, rsp\n\tsub rsp, " << si.rbp_offset << "\n";
-	compiled_function << body.str();
-	compiled_function << ".retpoint:\n\tadd rsp, " << si.rbp_offset << "\n\tpop rbp\n\tret\n";
-
-	return compiled_function.str();
+	return order;
 }
 
-std::string Compiler::compile_statement(std::shared_ptr<Statement> stmt, Shared_Info& si) {
-	static_assert(STMT_TYPE_COUNTER == 7, "Unhandled STMT_TYPE_COUNTER on compile_statement on compiler.cpp");
-	switch (stmt->type) {
-		case STMT_TYPE_EXPR: return compile_expr(stmt->expr, si);
-		case STMT_TYPE_RETURN: return compile_return(stmt, si);
-		case STMT_TYPE_VAR_DECLARATION: return compile_var(stmt, si);
-		case STMT_TYPE_VAR_REASIGNATION: return compile_var_reasignation(stmt, si);
-		case STMT_TYPE_IF: return compile_if(stmt, si);
-		case STMT_TYPE_WHILE: return compile_while(stmt, si);
-		default: Utils::error("Unknown expression"); exit(1);
+void Compiler::compile_functions(const std::function<void(const std::vector<X86_Instruction>&)>& consume) {
+	if (pool == nullptr) {
+		for (const Ir_Function& function: module.functions) {
+			consume(compile_function(function, peephole_stats));
+		}
+		return;
 	}
-}
 
-std::string Compiler::compile_while(std::shared_ptr<Statement> stmt, Shared_Info& si) {
-	std::stringstream ss;
-	int actual_while = si.while_counter++;
-	ss << ".WHILE" << actual_while << ":\n";
-	ss << compile_expr(stmt->whilee->condition, si);
-	ss << "\tcmp eax, 0\n\tje .ENDWHILE" << actual_while << "\n";
-	for (std::shared_ptr<Statement> stmts: stmt->whilee->block) {
-		ss << compile_statement(stmts, si);
+	// the functions of a batch compile in parallel, then go to consume in source order
+	size_t batch = pool->size() * COMPILE_BATCH_PER_THREAD;
+	std::vector<std::vector<X86_Instruction>> compiled(batch);
+	std::vector<Peephole_Stats> stats(batch);
+	for (size_t first = 0; first < module.functions.size(); first += batch) {
+		size_t count = std::min(batch, module.functions.size() - first);
+		for (size_t i = 0; i < count; i++) {
+			pool->submit([this, &compiled, &stats, first, i] {
+				compiled[i] = compile_function(module.functions[first + i], stats[i]);
+			});
+		}
+		pool->wait();
+		for (size_t i = 0; i < count; i++) {
+			consume(compiled[i]);
+		}
 	}
 
-	ss << "\tjmp .WHILE" << actual_while << "\n";
-	ss << ".ENDWHILE" << actual_while << ":\n";
-
-	return ss.str();
+	for (const Peephole_Stats& worker: stats) {
+		peephole_stats.hits.resize(std::max(peephole_stats.hits.size(), worker.hits.size()), 0);
+		for (size_t rule = 0; rule < worker.hits.size(); rule++) {
+			peephole_stats.hits[rule] += worker.hits[rule];
+		}
+	}
 }
 
-std::string Compiler::compile_if(std::shared_ptr<Statement> stmt, Shared_Info& si) {
-	std::stringstream ss;
-	ss << compile_expr(stmt->iif->condition, si);
-	ss << "\tcmp eax, 0\n\tje .ELSE" << si.if_counter << "\n";
-	for (std::shared_ptr<Statement> stmts: stmt->iif->then) {
-		ss << compile_statement(stmts, si);
+std::vector<X86_Instruction> Compiler::compile_function(const Ir_Function& function, Peephole_Stats& stats) {
+	Shared_Info si;
+	si.function = &function;
+	si.allocation = RegisterAllocator(function).allocate();
+	si.rbp_offset = 0;
+	si.rbp_offsets.assign(function.values + function.locals.size(), 0);
+	si.definitions.assign(function.values, nullptr);
+	for (const Ir_Block& block: function.blocks) {
+		for (const Ir_Instruction& instruction: block.instructions) {
+			if (instruction.dst != VALUE_NONE) {
+				si.definitions[instruction.dst] = &instruction;
+			}
+		}
 	}
-	ss << "\tjmp .ENDIF" << si.if_counter << "\n";
 
-	ss << ".ELSE" << si.if_counter << ":\n";
-	if (!stmt->iif->elsse.empty()) {
-		for (std::shared_ptr<Statement> stmts: stmt->iif->elsse) {
-			ss << compile_statement(stmts, si);
+	si.uses.assign(function.values, 0);
+	for (const Ir_Block& block: function.blocks) {
+		for (const Ir_Instruction& instruction: block.instructions) {
+			for_each_use(function, instruction, [&](Value value) {
+				si.uses[value]++;
+			});
 		}
 	}
-	ss << ".ENDIF" << si.if_counter++ << ":\n";
 
-	return ss.str();
-}
+	std::vector<Block_Index> order = layout_blocks(function);
+	for (size_t i = 0; i < order.size(); i++) {
+		Block_Index next = i + 1 < order.size() ? order[i + 1] : BLOCK_NONE;
+		const std::vector<Ir_Instruction>& instructions = function.blocks[order[i]].instructions;
+		emit(si, X86_LABEL, x86_label(order[i]));
+		for (size_t j = 0; j < instructions.size(); j++) {
+			if (j + 1 < instructions.size() && is_branch_condition(instructions[j], instructions[j + 1], si)) {
+				compile_compare_branch(instructions[j], instructions[j + 1], next, si);
+				j++;
+				continue;
+			}
+			compile_instruction(instructions[j], next, si);
+		}
+	}
+	emit(si, X86_LABEL, x86_label(X86_RETURN_LABEL));
+	compile_epilogue(si);
+	emit(si, X86_RET);
 
-std::string Compiler::compile_expr(std::shared_ptr<Expr> expr, Shared_Info& si) {
-	static_assert(EXPR_TYPE_COUNTER == 6, "Unhandled EXPR_TYPE_COUNTER in compiler_expr on compiler.cpp");
-	switch (expr->type) {
-		case EXPR_TYPE_FUNC_CALL: return compile_func_call(expr, si);
-		case EXPR_TYPE_LITERAL_BOOL: return compile_boolean(expr);
-		case EXPR_TYPE_LITERAL_NUMBER: return compile_number(expr);
-		case EXPR_TYPE_LITERAL_STRING: return compile_string(expr);
-		case EXPR_TYPE_VAR_READ: return compile_var_read(expr, si);
-		case EXPR_TYPE_OP: return compile_op(expr, si);
-		default: Utils::error("Unknown expression"); exit(1);
+	// callee saved registers are pushed right below rbp and the slots go
+	// after them, so the epilogue only needs rbp to find them
+	std::vector<X86_Instruction> prologue = {
+		x86_instruction(X86_PUSH, x86_register(X86_RBP)),
+		x86_instruction(X86_MOV, x86_register(X86_RBP), x86_register(X86_RSP))
+	};
+	for (int reg: si.allocation.saved) {
+		prologue.push_back(x86_instruction(X86_PUSH, x86_register(allocatable_regs[reg])));
 	}
+	if (si.rbp_offset > 0) {
+		prologue.push_back(x86_instruction(X86_SUB, x86_register(X86_RSP), x86_immediate(si.rbp_offset)));
+	}
+	si.code.insert(si.code.begin(), prologue.begin(), prologue.end());
+	PeepholeOptimizer(si.code, stats).optimize();
+	si.code.insert(si.code.begin(), x86_instruction(X86_LABEL, x86_function(function.name)));
+
+	return si.code;
 }
 
-void Compiler::compile_op_tree(std::shared_ptr<Expr> expr, std::stack<std::shared_ptr<Expr>>& expr_stack, std::stack<OpType>& op_stack) {
-	if (expr->type == EXPR_TYPE_OP) {
-		op_stack.push(expr->op->type);
-		compile_op_tree(expr->op->lhs, expr_stack, op_stack);
-		compile_op_tree(expr->op->rhs, expr_stack, op_stack);
+void Compiler::compile_epilogue(Shared_Info& si) {
+	if (si.allocation.saved.empty()) {
+		emit(si, X86_MOV, x86_register(X86_RSP), x86_register(X86_RBP));
 	} else {
-		expr_stack.push(expr);
+		emit(si, X86_LEA, x86_register(X86_RSP), x86_memory(0, X86_RBP, -8 * (int64_t) si.allocation.saved.size()));
 	}
+	for (auto reg = si.allocation.saved.rbegin(); reg != si.allocation.saved.rend(); reg++) {
+		emit(si, X86_POP, x86_register(allocatable_regs[*reg]));
+	}
+	emit(si, X86_POP, x86_register(X86_RBP));
 }
 
-std::string Compiler::compile_op(std::shared_ptr<Expr> expr, Shared_Info& si) {
-	std::stack<std::shared_ptr<Expr>> expr_stack;
-	std::stack<OpType> op_stack;
-	compile_op_tree(expr, expr_stack, op_stack);
-
-	std::stringstream ss;
-	std::shared_ptr<Expr> cexpr = expr_stack.top();
-	expr_stack.pop();
-	ss << compile_expr(cexpr, si) << "\tmov rbx, rax\n";
-
-	while(!op_stack.empty()) {
-		cexpr = expr_stack.top();
-		expr_stack.pop();
-		ss << "\txor rax, rax\n";
-		ss << compile_expr(cexpr, si);
-		ss << compile_operation(op_stack.top());
-		op_stack.pop();
+void Compiler::compile_instruction(const Ir_Instruction& instruction, Block_Index next, Shared_Info& si) {
+	static_assert(IR_OP_COUNTER == 15, "Unhandled IR_OP_COUNTER on compile_instruction on compiler.cpp");
+	switch (instruction.opcode) {
+		// rematerialized on every use
+		case IR_OP_CONST:
+		case IR_OP_STRING:
+			break;
+
+		case IR_OP_PARAM:
+			emit(si, X86_MOV, location(instruction.dst, IR_TYPE_I64, si), x86_register(x64regs[instruction.imm]));
+			break;
+
+		case IR_OP_BINARY: compile_binary(instruction, si); break;
+
+		case IR_OP_NEG:
+		case IR_OP_NOT:
+			emit(si, X86_MOV, x86_register(X86_RAX), source(instruction.a, si));
+			emit(si, instruction.opcode == IR_OP_NEG ? X86_NEG : X86_NOT, x86_register(X86_RAX));
+			compile_result(instruction.dst, si);
+			break;
+
+		case IR_OP_LOAD_LOCAL: compile_load_local(instruction, si); break;
+		case IR_OP_STORE_LOCAL: compile_store_local(instruction, si); break;
+		case IR_OP_LOAD: compile_load(instruction, si); break;
+		case IR_OP_STORE: compile_store(instruction, si); break;
+		case IR_OP_CALL:
+		case IR_OP_TAIL_CALL:
+			compile_call(instruction, si);
+			break;
+
+		case IR_OP_JMP:
+			if (instruction.target != next) {
+				emit(si, X86_JMP, x86_label(instruction.target));
+			}
+			break;
+
+		case IR_OP_BR: compile_branch(instruction, next, si); break;
+
+		case IR_OP_RET:
+			if (instruction.a != VALUE_NONE) {
+				emit(si, X86_MOV, x86_register(X86_RAX), source(instruction.a, si));
+			}
+			emit(si, X86_JMP, x86_label(X86_RETURN_LABEL));
+			break;
+
+		default: Utils::error("Unknown IR instruction"); exit(1);
 	}
+}
 
-	ss << "\tmov rax, rbx\n";
-	return ss.str();
+static X86Condition condition_code(OpType op) {
+	static_assert(OP_TYPE_COUNT == 18, "Unhandled OP_TYPE_COUNT on condition_code() at compiler.cpp");
+	switch (op) {
+		case OP_TYPE_LT: return X86_CC_L;
+		case OP_TYPE_GT: return X86_CC_G;
+		case OP_TYPE_EQ: return X86_CC_E;
+		case OP_TYPE_NEQ: return X86_CC_NE;
+		case OP_TYPE_LTE: return X86_CC_LE;
+		case OP_TYPE_GTE: return X86_CC_GE;
+		default: Utils::error("Unknown comparison: " + std::to_string(op)); exit(1);
+	}
 }
 
-std::string Compiler::compile_operation(OpType type) {
-	static_assert(OP_TYPE_COUNT == 10, "Unhandled OP_TYPE_COUNT on compile_operation() at compiler.cpp");
-	switch (type) {
-		case OP_TYPE_ADD:
-			return "\tadd rbx, rax\n";
-
-		case OP_TYPE_SUB:
-			return "\tsub rax, rbx\n"
-				   "\tmov rbx, rax\n";
-
-		case OP_TYPE_DIV: 
-		 	return "\tpush rdx\n"
-			 	   "\txor rdx, rdx\n"
-				   "\tidiv rbx\n"
-				   "\tmov rbx, rax\n"
-				   "\tpop rdx\n";
-	 
-		case OP_TYPE_MOD: 
-		 	return "\tmov rcx, rax\n"
-				   "\tmov rax, rbx\n"
-				   "\tmov rbx, rcx\n"
-				   "\tpush rdx\n"
-				   "\txor rdx, rdx\n"
-				   "\tidiv rbx\n"
-				   "\tmov rbx, rdx\n"
-				   "\tpop rdx\n";
-
-		case OP_TYPE_MUL:
-			return "\timul rax, rbx\n"
-				   "\tmov rbx, rax\n";
+void Compiler::compile_binary(const Ir_Instruction& instruction, Shared_Info& si) {
+	static_assert(OP_TYPE_COUNT == 18, "Unhandled OP_TYPE_COUNT on compile_binary() at compiler.cpp");
+	const X86_Operand rax = x86_register(X86_RAX);
+	const X86_Operand rcx = x86_register(X86_RCX);
+	emit(si, X86_MOV, rax, source(instruction.a, si));
+	// division and shifts take their rhs on rcx themselves
+	X86_Operand rhs = {};
+	if (instruction.op != OP_TYPE_DIV && instruction.op != OP_TYPE_MOD && instruction.op != OP_TYPE_SHL && instruction.op != OP_TYPE_SHR) {
+		rhs = alu_source(instruction.b, si);
+	}
+
+	switch (instruction.op) {
+		case OP_TYPE_ADD: emit(si, X86_ADD, rax, rhs); break;
+		case OP_TYPE_SUB: emit(si, X86_SUB, rax, rhs); break;
+		case OP_TYPE_MUL: emit(si, X86_IMUL, rax, rhs); break;
+		case OP_TYPE_BIT_AND: emit(si, X86_AND, rax, rhs); break;
+		case OP_TYPE_BIT_OR: emit(si, X86_OR, rax, rhs); break;
+		case OP_TYPE_BIT_XOR: emit(si, X86_XOR, rax, rhs); break;
+
+		case OP_TYPE_DIV:
+		case OP_TYPE_MOD:
+			// division by zero still traps at runtime
+			if (si.definitions[instruction.b]->opcode == IR_OP_CONST && si.definitions[instruction.b]->imm != 0) {
+				compile_constant_division(instruction.op, si.definitions[instruction.b]->imm, si);
+				break;
+			}
+			emit(si, X86_MOV, rcx, source(instruction.b, si));
+			emit(si, X86_CQO);
+			emit(si, X86_IDIV, rcx);
+			if (instruction.op == OP_TYPE_MOD) {
+				emit(si, X86_MOV, rax, x86_register(X86_RDX));
+			}
+			break;
+
+		case OP_TYPE_SHL:
+		case OP_TYPE_SHR:
+			emit(si, X86_MOV, rcx, source(instruction.b, si));
+			emit(si, instruction.op == OP_TYPE_SHL ? X86_SHL : X86_SAR, rax);
+			break;
 
 		case OP_TYPE_LT:
-			return "\tcmp rax, rbx\n"
-				   "\tsetl al\n"
-				   "\tmovzx rbx, al\n";
-
 		case OP_TYPE_GT:
-			return "\tcmp rax, rbx\n"
-				   "\tsetg al\n"
-				   "\tmovzx rbx, al\n";
-
 		case OP_TYPE_EQ:
-			return "\tcmp rbx, rax\n"
-				   "\tsete al\n"
-				   "\tmovzx rbx, al\n";
-
 		case OP_TYPE_NEQ:
-			return "\tcmp rbx, rax\n"
-				   "\tsetne al\n"
-				   "\tmovzx rbx, al\n";
-
 		case OP_TYPE_LTE:
-			return "\tcmp rbx, rax\n"
-				   "\tsetle al\n"
-				   "\tmovzx rbx, al\n";
+		case OP_TYPE_GTE:
+			emit(si, X86_CMP, rax, rhs);
+			emit_condition(si, X86_SETCC, condition_code(instruction.op), x86_register(X86_RAX, 1));
+			emit(si, X86_MOVZX, rax, x86_register(X86_RAX, 1));
+			break;
 
-		default: Utils::error("Unknown operation: " + type); exit(1);
+		default: Utils::error("Unknown operation: " + std::to_string(instruction.op)); exit(1);
 	}
+
+	compile_result(instruction.dst, si);
 }
 
-std::string Compiler::compile_var(std::shared_ptr<Statement> stmt, Shared_Info& si) {
-	std::stringstream ss;
-	if (si.var_declare.count(stmt->var->name) != 0) {
-		Utils::error("Variable already declared before: " + stmt->var->name);
+/**
+ * @brief Magic number and shift for the signed division by d, |d| >= 2,
+ * as in Hacker's Delight 10-1: x / d is the high half of x * multiplier
+ * shifted right by shift, once corrected for the sign
+ */
+static void signed_magic(int64_t d, int64_t& multiplier, int& shift) {
+	const uint64_t two63 = (uint64_t) 1 << 63;
+	uint64_t ad = d < 0 ? -(uint64_t) d : d;
+	uint64_t t = two63 + ((uint64_t) d >> 63);
+	uint64_t anc = t - 1 - t % ad;
+	uint64_t q1 = two63 / anc, r1 = two63 - q1 * anc;
+	uint64_t q2 = two63 / ad, r2 = two63 - q2 * ad;
+	uint64_t delta;
+	int p = 63;
+	do {
+		p++;
+		q1 *= 2;
+		r1 *= 2;
+		if (r1 >= anc) {
+			q1++;
+			r1 -= anc;
+		}
+		q2 *= 2;
+		r2 *= 2;
+		if (r2 >= ad) {
+			q2++;
+			r2 -= ad;
+		}
+		delta = ad - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+
+	multiplier = q2 + 1;
+	if (d < 0) {
+		multiplier = -(uint64_t) multiplier;
 	}
+	shift = p - 64;
+}
 
-	ss << compile_expr(stmt->var->value, si);
-	inc_rbp_offset(si.rbp_offset, stmt->var->type);
-	ss << "\tmov " << get_data_size_by_data_type(stmt->var->type) << "[rbp - " << si.rbp_offset << "], " << get_return_reg_by_data_type(stmt->var->type) << "\n";
-	si.var_declare[stmt->var->name] = {.rbp_offset = si.rbp_offset, .type = stmt->var->type};
-	return ss.str();
+/**
+ * @brief Operand for a 64 bit constant on an ALU instruction, moved to rcx
+ * when it doesn't fit on an imm32
+ */
+static X86_Operand alu_immediate(int64_t imm, Shared_Info& si) {
+	if (imm == (int32_t) imm) {
+		return x86_immediate(imm);
+	}
+	emit(si, X86_MOV, x86_register(X86_RCX), x86_immediate(imm));
+	return x86_register(X86_RCX);
 }
 
-std::string Compiler::compile_var_reasignation(std::shared_ptr<Statement> stmt, Shared_Info& si) {
-	std::stringstream ss;
-	if (si.var_declare.count(stmt->var->name) == 0) {
-		Utils::error("Trying to reasign an undeclared variable: " + stmt->var->name);
+void Compiler::compile_constant_division(OpType op, int64_t divisor, Shared_Info& si) {
+	const X86_Operand rax = x86_register(X86_RAX);
+	const X86_Operand rcx = x86_register(X86_RCX);
+	const X86_Operand rdx = x86_register(X86_RDX);
+	uint64_t magnitude = divisor < 0 ? -(uint64_t) divisor : divisor;
+
+	// x % 1 and x % -1 are always 0, x / -1 is a negation
+	if (magnitude == 1) {
+		if (op == OP_TYPE_MOD) {
+			emit(si, X86_MOV, rax, x86_immediate(0));
+		} else if (divisor < 0) {
+			emit(si, X86_NEG, rax);
+		}
+		return;
 	}
-	Var_Declared vd = si.var_declare[stmt->var->name];
 
-	ss << compile_expr(stmt->var->value, si);
+	if ((magnitude & (magnitude - 1)) == 0) {
+		// negative dividends are biased by |d| - 1 so the shift rounds towards zero
+		int k = std::countr_zero(magnitude);
+		emit(si, X86_MOV, rdx, rax);
+		emit(si, X86_SAR, rdx, x86_immediate(63));
+		emit(si, X86_SHR, rdx, x86_immediate(64 - k));
+		if (op == OP_TYPE_MOD) {
+			// the remainder takes the sign of the dividend, whatever the divisor sign
+			emit(si, X86_ADD, rdx, rax);
+			emit(si, X86_AND, rdx, alu_immediate(-(uint64_t) magnitude, si));
+			emit(si, X86_SUB, rax, rdx);
+			return;
+		}
+		emit(si, X86_ADD, rax, rdx);
+		emit(si, X86_SAR, rax, x86_immediate(k));
+		if (divisor < 0) {
+			emit(si, X86_NEG, rax);
+		}
+		return;
+	}
 
-	if (stmt->var->is_ptr) {
-		ss << "\tmov rbx, [rbp - " << vd.rbp_offset << "]\n";
-		VarType v;
-		v.type = vd.type.type;
-		v.stars = vd.type.stars - 1;
-		ss << "\tmov " << get_data_size_by_data_type(v) << " [rbx], " << get_return_reg_by_data_type(v) << "\n";
-		ss << "\tmov [rbp - " << vd.rbp_offset << "], rbx\n";
+	int64_t multiplier;
+	int shift;
+	signed_magic(divisor, multiplier, shift);
+	emit(si, X86_MOV, rcx, rax);
+	emit(si, X86_MOV, rax, x86_immediate(multiplier));
+	emit(si, X86_IMUL, rcx);
+	if (divisor > 0 && multiplier < 0) {
+		emit(si, X86_ADD, rdx, rcx);
+	} else if (divisor < 0 && multiplier > 0) {
+		emit(si, X86_SUB, rdx, rcx);
+	}
+	if (shift > 0) {
+		emit(si, X86_SAR, rdx, x86_immediate(shift));
+	}
+	// negative quotients round up by one towards zero
+	emit(si, X86_MOV, rax, rdx);
+	emit(si, X86_SHR, rax, x86_immediate(63));
+	emit(si, X86_ADD, rdx, rax);
+
+	if (op == OP_TYPE_MOD) {
+		if (divisor == (int32_t) divisor) {
+			emit(si, X86_IMUL, rdx, x86_immediate(divisor));
+		} else {
+			emit(si, X86_MOV, rax, x86_immediate(divisor));
+			emit(si, X86_IMUL, rdx, rax);
+		}
+		emit(si, X86_SUB, rcx, rdx);
+		emit(si, X86_MOV, rax, rcx);
 	} else {
-		ss << "\tmov [rbp - " << vd.rbp_offset << "], "  << get_return_reg_by_data_type(vd.type) << "\n";
+		emit(si, X86_MOV, rax, rdx);
 	}
-	return ss.str();
 }
 
-std::string Compiler::compile_var_read(std::shared_ptr<Expr> expr, Shared_Info& si) {
-	std::stringstream ss;
-	if (si.var_declare.count(expr->var_read.var_name) == 0) {
-		Utils::error("Undefined variable: " + expr->var_read.var_name);
+void Compiler::compile_load_local(const Ir_Instruction& instruction, Shared_Info& si) {
+	uint32_t local = si.function->values + instruction.imm;
+	int dst_reg = si.allocation.registers[instruction.dst];
+	if (si.allocation.registers[local] != REG_SPILLED) {
+		emit(si, X86_MOV, location(instruction.dst, IR_TYPE_I64, si), x86_register(allocatable_regs[si.allocation.registers[local]]));
+		return;
 	}
-	Var_Declared vd = si.var_declare[expr->var_read.var_name];
 
-	std::string last_return_reg = get_return_reg_by_data_type(vd.type);
-	ss << "\tmov " << last_return_reg << ", " << get_data_size_by_data_type(vd.type) << " [rbp - " << vd.rbp_offset << "]\n";
+	X86_Operand address = location(local, instruction.type, si);
+	if (dst_reg != REG_SPILLED) {
+		compile_memory_load(instruction.type, allocatable_regs[dst_reg], address, si);
+		return;
+	}
+	compile_memory_load(instruction.type, X86_RAX, address, si);
+	compile_result(instruction.dst, si);
+}
 
-	
-	while (expr->var_read.stars-- > 0) {
-		vd.type.stars -= 1;
-		ss << "\tmov " << get_return_reg_by_data_type(vd.type) << ", " << get_data_size_by_data_type(vd.type) << " [" << last_return_reg << "]" << "\n";
-		last_return_reg = get_return_reg_by_data_type(vd.type);
-		if (last_return_reg == "al") {
-			ss << "\tmovzx rax, al\n";
-		}
+void Compiler::compile_store_local(const Ir_Instruction& instruction, Shared_Info& si) {
+	uint32_t local = si.function->values + instruction.imm;
+	int reg = si.allocation.registers[local];
+	X86_Operand value = sized_source(instruction.a, instruction.type, si);
+	if (reg == REG_SPILLED) {
+		emit(si, X86_MOV, location(local, instruction.type, si), value);
+		return;
 	}
 
-	return ss.str();
+	// registers hold the value extended as a load from the slot would leave it
+	X86_Operand dst = x86_register(allocatable_regs[reg]);
+	if (instruction.type == IR_TYPE_I64 || si.definitions[instruction.a]->opcode == IR_OP_CONST) {
+		emit(si, X86_MOV, dst, value);
+	} else if (instruction.type == IR_TYPE_I32) {
+		emit(si, X86_MOVSXD, dst, value);
+	} else {
+		emit(si, X86_MOVZX, dst, value);
+	}
 }
 
-std::string Compiler::compile_boolean(std::shared_ptr<Expr> expr) {
-	std::string compiled_boolean;
-	if (expr->boolean) {
-		compiled_boolean = "\tmov rax, 1\n";
+void Compiler::compile_load(const Ir_Instruction& instruction, Shared_Info& si) {
+	X86Register base;
+	if (si.allocation.registers[instruction.a] == REG_SPILLED || is_constant(instruction.a, si)) {
+		emit(si, X86_MOV, x86_register(X86_RAX), source(instruction.a, si));
+		base = X86_RAX;
 	} else {
-		compiled_boolean = "\tmov rax, 0\n";
+		base = allocatable_regs[si.allocation.registers[instruction.a]];
 	}
 
-	return compiled_boolean;
+	X86_Operand address = x86_memory(get_data_size_by_type(instruction.type), base);
+	int dst_reg = si.allocation.registers[instruction.dst];
+	if (dst_reg != REG_SPILLED) {
+		compile_memory_load(instruction.type, allocatable_regs[dst_reg], address, si);
+		return;
+	}
+	compile_memory_load(instruction.type, X86_RAX, address, si);
+	compile_result(instruction.dst, si);
 }
 
-std::string Compiler::compile_number(std::shared_ptr<Expr> expr) {
-	std::stringstream compiled_number;
-	compiled_number << "\tmov rax, " ;
-	compiled_number << expr->number;
-	compiled_number << "\n";
+void Compiler::compile_store(const Ir_Instruction& instruction, Shared_Info& si) {
+	X86Register base;
+	if (si.allocation.registers[instruction.a] == REG_SPILLED || is_constant(instruction.a, si)) {
+		emit(si, X86_MOV, x86_register(X86_RCX), source(instruction.a, si));
+		base = X86_RCX;
+	} else {
+		base = allocatable_regs[si.allocation.registers[instruction.a]];
+	}
 
-	return compiled_number.str();
+	X86_Operand value = sized_source(instruction.b, instruction.type, si);
+	emit(si, X86_MOV, x86_memory(get_data_size_by_type(instruction.type), base), value);
 }
 
-std::string Compiler::compile_string(std::shared_ptr<Expr> expr) {
-	int data_identifier = string_data_segment.size();
-	std::string compiled_string;
-	char tmp[6] = {0};
-	for (int i = 0; i < (int) expr->string.length(); i++) {
-		sprintf(tmp, "0x%02x,", expr->string[i]);
-		compiled_string += tmp;
+void Compiler::compile_call(const Ir_Instruction& instruction, Shared_Info& si) {
+	// values never live on argument registers, they are filled in any order
+	for (uint32_t i = 0; i < instruction.args.count; i++) {
+		emit(si, X86_MOV, x86_register(x64regs[i]), source(si.function->call_args[instruction.args.first + i], si));
 	}
-	compiled_string += "0x00\n"; 
-	string_data_segment.push_back(compiled_string);
-
-	char str[3] = {0};
-	sprintf(str, "V%d", data_identifier);
-
-	return "\tmov rax, " + std::string(str) + "\n";
-}
 
-std::string Compiler::compile_func_call(std::shared_ptr<Expr> expr, Shared_Info& si) {
-	std::stringstream compiled_func_call;
-	if (expr->func_call->expr.size() > 6) {
-		Utils::error("Max number of params allowed in functions: 6");
+	// the callee returns straight to our caller
+	if (instruction.opcode == IR_OP_TAIL_CALL) {
+		compile_epilogue(si);
+		emit(si, X86_JMP, x86_function(instruction.callee));
+		return;
 	}
 
-	// Check if function is declared
-	int func = global_function_register.count(expr->func_call->name);
-	if (func == 0) {
-		Utils::error("Undefined function: " + expr->func_call->name);
+	emit(si, X86_CALL, x86_function(instruction.callee));
+	if (instruction.dst != VALUE_NONE) {
+		compile_result(instruction.dst, si);
 	}
+}
 
-	std::vector<VarType> data_type = global_function_register[expr->func_call->name];
-	if (expr->func_call->expr.size() != data_type.size()) {
-		Utils::error("Unexpected number of arguments on function call");
+/**
+ * @brief Jump to target when condition holds and to other otherwise, falling
+ * through to whichever of them is next
+ */
+static void emit_branch(Shared_Info& si, X86Condition condition, Block_Index target, Block_Index other, Block_Index next) {
+	if (target == next) {
+		emit_condition(si, X86_JCC, x86_negate(condition), x86_label(other));
+		return;
 	}
 
-	int param_counter = 0;
+	emit_condition(si, X86_JCC, condition, x86_label(target));
+	if (other != next) {
+		emit(si, X86_JMP, x86_label(other));
+	}
+}
 
-	// Calc registers used by functions
-	std::vector<std::string> func_regs;
-	std::vector<std::string> rest_regs;
-	// First parse the func calls for avoiding problems with the registers
-	for (std::shared_ptr<Expr> expr: expr->func_call->expr) {
-		if (expr->type == EXPR_TYPE_FUNC_CALL) {
-			func_regs.push_back(get_reg_by_data_type_and_counter(param_counter, data_type[param_counter]));
-		} else {
-			rest_regs.push_back(get_reg_by_data_type_and_counter(param_counter, data_type[param_counter]));
+void Compiler::compile_branch(const Ir_Instruction& instruction, Block_Index next, Shared_Info& si) {
+	if (is_constant(instruction.a, si)) {
+		// string addresses are never null
+		const Ir_Instruction* definition = si.definitions[instruction.a];
+		bool condition = definition->opcode == IR_OP_STRING || definition->imm != 0;
+		Block_Index taken = condition ? instruction.target : instruction.other;
+		if (taken != next) {
+			emit(si, X86_JMP, x86_label(taken));
 		}
+		return;
+	}
 
-		param_counter++;
+	int reg = si.allocation.registers[instruction.a];
+	if (reg != REG_SPILLED) {
+		emit(si, X86_TEST, x86_register(allocatable_regs[reg]), x86_register(allocatable_regs[reg]));
+	} else {
+		emit(si, X86_CMP, location(instruction.a, IR_TYPE_I64, si), x86_immediate(0));
 	}
+	emit_branch(si, X86_CC_NE, instruction.target, instruction.other, next);
+}
 
-	param_counter = 0;
-	int index_counter = 0;
-	for (std::shared_ptr<Expr> expr: expr->func_call->expr) {
-		if (expr->type == EXPR_TYPE_FUNC_CALL) {
-			compiled_func_call << compile_expr(expr, si);
-			compiled_func_call << "\tmov " + func_regs[index_counter++] + ", " +  get_return_reg_by_data_type(data_type[param_counter]) + "\n";
-		}
+bool Compiler::is_branch_condition(const Ir_Instruction& comparison, const Ir_Instruction& branch, Shared_Info& si) {
+	static_assert(OP_TYPE_COUNT == 18, "Unhandled OP_TYPE_COUNT on is_branch_condition() at compiler.cpp");
+	if (comparison.opcode != IR_OP_BINARY || branch.opcode != IR_OP_BR || branch.a != comparison.dst || si.uses[comparison.dst] != 1) {
+		return false;
+	}
 
-		param_counter++;
+	switch (comparison.op) {
+		case OP_TYPE_LT:
+		case OP_TYPE_GT:
+		case OP_TYPE_EQ:
+		case OP_TYPE_NEQ:
+		case OP_TYPE_LTE:
+		case OP_TYPE_GTE:
+			return true;
+		default:
+			return false;
 	}
+}
 
-	param_counter = 0;
-	index_counter = 0;
-	for (std::shared_ptr<Expr> expr: expr->func_call->expr) {
-		if (expr->type != EXPR_TYPE_FUNC_CALL) {
-			compiled_func_call << compile_expr(expr, si);
-			compiled_func_call << "\tmov " + rest_regs[index_counter++] + ", " + get_return_reg_by_data_type(data_type[param_counter]) + "\n";
-		}
+void Compiler::compile_compare_branch(const Ir_Instruction& comparison, const Ir_Instruction& branch, Block_Index next, Shared_Info& si) {
+	// nothing runs between the comparison and the branch, its operands are still in place
+	emit(si, X86_MOV, x86_register(X86_RAX), source(comparison.a, si));
+	emit(si, X86_CMP, x86_register(X86_RAX), alu_source(comparison.b, si));
+	emit_branch(si, condition_code(comparison.op), branch.target, branch.other, next);
+}
 
-		param_counter++;
+void Compiler::compile_memory_load(IrType type, X86Register reg, X86_Operand address, Shared_Info& si) {
+	static_assert(IR_TYPE_COUNTER == 3, "Unhandled IR_TYPE_COUNTER on compile_memory_load at compiler.cpp");
+	switch (type) {
+		case IR_TYPE_I64: emit(si, X86_MOV, x86_register(reg), address); break;
+		case IR_TYPE_I32: emit(si, X86_MOVSXD, x86_register(reg), address); break;
+		case IR_TYPE_I8: emit(si, X86_MOVZX, x86_register(reg), address); break;
+		default: Utils::error("Unknown datatype"); exit(1);
 	}
-
-	compiled_func_call << "\tcall " + expr->func_call->name + "\n";
-	return compiled_func_call.str();
 }
 
-std::string Compiler::compile_return(std::shared_ptr<Statement> stmt, Shared_Info& si) {
-	std::stringstream compiled_return;
-	compiled_return << compile_expr(stmt->expr, si) << "\tjmp .retpoint\n";
+void Compiler::compile_result(Value dst, Shared_Info& si) {
+	emit(si, X86_MOV, location(dst, IR_TYPE_I64, si), x86_register(X86_RAX));
+}
 
-	return compiled_return.str();
+bool Compiler::is_constant(Value value, Shared_Info& si) {
+	return si.definitions[value]->opcode == IR_OP_CONST || si.definitions[value]->opcode == IR_OP_STRING;
 }
 
-void Compiler::inc_rbp_offset(int& rbp_offset, VarType data_type) {
-	static_assert(VAR_TYPE_COUNTER == 5, "Unhandled VAR_TYPE_COUNTER on inc_rbp_offset on compiler.cpp");
-	if (data_type.stars > 0) {
-		rbp_offset += 8;
-		return;
+X86_Operand Compiler::location(uint32_t id, IrType type, Shared_Info& si) {
+	int reg = si.allocation.registers[id];
+	if (reg != REG_SPILLED) {
+		return x86_register(allocatable_regs[reg]);
 	}
 
-	switch (data_type.type) {
-		case VAR_TYPE_LONG: rbp_offset += 8; break;
-		case VAR_TYPE_ANY: rbp_offset += 8; break;
-		case VAR_TYPE_INT: rbp_offset += 4; break;
-		case VAR_TYPE_BOOL: rbp_offset += 4; break;
-		case VAR_TYPE_CHAR: rbp_offset += 1; break;
-		default: Utils::error("Unknown datatype");
+	if (si.rbp_offsets[id] == 0) {
+		inc_rbp_offset(si.rbp_offset, type);
+		si.rbp_offsets[id] = si.rbp_offset;
 	}
+	int64_t offset = si.allocation.saved.size() * 8 + si.rbp_offsets[id];
+	return x86_memory(get_data_size_by_type(type), X86_RBP, -offset);
 }
 
-std::string Compiler::get_reg_by_data_type_and_counter(int& counter, VarType data_type) {
-	static_assert(VAR_TYPE_COUNTER == 5, "Unhandled VAR_TYPE_COUNTER on get_reg_by_data_type_and_counter on compiler.cpp");
-	if (data_type.stars > 0) {
-		return x64regs[counter];
+X86_Operand Compiler::source(Value value, Shared_Info& si) {
+	const Ir_Instruction* definition = si.definitions[value];
+	if (definition->opcode == IR_OP_CONST) {
+		return x86_immediate(definition->imm);
+	} else if (definition->opcode == IR_OP_STRING) {
+		return x86_string(definition->imm);
 	}
 
-	switch (data_type.type) {
-		case VAR_TYPE_LONG: return x64regs[counter];
-		case VAR_TYPE_ANY: return x64regs[counter];
-		case VAR_TYPE_INT: return x32regs[counter];
-		case VAR_TYPE_BOOL: return x8regs[counter];
-		case VAR_TYPE_CHAR: return x8regs[counter];
-		default: Utils::error("Unknown datatype"); exit(1);
+	return location(value, IR_TYPE_I64, si);
+}
+
+X86_Operand Compiler::alu_source(Value value, Shared_Info& si) {
+	const Ir_Instruction* definition = si.definitions[value];
+	if ((definition->opcode == IR_OP_CONST && definition->imm != (int32_t) definition->imm) || definition->opcode == IR_OP_STRING) {
+		emit(si, X86_MOV, x86_register(X86_RCX), source(value, si));
+		return x86_register(X86_RCX);
 	}
+
+	return source(value, si);
 }
 
-std::string Compiler::get_return_reg_by_data_type(VarType data_type) {
-	static_assert(VAR_TYPE_COUNTER == 5, "Unhandled VAR_TYPE_COUNTER on get_reg_by_data_type_and_counter on compiler.cpp");
-	if (data_type.stars > 0) {
-		return "rax";
+X86_Operand Compiler::sized_source(Value value, IrType type, Shared_Info& si) {
+	const Ir_Instruction* definition = si.definitions[value];
+	if (definition->opcode == IR_OP_CONST) {
+		// truncated and extended as the store and reload would do
+		int64_t imm = definition->imm;
+		if (type == IR_TYPE_I32) {
+			imm = (int32_t) imm;
+		} else if (type == IR_TYPE_I8) {
+			imm = (uint8_t) imm;
+		} else if (imm != (int32_t) imm) {
+			emit(si, X86_MOV, x86_register(X86_RAX), x86_immediate(imm));
+			return x86_register(X86_RAX);
+		}
+		return x86_immediate(imm);
 	}
 
-	switch (data_type.type) {
-		case VAR_TYPE_LONG: return "rax";
-		case VAR_TYPE_ANY: return "rax";
-		case VAR_TYPE_INT: return "eax";
-		case VAR_TYPE_BOOL: return "al";
-		case VAR_TYPE_CHAR: return "al";
-		default: Utils::error("Unknown datatype"); exit(1);
+	int reg = si.allocation.registers[value];
+	if (reg != REG_SPILLED && definition->opcode != IR_OP_STRING) {
+		return x86_register(allocatable_regs[reg], get_data_size_by_type(type));
 	}
+
+	emit(si, X86_MOV, x86_register(X86_RAX), source(value, si));
+	return x86_register(X86_RAX, get_data_size_by_type(type));
 }
 
-std::string Compiler::get_data_size_by_data_type(VarType data_type) {
-	static_assert(VAR_TYPE_COUNTER == 5, "Unhandled VAR_TYPE_COUNTER on get_data_size_by_data_type an compiler.cpp");
-	if (data_type.stars > 0) {
-		return "qword";
+void Compiler::inc_rbp_offset(int& rbp_offset, IrType type) {
+	static_assert(IR_TYPE_COUNTER == 3, "Unhandled IR_TYPE_COUNTER on inc_rbp_offset on compiler.cpp");
+	switch (type) {
+		case IR_TYPE_I64: rbp_offset += 8; break;
+		case IR_TYPE_I32: rbp_offset += 4; break;
+		case IR_TYPE_I8: rbp_offset += 1; break;
+		default: Utils::error("Unknown datatype");
 	}
+}
 
-	switch (data_type.type) {
-		case VAR_TYPE_LONG: return "qword";
-		case VAR_TYPE_ANY: return "qword";
-		case VAR_TYPE_INT: return "dword";
-		case VAR_TYPE_BOOL: return "byte";
-		case VAR_TYPE_CHAR: return "byte";
+uint8_t Compiler::get_data_size_by_type(IrType type) {
+	static_assert(IR_TYPE_COUNTER == 3, "Unhandled IR_TYPE_COUNTER on get_data_size_by_type an compiler.cpp");
+	switch (type) {
+		case IR_TYPE_I64: return 8;
+		case IR_TYPE_I32: return 4;
+		case IR_TYPE_I8: return 1;
 		default: Utils::error("Unknown datatype"); exit(1);
 	}
 }
 
-std::string Compiler::build_data_segment() {
-	std::stringstream compiled_data_segment;
-	compiled_data_segment << "segment .data\n";
-	int c = 0;
-	for (const std::string& str: string_data_segment) {
-		compiled_data_segment << "\tV" << c++ << " db " << str;
+void Compiler::build_data_segment(OutputSink& out) {
+	static const char hex_digits[] = "0123456789abcdef";
+	out.append("segment .data\n");
+	for (size_t i = 0; i < module.strings.size(); i++) {
+		out.append("\tV").append_number(i).append(" db ");
+		for (unsigned char c: module.strings[i]) {
+			out.append("0x").append(hex_digits[c >> 4]).append(hex_digits[c & 15]).append(',');
+		}
+		out.append("0x00\n");
 	}
-
-	return compiled_data_segment.str();
 }
 
-std::string Compiler::build_bss_segment() {
-	std::stringstream compiled_bss_segment;
-	compiled_bss_segment << "segment .bss\n";
+void Compiler::build_bss_segment(OutputSink& out) {
+	out.append("segment .bss\n");
 	// TODO: global variables
-	return compiled_bss_segment.str();
+}
+
+void Compiler::print_peephole_stats() {
+	PeepholeOptimizer::print_stats(peephole_stats);
 }
@@ -1,63 +1,173 @@
 #pragma once
+#include <functional>
+#include <string>
 #include <vector>
-#include <map>
-#include <stack>
-#include "parser.hpp"
-#include "lexer.hpp"
+#include "assembler.hpp"
+#include "ir.hpp"
+#include "jit.hpp"
+#include "peephole.hpp"
+#include "register_allocator.hpp"
+#include "thread_pool.hpp"
+#include "x86.hpp"
 
 typedef struct {
+	const Ir_Function* function;
+	Register_Allocation allocation;
+	// size of the slots, below the callee saved registers pushed
 	int rbp_offset;
-	VarType type;
-} Var_Declared;
-
-typedef struct {
-	int rbp_offset;
-	int if_counter;
-	int while_counter;
-	std::map<std::string, Var_Declared> var_declare;
+	// slot of every spilled value, 0 until it is first used
+	std::vector<int> rbp_offsets;
+	// instruction defining every virtual register
+	std::vector<const Ir_Instruction*> definitions;
+	// times every virtual register is read
+	std::vector<uint32_t> uses;
+	// instructions selected so far for the body of the function
+	std::vector<X86_Instruction> code;
 } Shared_Info;
 
 // Registers order for function parameters
-const std::vector<std::string> x64regs = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
-const std::vector<std::string> x32regs = {"edi", "esi", "edx", "ecx", "r8d", "r9d"};
-const std::vector<std::string> x16regs = {"di", "si", "dx", "cx", "r8w", "r9w"};
-const std::vector<std::string> x8regs = {"dil", "sil", "dl", "cl", "r8b", "r9b"};
+const std::vector<X86Register> x64regs = {X86_RDI, X86_RSI, X86_RDX, X86_RCX, X86_R8, X86_R9};
 const std::string BUILTIN_PATH = "./builtin/";
+// Functions compiled at once per worker, bounds the code held before it is written
+#define COMPILE_BATCH_PER_THREAD 8
 
+/**
+ * @brief x86-64 backend, selects instructions for the IR. rax, rcx and rdx
+ * are scratch, every other value lives where the register allocator placed
+ * it. The instructions of every function go through the peephole optimizer
+ * before they are printed as NASM or encoded straight into an executable.
+ * Functions only read the module, so they compile in parallel when there
+ * is a pool, and are still written in source order.
+ */
 class Compiler {
 private:
-	std::vector<std::shared_ptr<Statement>> instructions;
-	// Global function register
-	std::map<std::string, std::vector<VarType>> global_function_register; 
+	const IrModule& module;
+	ThreadPool* pool;
+	Peephole_Stats peephole_stats;
+	// source of the builtin routines, its names are interned as views of it
+	std::string builtin_source;
+
+	void inc_rbp_offset(int& rbp_offset, IrType type);
+	uint8_t get_data_size_by_type(IrType type);
+
+	/**
+	 * @brief Register or [rbp - N] slot of an allocated value id
+	 */
+	X86_Operand location(uint32_t id, IrType type, Shared_Info& si);
+
+	/**
+	 * @brief Operand reading the whole value: register, slot, or immediate
+	 * for constants and string addresses
+	 */
+	X86_Operand source(Value value, Shared_Info& si);
+
+	/**
+	 * @brief Operand for the rhs of an ALU instruction, large constants
+	 * are moved to rcx first
+	 */
+	X86_Operand alu_source(Value value, Shared_Info& si);
+
+	/**
+	 * @brief Low bits of value as a width wide register or immediate, memory
+	 * values are moved to rax first
+	 */
+	X86_Operand sized_source(Value value, IrType type, Shared_Info& si);
+	bool is_constant(Value value, Shared_Info& si);
+
+	void compile_instruction(const Ir_Instruction& instruction, Block_Index next, Shared_Info& si);
+	void compile_binary(const Ir_Instruction& instruction, Shared_Info& si);
+
+	/**
+	 * @brief Quotient or remainder of rax by a constant into rax without idiv:
+	 * shifts for powers of two, a multiply by the reciprocal otherwise. Both
+	 * truncate towards zero like idiv
+	 */
+	void compile_constant_division(OpType op, int64_t divisor, Shared_Info& si);
+	void compile_load_local(const Ir_Instruction& instruction, Shared_Info& si);
+	void compile_store_local(const Ir_Instruction& instruction, Shared_Info& si);
+	void compile_load(const Ir_Instruction& instruction, Shared_Info& si);
+	void compile_store(const Ir_Instruction& instruction, Shared_Info& si);
+	void compile_call(const Ir_Instruction& instruction, Shared_Info& si);
+	void compile_branch(const Ir_Instruction& instruction, Block_Index next, Shared_Info& si);
 
-	// Hardcoded strings
-	std::vector<std::string> string_data_segment;
+	/**
+	 * @brief Whether comparison is only read by the branch right after it,
+	 * so the branch can jump on the flags of the compare itself
+	 */
+	bool is_branch_condition(const Ir_Instruction& comparison, const Ir_Instruction& branch, Shared_Info& si);
+	void compile_compare_branch(const Ir_Instruction& comparison, const Ir_Instruction& branch, Block_Index next, Shared_Info& si);
 
-	void inc_rbp_offset(int& rbp_offset, VarType data_type);
-	std::string get_reg_by_data_type_and_counter(int& counter, VarType data_type);
-	std::string get_data_size_by_data_type(VarType data_type);
-	std::string get_return_reg_by_data_type(VarType data_type);
+	/**
+	 * @brief Load a value of type from address into the whole reg, dwords
+	 * are sign extended and bytes zero extended
+	 */
+	void compile_memory_load(IrType type, X86Register reg, X86_Operand address, Shared_Info& si);
+
+	/**
+	 * @brief Restore the callee saved registers and the frame of the caller,
+	 * leaving its return address on top of the stack
+	 */
+	void compile_epilogue(Shared_Info& si);
+
+	/**
+	 * @brief Move rax to the location of dst
+	 */
+	void compile_result(Value dst, Shared_Info& si);
+
+	/**
+	 * @brief Compile every function, on the pool when there is one, and hand
+	 * their instructions to consume in source order
+	 */
+	void compile_functions(const std::function<void(const std::vector<X86_Instruction>&)>& consume);
+
+	/**
+	 * @brief Encode the builtin routines and every function after whatever
+	 * assembler already holds
+	 */
+	void encode_program(X86Assembler& assembler);
+
+	/**
+	 * @brief Every string literal with its NUL, the data loaded at address
+	 * @param string_addresses filled with the address of every string
+	 */
+	std::vector<uint8_t> build_data(uint64_t address, std::vector<uint64_t>& string_addresses);
 
 public:
-	Compiler(std::vector<std::shared_ptr<Statement>> instructions);
-	std::string compile_statement(std::shared_ptr<Statement> stmt, Shared_Info& si);
-	std::string compile_function(std::shared_ptr<Statement> function);
-	std::string compile_return(std::shared_ptr<Statement> stmt, Shared_Info& si);
-	std::string compile_var(std::shared_ptr<Statement> stmt, Shared_Info& si);
-	std::string compile_var_reasignation(std::shared_ptr<Statement> stmt, Shared_Info& si);
-	std::string compile_if(std::shared_ptr<Statement> stmt, Shared_Info& si);
-	std::string compile_while(std::shared_ptr<Statement> stmt, Shared_Info& si);
-	std::string compile_expr(std::shared_ptr<Expr> expr, Shared_Info& si);
-	std::string compile_func_call(std::shared_ptr<Expr> expr, Shared_Info& si);
-	void compile_op_tree(std::shared_ptr<Expr> expr, std::stack<std::shared_ptr<Expr>>& expr_stack, std::stack<OpType>& op_stack);
-	std::string compile_op(std::shared_ptr<Expr> expr, Shared_Info& si);
-	std::string compile_operation(OpType type);
-	std::string compile_boolean(std::shared_ptr<Expr> expr);
-	std::string compile_number(std::shared_ptr<Expr> expr);
-	std::string compile_string(std::shared_ptr<Expr> expr);
-	std::string compile_var_read(std::shared_ptr<Expr> expr, Shared_Info& si);
-	std::string compile_program();
-	std::string build_data_segment();
-	std::string build_bss_segment();
+	/**
+	 * @brief Compiler over the lowered program, it must outlive the compiler.
+	 * Functions are compiled on pool when it isn't null
+	 */
+	Compiler(const IrModule& module, ThreadPool* pool = nullptr);
+
+	/**
+	 * @brief Instructions of function, starting on the label of its name
+	 * @param stats counts of the peephole rules fired, added to
+	 */
+	std::vector<X86_Instruction> compile_function(const Ir_Function& function, Peephole_Stats& stats);
+
+	/**
+	 * @brief Write the NASM source of the whole program to out, one function
+	 * at a time
+	 */
+	void compile_program(OutputSink& out);
+
+	/**
+	 * @brief Encode the whole program with the builtin assembler and write it
+	 * as a static executable to path, without going through nasm and ld
+	 */
+	void compile_executable(const std::string& path);
+
+	/**
+	 * @brief Encode the whole program into executable memory, ready for
+	 * jit_run to call its main without writing any file
+	 */
+	Jit_Image compile_image();
+	void build_data_segment(OutputSink& out);
+	void build_bss_segment(OutputSink& out);
 	std::string compile_builtin();
+
+	/**
+	 * @brief Print how many times every peephole rule fired to stderr
+	 */
+	void print_peephole_stats();
 };
@@ -0,0 +1,246 @@
+#include "constant_folder.hpp"
+
+ConstantFolder::ConstantFolder(Ir_Function& function) : function(function) {}
+
+size_t ConstantFolder::fold() {
+	size_t folded = 0;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		known.assign(function.values, false);
+		constants.assign(function.values, 0);
+		replacements.assign(function.values, VALUE_NONE);
+		loaded_types.assign(function.values, IR_TYPE_COUNTER);
+		find_constant_locals();
+
+		for (Ir_Block& block: function.blocks) {
+			size_t block_folded = fold_block(block);
+			folded += block_folded;
+			changed = changed || block_folded > 0;
+		}
+
+		// forwarded loads may be used on blocks laid out before their store
+		for (Ir_Block& block: function.blocks) {
+			for (Ir_Instruction& instruction: block.instructions) {
+				for_each_use(function, instruction, [&](Value& value) {
+					value = replacement(value);
+				});
+			}
+		}
+
+		// removed stores may leave more constant locals
+		changed = remove_unreachable_blocks(function) || changed;
+	}
+
+	return folded;
+}
+
+int64_t ConstantFolder::extend(int64_t value, IrType type) {
+	static_assert(IR_TYPE_COUNTER == 3, "Unhandled IR_TYPE_COUNTER on extend at constant_folder.cpp");
+	switch (type) {
+		case IR_TYPE_I8: return (uint8_t) value;
+		case IR_TYPE_I32: return (int32_t) value;
+		default: return value;
+	}
+}
+
+void ConstantFolder::find_constant_locals() {
+	// constants are defined before the stores using them, except through
+	// blocks laid out of order, those are caught on the next round
+	std::vector<bool> stored(function.locals.size(), false);
+	constant_locals.assign(function.locals.size(), true);
+	constant_local_values.assign(function.locals.size(), 0);
+	for (const Ir_Block& block: function.blocks) {
+		for (const Ir_Instruction& instruction: block.instructions) {
+			if (instruction.opcode == IR_OP_CONST) {
+				known[instruction.dst] = true;
+				constants[instruction.dst] = instruction.imm;
+			} else if (instruction.opcode == IR_OP_STORE_LOCAL) {
+				Local_Index local = instruction.imm;
+				int64_t value = extend(constants[instruction.a], instruction.type);
+				bool same = !stored[local] || constant_local_values[local] == value;
+				constant_locals[local] = constant_locals[local] && known[instruction.a] && same;
+				constant_local_values[local] = value;
+				stored[local] = true;
+			}
+		}
+	}
+
+	// reading a local never written is undefined, it is left alone
+	for (size_t local = 0; local < stored.size(); local++) {
+		constant_locals[local] = constant_locals[local] && stored[local];
+	}
+}
+
+bool ConstantFolder::is_identity(const Ir_Instruction& instruction) {
+	auto is = [&](Value value, int64_t constant) {
+		return known[value] && constants[value] == constant;
+	};
+	switch (instruction.op) {
+		case OP_TYPE_ADD:
+		case OP_TYPE_BIT_OR:
+		case OP_TYPE_BIT_XOR:
+			return is(instruction.a, 0) || is(instruction.b, 0);
+		case OP_TYPE_SUB:
+		case OP_TYPE_SHL:
+		case OP_TYPE_SHR:
+			return is(instruction.b, 0);
+		case OP_TYPE_MUL:
+			return is(instruction.a, 1) || is(instruction.b, 1);
+		default:
+			return false;
+	}
+}
+
+Value ConstantFolder::replacement(Value value) {
+	while (value != VALUE_NONE && replacements[value] != VALUE_NONE) {
+		value = replacements[value];
+	}
+	return value;
+}
+
+size_t ConstantFolder::fold_block(Ir_Block& block) {
+	static_assert(IR_OP_COUNTER == 15, "Unhandled IR_OP_COUNTER on fold_block at constant_folder.cpp");
+	size_t folded = 0;
+	// constant stored on each local earlier on this block, and the value
+	// loaded from it next when that is the value stored or loaded before
+	std::vector<bool> stored(function.locals.size(), false);
+	std::vector<int64_t> stored_constants(function.locals.size(), 0);
+	std::vector<Value> stored_values(function.locals.size(), VALUE_NONE);
+
+	size_t kept = 0;
+	for (Ir_Instruction& instruction: block.instructions) {
+		for_each_use(function, instruction, [&](Value& value) {
+			value = replacement(value);
+		});
+
+		int64_t result;
+		switch (instruction.opcode) {
+			case IR_OP_CONST:
+				known[instruction.dst] = true;
+				constants[instruction.dst] = instruction.imm;
+				break;
+
+			case IR_OP_BINARY:
+				if (fold_binary(instruction, result)) {
+					make_constant(instruction, result);
+					folded++;
+				} else if (is_identity(instruction)) {
+					// adding zero or multiplying by one leaves the other operand
+					replacements[instruction.dst] = known[instruction.a] ? instruction.b : instruction.a;
+					folded++;
+					continue;
+				}
+				break;
+
+			case IR_OP_NEG:
+			case IR_OP_NOT:
+				if (known[instruction.a]) {
+					uint64_t a = constants[instruction.a];
+					make_constant(instruction, instruction.opcode == IR_OP_NEG ? -a : ~a);
+					folded++;
+				}
+				break;
+
+			case IR_OP_LOAD_LOCAL:
+				if (stored[instruction.imm]) {
+					make_constant(instruction, stored_constants[instruction.imm]);
+					folded++;
+				} else if (constant_locals[instruction.imm]) {
+					make_constant(instruction, constant_local_values[instruction.imm]);
+					folded++;
+				} else if (stored_values[instruction.imm] != VALUE_NONE) {
+					// the load goes away, its users read the stored value
+					replacements[instruction.dst] = stored_values[instruction.imm];
+					folded++;
+					continue;
+				} else {
+					// loading the local again gives the same value
+					loaded_types[instruction.dst] = instruction.type;
+					stored_values[instruction.imm] = instruction.dst;
+				}
+				break;
+
+			case IR_OP_STORE_LOCAL:
+				stored[instruction.imm] = known[instruction.a];
+				stored_constants[instruction.imm] = extend(constants[instruction.a], instruction.type);
+				// narrower locals truncate, unless the value was read with the same width
+				if (instruction.type == IR_TYPE_I64 || loaded_types[instruction.a] == instruction.type) {
+					stored_values[instruction.imm] = instruction.a;
+				} else {
+					stored_values[instruction.imm] = VALUE_NONE;
+				}
+				break;
+
+			case IR_OP_LOAD:
+				loaded_types[instruction.dst] = instruction.type;
+				break;
+
+			case IR_OP_BR:
+				if (known[instruction.a]) {
+					Block_Index target = constants[instruction.a] != 0 ? instruction.target : instruction.other;
+					instruction.opcode = IR_OP_JMP;
+					instruction.a = VALUE_NONE;
+					instruction.target = target;
+					folded++;
+				}
+				break;
+
+			default:
+				break;
+		}
+		block.instructions[kept++] = instruction;
+	}
+	block.instructions.resize(kept);
+
+	return folded;
+}
+
+bool ConstantFolder::fold_binary(const Ir_Instruction& instruction, int64_t& result) {
+	static_assert(OP_TYPE_COUNT == 18, "Unhandled OP_TYPE_COUNT on fold_binary at constant_folder.cpp");
+	if (!known[instruction.a] || !known[instruction.b]) {
+		return false;
+	}
+
+	// unsigned to wrap around like the registers do
+	int64_t a = constants[instruction.a], b = constants[instruction.b];
+	uint64_t ua = a, ub = b;
+	switch (instruction.op) {
+		case OP_TYPE_ADD: result = ua + ub; return true;
+		case OP_TYPE_SUB: result = ua - ub; return true;
+		case OP_TYPE_MUL: result = ua * ub; return true;
+		case OP_TYPE_BIT_AND: result = a & b; return true;
+		case OP_TYPE_BIT_OR: result = a | b; return true;
+		case OP_TYPE_BIT_XOR: result = a ^ b; return true;
+		// shift counts are masked to 6 bits by the cpu
+		case OP_TYPE_SHL: result = ua << (b & 63); return true;
+		case OP_TYPE_SHR: result = a >> (b & 63); return true;
+		case OP_TYPE_LT: result = a < b; return true;
+		case OP_TYPE_GT: result = a > b; return true;
+		case OP_TYPE_EQ: result = a == b; return true;
+		case OP_TYPE_NEQ: result = a != b; return true;
+		case OP_TYPE_LTE: result = a <= b; return true;
+		case OP_TYPE_GTE: result = a >= b; return true;
+
+		case OP_TYPE_DIV:
+		case OP_TYPE_MOD:
+			// left to fault at runtime as idiv does
+			if (b == 0 || (a == INT64_MIN && b == -1)) {
+				return false;
+			}
+			result = instruction.op == OP_TYPE_DIV ? a / b : a % b;
+			return true;
+
+		default: return false;
+	}
+}
+
+void ConstantFolder::make_constant(Ir_Instruction& instruction, int64_t value) {
+	instruction.opcode = IR_OP_CONST;
+	instruction.type = IR_TYPE_I64;
+	instruction.a = VALUE_NONE;
+	instruction.b = VALUE_NONE;
+	instruction.imm = value;
+	known[instruction.dst] = true;
+	constants[instruction.dst] = value;
+}
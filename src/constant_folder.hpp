@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include "ir.hpp"
+
+/**
+ * @brief Evaluates at compile time the instructions whose operands are
+ * constants, with the same 64 bit wrapping arithmetic the backend emits.
+ * Constants are propagated through the locals only ever written one
+ * constant, like the ones never reassigned, and through the stores earlier
+ * on the same block, truncated and extended to the width of the local.
+ * Loads after a store on the same block are replaced by the value stored
+ * when reading it back can't change it. Branches on constants become jumps
+ * and the blocks nothing reaches anymore are dropped.
+ */
+class ConstantFolder {
+private:
+	Ir_Function& function;
+	// value of every virtual register known to be constant
+	std::vector<bool> known;
+	std::vector<int64_t> constants;
+	// value forwarded loads are replaced by
+	std::vector<Value> replacements;
+	// width every value was loaded from memory with, IR_TYPE_COUNTER if not a load
+	std::vector<IrType> loaded_types;
+	// locals every store writes the same constant to, and that constant
+	std::vector<bool> constant_locals;
+	std::vector<int64_t> constant_local_values;
+
+	void find_constant_locals();
+	bool is_identity(const Ir_Instruction& instruction);
+	Value replacement(Value value);
+	size_t fold_block(Ir_Block& block);
+	bool fold_binary(const Ir_Instruction& instruction, int64_t& result);
+	void make_constant(Ir_Instruction& instruction, int64_t value);
+
+public:
+	ConstantFolder(Ir_Function& function);
+
+	/**
+	 * @brief Fold the function in place until nothing else folds
+	 * @return number of instructions folded
+	 */
+	size_t fold();
+
+	/**
+	 * @brief value as reading it back from memory of width type leaves it
+	 */
+	static int64_t extend(int64_t value, IrType type);
+};
@@ -0,0 +1,244 @@
+#include "dead_code_eliminator.hpp"
+
+DeadCodeEliminator::DeadCodeEliminator(Ir_Function& function) : function(function) {}
+
+static size_t count_instructions(const Ir_Function& function) {
+	size_t count = 0;
+	for (const Ir_Block& block: function.blocks) {
+		count += block.instructions.size();
+	}
+	return count;
+}
+
+size_t DeadCodeEliminator::eliminate() {
+	size_t instructions = count_instructions(function);
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		changed = bypass_empty_blocks() || changed;
+		changed = remove_unreachable_blocks(function) || changed;
+		changed = merge_blocks() || changed;
+		changed = remove_dead_stores() || changed;
+		changed = remove_unused_values() || changed;
+	}
+	remove_unused_locals();
+
+	return instructions - count_instructions(function);
+}
+
+bool DeadCodeEliminator::bypass_empty_blocks() {
+	size_t blocks = function.blocks.size();
+	// where jumping to each block ends up, the entry is never a target
+	std::vector<Block_Index> forward(blocks);
+	for (Block_Index block = 0; block < blocks; block++) {
+		const std::vector<Ir_Instruction>& instructions = function.blocks[block].instructions;
+		bool empty = block != 0 && instructions.size() == 1 && instructions[0].opcode == IR_OP_JMP;
+		forward[block] = empty ? instructions[0].target : block;
+	}
+
+	// chains of empty blocks are followed, bounded for the empty infinite loops
+	auto destination = [&](Block_Index block) {
+		for (size_t steps = 0; steps < blocks && forward[block] != block; steps++) {
+			block = forward[block];
+		}
+		return block;
+	};
+
+	bool changed = false;
+	for (Ir_Block& block: function.blocks) {
+		Ir_Instruction& terminator = block.instructions.back();
+		if (terminator.opcode != IR_OP_JMP && terminator.opcode != IR_OP_BR) {
+			continue;
+		}
+
+		Block_Index target = destination(terminator.target);
+		changed = changed || target != terminator.target;
+		terminator.target = target;
+		if (terminator.opcode == IR_OP_JMP) {
+			continue;
+		}
+
+		Block_Index other = destination(terminator.other);
+		changed = changed || other != terminator.other;
+		terminator.other = other;
+		// both sides of an empty if else end on the same block
+		if (terminator.target == terminator.other) {
+			terminator.opcode = IR_OP_JMP;
+			terminator.a = VALUE_NONE;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+bool DeadCodeEliminator::merge_blocks() {
+	std::vector<uint32_t> predecessors(function.blocks.size(), 0);
+	for (const Ir_Block& block: function.blocks) {
+		for_each_successor(block.instructions.back(), [&](Block_Index successor) {
+			predecessors[successor]++;
+		});
+	}
+
+	bool changed = false;
+	for (Block_Index block = 0; block < function.blocks.size(); block++) {
+		std::vector<Ir_Instruction>& instructions = function.blocks[block].instructions;
+		// emptied by merging it before, nothing jumps to it anymore
+		while (!instructions.empty() && instructions.back().opcode == IR_OP_JMP) {
+			Block_Index successor = instructions.back().target;
+			if (successor == block || successor == 0 || predecessors[successor] != 1) {
+				break;
+			}
+
+			std::vector<Ir_Instruction>& merged = function.blocks[successor].instructions;
+			instructions.pop_back();
+			instructions.insert(instructions.end(), merged.begin(), merged.end());
+			merged.clear();
+			changed = true;
+		}
+	}
+
+	if (changed) {
+		remove_unreachable_blocks(function);
+	}
+	return changed;
+}
+
+bool DeadCodeEliminator::remove_dead_stores() {
+	size_t words = (function.locals.size() + 63) / 64;
+	std::vector<Bitset> live_in = local_live_in(function);
+
+	// walk every block backwards from what is live at its end
+	bool removed = false;
+	for (Ir_Block& block: function.blocks) {
+		Bitset live(words);
+		for_each_successor(block.instructions.back(), [&](Block_Index successor) {
+			for (size_t word = 0; word < words; word++) {
+				live[word] |= live_in[successor][word];
+			}
+		});
+
+		std::vector<bool> dead(block.instructions.size(), false);
+		for (size_t i = block.instructions.size(); i-- > 0;) {
+			const Ir_Instruction& instruction = block.instructions[i];
+			if (instruction.opcode == IR_OP_LOAD_LOCAL) {
+				set_bit(live, instruction.imm);
+			} else if (instruction.opcode == IR_OP_STORE_LOCAL) {
+				dead[i] = !test_bit(live, instruction.imm);
+				removed = removed || dead[i];
+				clear_bit(live, instruction.imm);
+			}
+		}
+
+		size_t kept = 0;
+		for (size_t i = 0; i < block.instructions.size(); i++) {
+			if (!dead[i]) {
+				block.instructions[kept++] = block.instructions[i];
+			}
+		}
+		block.instructions.resize(kept);
+	}
+
+	return removed;
+}
+
+bool DeadCodeEliminator::remove_unused_values() {
+	static_assert(IR_OP_COUNTER == 15, "Unhandled IR_OP_COUNTER on remove_unused_values at dead_code_eliminator.cpp");
+	std::vector<uint32_t> uses(function.values, 0);
+	std::vector<const Ir_Instruction*> constants(function.values, nullptr);
+	for (const Ir_Block& block: function.blocks) {
+		for (const Ir_Instruction& instruction: block.instructions) {
+			for_each_use(function, instruction, [&](Value value) {
+				uses[value]++;
+			});
+			if (instruction.opcode == IR_OP_CONST) {
+				constants[instruction.dst] = &instruction;
+			}
+		}
+	}
+
+	// instructions without side effects, divisions may fault and loads
+	// from memory may touch an invalid address
+	auto removable = [&](const Ir_Instruction& instruction) {
+		switch (instruction.opcode) {
+			case IR_OP_CONST:
+			case IR_OP_STRING:
+			case IR_OP_PARAM:
+			case IR_OP_NEG:
+			case IR_OP_NOT:
+			case IR_OP_LOAD_LOCAL:
+				return true;
+			case IR_OP_BINARY:
+				if (instruction.op == OP_TYPE_DIV || instruction.op == OP_TYPE_MOD) {
+					const Ir_Instruction* divisor = constants[instruction.b];
+					return divisor != nullptr && divisor->imm != 0 && divisor->imm != -1;
+				}
+				return true;
+			default:
+				return false;
+		}
+	};
+
+	// backwards, so the operands of a removed instruction are seen unused
+	bool changed = false;
+	for (size_t block = function.blocks.size(); block-- > 0;) {
+		std::vector<Ir_Instruction>& instructions = function.blocks[block].instructions;
+		std::vector<bool> dead(instructions.size(), false);
+		for (size_t i = instructions.size(); i-- > 0;) {
+			Ir_Instruction& instruction = instructions[i];
+			if (instruction.dst == VALUE_NONE || uses[instruction.dst] != 0) {
+				continue;
+			}
+
+			if (instruction.opcode == IR_OP_CALL) {
+				instruction.dst = VALUE_NONE;
+				changed = true;
+			} else if (removable(instruction)) {
+				dead[i] = true;
+				changed = true;
+				for_each_use(function, instruction, [&](Value value) {
+					uses[value]--;
+				});
+			}
+		}
+
+		size_t kept = 0;
+		for (size_t i = 0; i < instructions.size(); i++) {
+			if (!dead[i]) {
+				instructions[kept++] = instructions[i];
+			}
+		}
+		instructions.resize(kept);
+	}
+
+	return changed;
+}
+
+void DeadCodeEliminator::remove_unused_locals() {
+	std::vector<bool> used(function.locals.size(), false);
+	for (const Ir_Block& block: function.blocks) {
+		for (const Ir_Instruction& instruction: block.instructions) {
+			if (instruction.opcode == IR_OP_LOAD_LOCAL || instruction.opcode == IR_OP_STORE_LOCAL) {
+				used[instruction.imm] = true;
+			}
+		}
+	}
+
+	std::vector<Local_Index> renumbered(function.locals.size());
+	Local_Index kept = 0;
+	for (Local_Index local = 0; local < function.locals.size(); local++) {
+		if (used[local]) {
+			renumbered[local] = kept;
+			function.locals[kept++] = function.locals[local];
+		}
+	}
+	function.locals.resize(kept);
+
+	for (Ir_Block& block: function.blocks) {
+		for (Ir_Instruction& instruction: block.instructions) {
+			if (instruction.opcode == IR_OP_LOAD_LOCAL || instruction.opcode == IR_OP_STORE_LOCAL) {
+				instruction.imm = renumbered[instruction.imm];
+			}
+		}
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include "ir.hpp"
+
+/**
+ * @brief Removes the code whose effect is never observed: blocks nothing
+ * reaches (like the statements after a return), stores to locals not read
+ * before the next store or the end of the function, instructions computing
+ * values nobody uses and locals nothing accesses anymore. Blocks that only
+ * jump somewhere else are bypassed and a block is merged into its only
+ * predecessor, so empty branches leave no jumps behind.
+ */
+class DeadCodeEliminator {
+private:
+	Ir_Function& function;
+
+	bool remove_dead_stores();
+	bool remove_unused_values();
+	bool bypass_empty_blocks();
+	bool merge_blocks();
+	void remove_unused_locals();
+
+public:
+	DeadCodeEliminator(Ir_Function& function);
+
+	/**
+	 * @brief Clean the function in place until nothing else is removed
+	 * @return number of instructions removed
+	 */
+	size_t eliminate();
+};
@@ -0,0 +1,86 @@
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "elf.hpp"
+#include "utils.hpp"
+
+#define PAGE_SIZE 0x1000
+// ELF header and the program headers of text and data
+#define HEADERS_SIZE (sizeof(Elf64_Ehdr) + 2 * sizeof(Elf64_Phdr))
+
+static uint64_t align(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+uint64_t elf_text_address() {
+	return ELF_BASE_ADDRESS + HEADERS_SIZE;
+}
+
+// data starts on the file right after the text, mapped on the next page at the same offset within it
+static uint64_t data_offset(size_t text_size) {
+	return align(HEADERS_SIZE + text_size, 16);
+}
+
+uint64_t elf_data_address(size_t text_size) {
+	uint64_t offset = data_offset(text_size);
+	return align(ELF_BASE_ADDRESS + offset, PAGE_SIZE) + offset % PAGE_SIZE;
+}
+
+void elf_write_executable(const std::string& path, const std::vector<uint8_t>& text, const std::vector<uint8_t>& data, uint64_t entry) {
+	Elf64_Ehdr header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.e_ident, ELFMAG, SELFMAG);
+	header.e_ident[EI_CLASS] = ELFCLASS64;
+	header.e_ident[EI_DATA] = ELFDATA2LSB;
+	header.e_ident[EI_VERSION] = EV_CURRENT;
+	header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+	header.e_type = ET_EXEC;
+	header.e_machine = EM_X86_64;
+	header.e_version = EV_CURRENT;
+	header.e_entry = entry;
+	header.e_phoff = sizeof(Elf64_Ehdr);
+	header.e_ehsize = sizeof(Elf64_Ehdr);
+	header.e_phentsize = sizeof(Elf64_Phdr);
+	header.e_phnum = 2;
+
+	// the text segment maps the headers too, so its offset stays page aligned
+	Elf64_Phdr segments[2];
+	memset(segments, 0, sizeof(segments));
+	segments[0].p_type = PT_LOAD;
+	segments[0].p_flags = PF_R | PF_X;
+	segments[0].p_offset = 0;
+	segments[0].p_vaddr = ELF_BASE_ADDRESS;
+	segments[0].p_paddr = ELF_BASE_ADDRESS;
+	segments[0].p_filesz = HEADERS_SIZE + text.size();
+	segments[0].p_memsz = segments[0].p_filesz;
+	segments[0].p_align = PAGE_SIZE;
+
+	uint64_t offset = data_offset(text.size());
+	segments[1].p_type = PT_LOAD;
+	segments[1].p_flags = PF_R | PF_W;
+	segments[1].p_offset = offset;
+	segments[1].p_vaddr = elf_data_address(text.size());
+	segments[1].p_paddr = segments[1].p_vaddr;
+	segments[1].p_filesz = data.size();
+	segments[1].p_memsz = data.size();
+	segments[1].p_align = PAGE_SIZE;
+
+	std::string temporary = path + "." + std::to_string(getpid());
+	std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		Utils::error("Couldn't write the executable: " + temporary);
+	}
+	file.write((const char*) &header, sizeof(header));
+	file.write((const char*) segments, sizeof(segments));
+	file.write((const char*) text.data(), text.size());
+	std::vector<char> padding(offset - HEADERS_SIZE - text.size(), 0);
+	file.write(padding.data(), padding.size());
+	file.write((const char*) data.data(), data.size());
+	file.close();
+	if (!file || chmod(temporary.c_str(), 0755) != 0 || rename(temporary.c_str(), path.c_str()) != 0) {
+		unlink(temporary.c_str());
+		Utils::error("Couldn't write the executable: " + path);
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Executables are loaded from here up, the text right after the headers
+#define ELF_BASE_ADDRESS 0x400000
+
+/**
+ * @brief Address the text of an executable is loaded at
+ */
+uint64_t elf_text_address();
+
+/**
+ * @brief Address the data is loaded at, on the page after text_size bytes of text
+ */
+uint64_t elf_data_address(size_t text_size);
+
+/**
+ * @brief Write a static x86-64 Linux executable to path, with a read and
+ * execute text segment and a read and write data segment, without sections.
+ * It is written aside and renamed over path, so a running copy of the old
+ * one or another compilation never sees it half written.
+ */
+void elf_write_executable(const std::string& path, const std::vector<uint8_t>& text, const std::vector<uint8_t>& data, uint64_t entry);
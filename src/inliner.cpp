@@ -0,0 +1,253 @@
+#include "inliner.hpp"
+
+Inliner::Inliner(IrModule& module, size_t threshold) : module(module), threshold(threshold) {
+	for (uint32_t index = 0; index < module.functions.size(); index++) {
+		function_indices[module.functions[index].name] = index;
+	}
+}
+
+std::vector<uint32_t> Inliner::bottom_up_order() {
+	std::vector<uint32_t> order;
+	find_recursive(order);
+	return order;
+}
+
+void Inliner::find_recursive(std::vector<uint32_t>& order) {
+	size_t functions = module.functions.size();
+	std::vector<std::vector<uint32_t>> callees(functions);
+	for (uint32_t index = 0; index < functions; index++) {
+		for (const Ir_Block& block: module.functions[index].blocks) {
+			for (const Ir_Instruction& instruction: block.instructions) {
+				uint32_t* callee = instruction.opcode == IR_OP_CALL ? function_indices.find(instruction.callee) : nullptr;
+				if (callee != nullptr) {
+					callees[index].push_back(*callee);
+				}
+			}
+		}
+	}
+
+	// depth first over the call graph without recursion, call chains may be
+	// as deep as the program is long. A call to a function still on the
+	// stack closes a cycle, functions are emitted once all their callees are
+	typedef enum { UNVISITED, VISITING, VISITED } Visit_State;
+	std::vector<Visit_State> state(functions, UNVISITED);
+	std::vector<std::pair<uint32_t, size_t>> stack;
+	recursive.assign(functions, false);
+
+	for (uint32_t root = 0; root < functions; root++) {
+		if (state[root] != UNVISITED) {
+			continue;
+		}
+		state[root] = VISITING;
+		stack.push_back({root, 0});
+
+		while (!stack.empty()) {
+			uint32_t function = stack.back().first;
+			size_t next = stack.back().second++;
+			if (next == callees[function].size()) {
+				state[function] = VISITED;
+				order.push_back(function);
+				stack.pop_back();
+				continue;
+			}
+
+			uint32_t callee = callees[function][next];
+			if (state[callee] == UNVISITED) {
+				state[callee] = VISITING;
+				stack.push_back({callee, 0});
+			} else if (state[callee] == VISITING) {
+				recursive[callee] = true;
+			}
+		}
+	}
+}
+
+size_t Inliner::cost(const Ir_Function& callee) {
+	// parameters are replaced by the arguments, they cost nothing
+	size_t instructions = 0;
+	for (const Ir_Block& block: callee.blocks) {
+		for (const Ir_Instruction& instruction: block.instructions) {
+			instructions += instruction.opcode != IR_OP_PARAM;
+		}
+	}
+	return instructions;
+}
+
+size_t Inliner::inline_calls(Ir_Function& function) {
+	size_t inlined = 0;
+	for (Block_Index block = 0; block < function.blocks.size(); block++) {
+		std::vector<Ir_Instruction>& instructions = function.blocks[block].instructions;
+		for (size_t index = 0; index < instructions.size(); index++) {
+			uint32_t* callee_index = instructions[index].opcode == IR_OP_CALL ? function_indices.find(instructions[index].callee) : nullptr;
+			if (callee_index == nullptr || recursive[*callee_index]) {
+				continue;
+			}
+
+			const Ir_Function& callee = module.functions[*callee_index];
+			size_t callee_cost = cost(callee);
+			if (&callee == &function || callee_cost > threshold) {
+				continue;
+			}
+
+			report.push_back(std::string(Interner::name(callee.name)) + " into " + std::string(Interner::name(function.name))
+				+ " (" + std::to_string(callee_cost) + " instructions)");
+			inline_call(function, block, index, callee);
+			inlined++;
+			// the rest of the block moved to the continuation, visited after the inlined blocks
+			break;
+		}
+	}
+
+	return inlined;
+}
+
+static Ir_Instruction new_instruction(IrOpcode opcode) {
+	Ir_Instruction instruction = {};
+	instruction.opcode = opcode;
+	instruction.type = IR_TYPE_I64;
+	instruction.dst = VALUE_NONE;
+	instruction.a = VALUE_NONE;
+	instruction.b = VALUE_NONE;
+	return instruction;
+}
+
+static Ir_Instruction jump(Block_Index target) {
+	Ir_Instruction instruction = new_instruction(IR_OP_JMP);
+	instruction.target = target;
+	return instruction;
+}
+
+void Inliner::inline_call(Ir_Function& caller, Block_Index block, size_t index, const Ir_Function& callee) {
+	Ir_Instruction call = caller.blocks[block].instructions[index];
+	uint32_t loop_depth = caller.blocks[block].loop_depth;
+
+	// a call whose result is returned right away returns from the callee
+	// blocks themselves, so the tail calls of the callee stay tail calls
+	const std::vector<Ir_Instruction>& site = caller.blocks[block].instructions;
+	bool tail = call.dst != VALUE_NONE && index + 2 == site.size() && site[index + 1].opcode == IR_OP_RET && site[index + 1].a == call.dst;
+
+	// the callee blocks go right after the call, then the continuation
+	Block_Index first = block + 1;
+	Block_Index continuation = first + callee.blocks.size();
+	size_t inserted = callee.blocks.size() + (tail ? 0 : 1);
+	for (Ir_Block& caller_block: caller.blocks) {
+		Ir_Instruction& terminator = caller_block.instructions.back();
+		if (terminator.opcode == IR_OP_JMP || terminator.opcode == IR_OP_BR) {
+			terminator.target += terminator.target > block ? inserted : 0;
+		}
+		if (terminator.opcode == IR_OP_BR) {
+			terminator.other += terminator.other > block ? inserted : 0;
+		}
+	}
+
+	std::vector<Ir_Instruction>& instructions = caller.blocks[block].instructions;
+	Ir_Block rest = {.instructions = {instructions.begin() + index + 1, instructions.end()}, .loop_depth = loop_depth};
+	instructions.resize(index);
+	instructions.push_back(jump(first));
+
+	// callee values are renumbered after the caller ones, parameters are
+	// the arguments themselves
+	std::vector<Value> values(callee.values);
+	for (Value value = 0; value < callee.values; value++) {
+		values[value] = caller.values + value;
+	}
+	caller.values += callee.values;
+
+	size_t returns = 0;
+	Value returned = VALUE_NONE;
+	for (const Ir_Block& callee_block: callee.blocks) {
+		for (const Ir_Instruction& instruction: callee_block.instructions) {
+			if (instruction.opcode == IR_OP_PARAM) {
+				values[instruction.dst] = caller.call_args[call.args.first + instruction.imm];
+			} else if (instruction.opcode == IR_OP_RET) {
+				returns++;
+				returned = instruction.a;
+			}
+		}
+	}
+
+	Local_Index local_base = caller.locals.size();
+	caller.locals.insert(caller.locals.end(), callee.locals.begin(), callee.locals.end());
+
+	// a single return is used as the result directly, several meet on a local
+	bool result_on_local = !tail && call.dst != VALUE_NONE && (returns != 1 || returned == VALUE_NONE);
+	Local_Index result = caller.locals.size();
+	if (result_on_local) {
+		caller.locals.push_back({.name = SYMBOL_NONE, .type = IR_TYPE_I64});
+	}
+
+	std::vector<Ir_Block> body;
+	for (const Ir_Block& callee_block: callee.blocks) {
+		body.push_back({.instructions = {}, .loop_depth = callee_block.loop_depth + loop_depth});
+		std::vector<Ir_Instruction>& copies = body.back().instructions;
+
+		for (const Ir_Instruction& instruction: callee_block.instructions) {
+			Ir_Instruction copy = instruction;
+			if (copy.opcode == IR_OP_PARAM) {
+				continue;
+			} else if (copy.opcode == IR_OP_CALL) {
+				copy.args.first = caller.call_args.size();
+				for (uint32_t i = 0; i < instruction.args.count; i++) {
+					caller.call_args.push_back(values[callee.call_args[instruction.args.first + i]]);
+				}
+			} else {
+				for_each_use(caller, copy, [&](Value& value) {
+					value = values[value];
+				});
+			}
+
+			if (copy.dst != VALUE_NONE) {
+				copy.dst = values[copy.dst];
+			}
+
+			switch (copy.opcode) {
+				case IR_OP_LOAD_LOCAL:
+				case IR_OP_STORE_LOCAL:
+					copy.imm += local_base;
+					break;
+				case IR_OP_BR:
+					copy.other += first;
+					copy.target += first;
+					break;
+				case IR_OP_JMP:
+					copy.target += first;
+					break;
+				case IR_OP_RET:
+					if (tail) {
+						break;
+					}
+					if (result_on_local && copy.a != VALUE_NONE) {
+						Ir_Instruction store = new_instruction(IR_OP_STORE_LOCAL);
+						store.imm = result;
+						store.a = copy.a;
+						copies.push_back(store);
+					}
+					copy = jump(continuation);
+					break;
+				default:
+					break;
+			}
+			copies.push_back(copy);
+		}
+	}
+
+	if (result_on_local) {
+		Ir_Instruction load = new_instruction(IR_OP_LOAD_LOCAL);
+		load.dst = call.dst;
+		load.imm = result;
+		rest.instructions.insert(rest.instructions.begin(), load);
+	}
+
+	if (!tail) {
+		body.push_back(std::move(rest));
+	}
+	caller.blocks.insert(caller.blocks.begin() + first, std::make_move_iterator(body.begin()), std::make_move_iterator(body.end()));
+
+	if (call.dst != VALUE_NONE && !result_on_local && !tail) {
+		replace_uses(caller, call.dst, values[returned]);
+	}
+}
+
+const std::vector<std::string>& Inliner::get_report() {
+	return report;
+}
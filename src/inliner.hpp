@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "interner.hpp"
+#include "ir.hpp"
+
+// Callees up to this many instructions are inlined by default
+#define DEFAULT_INLINE_THRESHOLD 40
+
+/**
+ * @brief Replaces calls to small functions of the module by a copy of their
+ * body. The arguments take the place of the parameters, the locals of the
+ * callee become new locals of the caller and every return jumps to a block
+ * continuing after the call, or stays a return when the caller returns the
+ * result right away. Functions are visited callees first so the
+ * bodies copied are already inlined and optimized, a function reached again
+ * through a cycle of calls is never inlined.
+ */
+class Inliner {
+private:
+	IrModule& module;
+	// instructions a callee may have to be inlined, 0 disables inlining
+	size_t threshold;
+	Symbol_Map<uint32_t> function_indices;
+	// target of a call closing a cycle, inlining it would never end
+	std::vector<bool> recursive;
+	std::vector<std::string> report;
+
+	void find_recursive(std::vector<uint32_t>& order);
+	size_t cost(const Ir_Function& callee);
+	void inline_call(Ir_Function& caller, Block_Index block, size_t index, const Ir_Function& callee);
+
+public:
+	Inliner(IrModule& module, size_t threshold);
+
+	/**
+	 * @brief Index of every function of the module, callees before callers
+	 */
+	std::vector<uint32_t> bottom_up_order();
+
+	/**
+	 * @brief Inline the calls of function to callees cheap enough, the
+	 * callees must have been visited before on bottom_up_order
+	 * @return number of calls inlined
+	 */
+	size_t inline_calls(Ir_Function& function);
+
+	/**
+	 * @brief One line per call inlined, used by --inline-report
+	 */
+	const std::vector<std::string>& get_report();
+};
@@ -0,0 +1,116 @@
+#include <atomic>
+#include <mutex>
+#include "interner.hpp"
+#include "utils.hpp"
+
+// Names live in fixed size chunks so they can be read without locking
+// while other threads intern new symbols
+#define NAME_CHUNK_BITS 12
+#define NAME_CHUNK_SIZE (1 << NAME_CHUNK_BITS)
+#define MAX_NAME_CHUNKS 4096
+
+typedef struct {
+	uint64_t hash;
+	Symbol symbol;
+} Interner_Slot;
+
+static uint64_t hash_name(std::string_view name) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c: name) {
+		hash = (hash ^ (uint8_t) c) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+class Interner_Table {
+public:
+	std::mutex mutex;
+	std::atomic<std::string_view*> chunks[MAX_NAME_CHUNKS] = {};
+	std::atomic<size_t> count = 0;
+	std::vector<Interner_Slot> slots;
+
+	Interner_Table() : slots(1024, {0, SYMBOL_NONE}) {
+		static_assert(SYMBOL_PREDEFINED_COUNTER == 6, "Unhandled SYMBOL_PREDEFINED_COUNTER on interner.cpp");
+		intern("true");
+		intern("false");
+		intern("int");
+		intern("long");
+		intern("char");
+		intern("bool");
+	}
+
+	~Interner_Table() {
+		for (std::atomic<std::string_view*>& chunk: chunks) {
+			delete[] chunk.load();
+		}
+	}
+
+	std::string_view name(Symbol symbol) {
+		return chunks[symbol >> NAME_CHUNK_BITS].load(std::memory_order_acquire)[symbol & (NAME_CHUNK_SIZE - 1)];
+	}
+
+	Symbol intern(std::string_view name) {
+		uint64_t hash = hash_name(name);
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t mask = slots.size() - 1;
+		size_t i = hash & mask;
+		while (slots[i].symbol != SYMBOL_NONE) {
+			if (slots[i].hash == hash && this->name(slots[i].symbol) == name) {
+				return slots[i].symbol;
+			}
+			i = (i + 1) & mask;
+		}
+
+		Symbol symbol = count.load(std::memory_order_relaxed);
+		std::atomic<std::string_view*>& chunk = chunks[symbol >> NAME_CHUNK_BITS];
+		if ((symbol & (NAME_CHUNK_SIZE - 1)) == 0) {
+			if ((symbol >> NAME_CHUNK_BITS) == MAX_NAME_CHUNKS) {
+				Utils::error("Too many distinct names");
+			}
+			chunk.store(new std::string_view[NAME_CHUNK_SIZE], std::memory_order_release);
+		}
+		chunk.load(std::memory_order_relaxed)[symbol & (NAME_CHUNK_SIZE - 1)] = name;
+		count.store(symbol + 1, std::memory_order_release);
+
+		slots[i] = {hash, symbol};
+		if ((symbol + 1) * 2 > slots.size()) {
+			grow();
+		}
+		return symbol;
+	}
+
+	void grow() {
+		std::vector<Interner_Slot> old = std::move(slots);
+		slots.assign(old.size() * 2, {0, SYMBOL_NONE});
+		size_t mask = slots.size() - 1;
+		for (const Interner_Slot& slot: old) {
+			if (slot.symbol == SYMBOL_NONE) {
+				continue;
+			}
+
+			size_t i = slot.hash & mask;
+			while (slots[i].symbol != SYMBOL_NONE) {
+				i = (i + 1) & mask;
+			}
+			slots[i] = slot;
+		}
+	}
+};
+
+static Interner_Table& table() {
+	static Interner_Table table;
+	return table;
+}
+
+Symbol Interner::intern(std::string_view name) {
+	return table().intern(name);
+}
+
+std::string_view Interner::name(Symbol symbol) {
+	return table().name(symbol);
+}
+
+size_t Interner::size() {
+	return table().count.load(std::memory_order_acquire);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+typedef uint32_t Symbol;
+
+#define SYMBOL_NONE UINT32_MAX
+
+// Symbols interned before any source is read, their ids are fixed
+typedef enum {
+	SYMBOL_TRUE,
+	SYMBOL_FALSE,
+	SYMBOL_INT,
+	SYMBOL_LONG,
+	SYMBOL_CHAR,
+	SYMBOL_BOOL,
+	SYMBOL_PREDEFINED_COUNTER
+} PredefinedSymbol;
+
+/**
+ * @brief Process wide identifier table, every distinct name gets a dense id.
+ * Names are not copied, they must outlive the compilation (mapped sources or
+ * string literals). Interning is thread safe.
+ */
+class Interner {
+public:
+	static Symbol intern(std::string_view name);
+	static std::string_view name(Symbol symbol);
+
+	/**
+	 * @brief Number of symbols interned so far, every symbol is lower than it
+	 */
+	static size_t size();
+};
+
+/**
+ * @brief Flat open addressing map keyed by Symbol
+ */
+template <typename T>
+class Symbol_Map {
+private:
+	typedef struct {
+		Symbol key;
+		T value;
+	} Slot;
+
+	std::vector<Slot> slots;
+	size_t used = 0;
+
+	size_t position(Symbol key) const {
+		size_t mask = slots.size() - 1;
+		size_t i = (key * 0x9E3779B1u) & mask;
+		while (slots[i].key != key && slots[i].key != SYMBOL_NONE) {
+			i = (i + 1) & mask;
+		}
+		return i;
+	}
+
+	void grow() {
+		std::vector<Slot> old = std::move(slots);
+		slots.assign(old.empty() ? 16 : old.size() * 2, Slot{SYMBOL_NONE, T()});
+		for (Slot& slot: old) {
+			if (slot.key != SYMBOL_NONE) {
+				slots[position(slot.key)] = std::move(slot);
+			}
+		}
+	}
+
+public:
+	T* find(Symbol key) {
+		if (slots.empty()) {
+			return nullptr;
+		}
+
+		Slot& slot = slots[position(key)];
+		return slot.key == key ? &slot.value : nullptr;
+	}
+
+	size_t count(Symbol key) {
+		return find(key) != nullptr;
+	}
+
+	T& operator[](Symbol key) {
+		if ((used + 1) * 4 > slots.size() * 3) {
+			grow();
+		}
+
+		Slot& slot = slots[position(key)];
+		if (slot.key != key) {
+			slot.key = key;
+			used++;
+		}
+		return slot.value;
+	}
+};
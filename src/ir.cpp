@@ -0,0 +1,228 @@
+#include <sstream>
+#include "ir.hpp"
+
+static const char* type_names[] = {"i8", "i32", "i64"};
+static_assert(std::size(type_names) == IR_TYPE_COUNTER, "Unhandled IR_TYPE_COUNTER on type_names at ir.cpp");
+
+static const char* op_names[] = {
+	"add", "sub", "div", "mod", "mul", "lt", "gt", "eq", "neq", "lte", "gte",
+	"and", "or", "band", "bor", "bxor", "shl", "shr"
+};
+static_assert(std::size(op_names) == OP_TYPE_COUNT, "Unhandled OP_TYPE_COUNT on op_names at ir.cpp");
+
+bool is_terminator(const Ir_Instruction& instruction) {
+	return instruction.opcode == IR_OP_JMP || instruction.opcode == IR_OP_BR || instruction.opcode == IR_OP_RET || instruction.opcode == IR_OP_TAIL_CALL;
+}
+
+bool remove_unreachable_blocks(Ir_Function& function) {
+	std::vector<bool> reachable(function.blocks.size(), false);
+	std::vector<Block_Index> pending = {0};
+	reachable[0] = true;
+	while (!pending.empty()) {
+		Block_Index block = pending.back();
+		pending.pop_back();
+		for_each_successor(function.blocks[block].instructions.back(), [&](Block_Index successor) {
+			if (!reachable[successor]) {
+				reachable[successor] = true;
+				pending.push_back(successor);
+			}
+		});
+	}
+
+	std::vector<Block_Index> renumbered(function.blocks.size());
+	Block_Index kept = 0;
+	for (Block_Index block = 0; block < function.blocks.size(); block++) {
+		if (!reachable[block]) {
+			continue;
+		}
+		if (kept != block) {
+			function.blocks[kept] = std::move(function.blocks[block]);
+		}
+		renumbered[block] = kept++;
+	}
+	if (kept == function.blocks.size()) {
+		return false;
+	}
+
+	function.blocks.resize(kept);
+	for (Ir_Block& block: function.blocks) {
+		Ir_Instruction& terminator = block.instructions.back();
+		if (terminator.opcode == IR_OP_JMP) {
+			terminator.target = renumbered[terminator.target];
+		} else if (terminator.opcode == IR_OP_BR) {
+			terminator.target = renumbered[terminator.target];
+			terminator.other = renumbered[terminator.other];
+		}
+	}
+
+	return true;
+}
+
+void insert_block(Ir_Function& function, Block_Index position, Ir_Block block) {
+	for (Ir_Block& other: function.blocks) {
+		Ir_Instruction& terminator = other.instructions.back();
+		if (terminator.opcode == IR_OP_JMP || terminator.opcode == IR_OP_BR) {
+			terminator.target += terminator.target >= position;
+		}
+		if (terminator.opcode == IR_OP_BR) {
+			terminator.other += terminator.other >= position;
+		}
+	}
+	function.blocks.insert(function.blocks.begin() + position, std::move(block));
+}
+
+std::vector<Bitset> local_live_in(const Ir_Function& function) {
+	size_t words = (function.locals.size() + 63) / 64;
+	size_t blocks = function.blocks.size();
+
+	// locals read before being written on each block, and written on it
+	std::vector<Bitset> uses(blocks, Bitset(words)), defs(blocks, Bitset(words));
+	for (size_t block = 0; block < blocks; block++) {
+		for (const Ir_Instruction& instruction: function.blocks[block].instructions) {
+			if (instruction.opcode == IR_OP_LOAD_LOCAL && !test_bit(defs[block], instruction.imm)) {
+				set_bit(uses[block], instruction.imm);
+			} else if (instruction.opcode == IR_OP_STORE_LOCAL) {
+				set_bit(defs[block], instruction.imm);
+			}
+		}
+	}
+
+	std::vector<Bitset> live_in(blocks, Bitset(words));
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t block = blocks; block-- > 0;) {
+			Bitset out(words);
+			for_each_successor(function.blocks[block].instructions.back(), [&](Block_Index successor) {
+				for (size_t word = 0; word < words; word++) {
+					out[word] |= live_in[successor][word];
+				}
+			});
+
+			for (size_t word = 0; word < words; word++) {
+				uint64_t in = uses[block][word] | (out[word] & ~defs[block][word]);
+				changed = changed || in != live_in[block][word];
+				live_in[block][word] = in;
+			}
+		}
+	}
+
+	return live_in;
+}
+
+void replace_uses(Ir_Function& function, Value from, Value to) {
+	for (Ir_Block& block: function.blocks) {
+		for (Ir_Instruction& instruction: block.instructions) {
+			for_each_use(function, instruction, [&](Value& value) {
+				if (value == from) {
+					value = to;
+				}
+			});
+		}
+	}
+}
+
+/**
+ * @brief Name every local is printed with, temporaries take their index and
+ * so do the locals repeating a name, like the ones of inlined functions
+ */
+static std::vector<std::string> local_names(const Ir_Function& function) {
+	std::vector<std::string> names;
+	Symbol_Map<bool> seen;
+	for (size_t local = 0; local < function.locals.size(); local++) {
+		Symbol name = function.locals[local].name;
+		std::string local_name = "%";
+		if (name == SYMBOL_NONE) {
+			local_name.append(std::to_string(local));
+		} else if (seen.count(name) != 0) {
+			local_name.append(Interner::name(name)).append(".").append(std::to_string(local));
+		} else {
+			local_name.append(Interner::name(name));
+			seen[name] = true;
+		}
+		names.push_back(local_name);
+	}
+
+	return names;
+}
+
+static std::string escape(const std::string& string) {
+	std::string escaped;
+	for (char c: string) {
+		switch (c) {
+			case '\n': escaped += "\\n"; break;
+			case '\t': escaped += "\\t"; break;
+			case '\0': escaped += "\\0"; break;
+			case '\\': escaped += "\\\\"; break;
+			case '"': escaped += "\\\""; break;
+			default: escaped += c;
+		}
+	}
+
+	return escaped;
+}
+
+static void dump_instruction(std::stringstream& ss, const IrModule& module, const Ir_Function& function, const std::vector<std::string>& locals, const Ir_Instruction& instruction) {
+	static_assert(IR_OP_COUNTER == 15, "Unhandled IR_OP_COUNTER on dump_instruction() at ir.cpp");
+	ss << "\t";
+	if (instruction.dst != VALUE_NONE) {
+		ss << "v" << instruction.dst << " = ";
+	}
+
+	switch (instruction.opcode) {
+		case IR_OP_CONST: ss << "const " << instruction.imm; break;
+		case IR_OP_STRING: ss << "string S" << instruction.imm << " \"" << escape(module.strings[instruction.imm]) << "\""; break;
+		case IR_OP_PARAM: ss << "param " << instruction.imm; break;
+		case IR_OP_BINARY: ss << op_names[instruction.op] << " v" << instruction.a << ", v" << instruction.b; break;
+		case IR_OP_NEG: ss << "neg v" << instruction.a; break;
+		case IR_OP_NOT: ss << "not v" << instruction.a; break;
+		case IR_OP_LOAD_LOCAL: ss << "load." << type_names[instruction.type] << " " << locals[instruction.imm]; break;
+		case IR_OP_STORE_LOCAL: ss << "store." << type_names[instruction.type] << " " << locals[instruction.imm] << ", v" << instruction.a; break;
+		case IR_OP_LOAD: ss << "load." << type_names[instruction.type] << " [v" << instruction.a << "]"; break;
+		case IR_OP_STORE: ss << "store." << type_names[instruction.type] << " [v" << instruction.a << "], v" << instruction.b; break;
+		case IR_OP_CALL:
+		case IR_OP_TAIL_CALL: {
+			ss << (instruction.opcode == IR_OP_CALL ? "call " : "tail call ") << Interner::name(instruction.callee) << "(";
+			for (uint32_t i = 0; i < instruction.args.count; i++) {
+				ss << (i == 0 ? "v" : ", v") << function.call_args[instruction.args.first + i];
+			}
+			ss << ")";
+			break;
+		}
+		case IR_OP_JMP: ss << "jmp L" << instruction.target; break;
+		case IR_OP_BR: ss << "br v" << instruction.a << ", L" << instruction.target << ", L" << instruction.other; break;
+		case IR_OP_RET:
+			ss << "ret";
+			if (instruction.a != VALUE_NONE) {
+				ss << " v" << instruction.a;
+			}
+			break;
+		default: break;
+	}
+	ss << "\n";
+}
+
+std::string IrModule::dump() const {
+	std::stringstream ss;
+	for (const Ir_Function& function: functions) {
+		ss << "function " << Interner::name(function.name) << "(" << function.arguments << ")\n";
+		std::vector<std::string> locals = local_names(function);
+		for (size_t local = 0; local < function.locals.size(); local++) {
+			ss << "\tlocal " << locals[local] << ": " << type_names[function.locals[local].type] << "\n";
+		}
+
+		for (size_t block = 0; block < function.blocks.size(); block++) {
+			ss << "L" << block << ":";
+			if (function.blocks[block].loop_depth > 0) {
+				ss << "\t; loop depth " << function.blocks[block].loop_depth;
+			}
+			ss << "\n";
+			for (const Ir_Instruction& instruction: function.blocks[block].instructions) {
+				dump_instruction(ss, *this, function, locals, instruction);
+			}
+		}
+		ss << "\n";
+	}
+
+	return ss.str();
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ast.hpp"
+#include "interner.hpp"
+
+// Virtual registers are defined once, by a single instruction
+typedef uint32_t Value;
+typedef uint32_t Block_Index;
+typedef uint32_t Local_Index;
+
+#define VALUE_NONE UINT32_MAX
+#define BLOCK_NONE UINT32_MAX
+
+/**
+ * @brief Width of a memory access, values on virtual registers are always
+ * 64 bits: stores truncate them and loads sign extend dwords and zero
+ * extend bytes, like the variables of the language do
+ */
+typedef enum {
+	IR_TYPE_I8,
+	IR_TYPE_I32,
+	IR_TYPE_I64,
+	IR_TYPE_COUNTER
+} IrType;
+
+typedef enum {
+	IR_OP_CONST, // dst = imm
+	IR_OP_STRING, // dst = address of the string literal imm
+	IR_OP_PARAM, // dst = argument number imm, only on the entry block
+	IR_OP_BINARY, // dst = a op b, logical and/or are lowered to branches
+	IR_OP_NEG, // dst = -a
+	IR_OP_NOT, // dst = ~a
+	IR_OP_LOAD_LOCAL, // dst = local imm
+	IR_OP_STORE_LOCAL, // local imm = a
+	IR_OP_LOAD, // dst = *(type*) a
+	IR_OP_STORE, // *(type*) a = b
+	IR_OP_CALL, // dst = callee(args), dst is VALUE_NONE when unused
+	IR_OP_JMP, // goto target
+	IR_OP_BR, // goto a != 0 ? target : other
+	IR_OP_RET, // return a, VALUE_NONE falls off the end of the function
+	IR_OP_TAIL_CALL, // return callee(args), reusing the frame of the caller
+	IR_OP_COUNTER
+} IrOpcode;
+
+typedef struct {
+	IrOpcode opcode;
+	IrType type;
+	OpType op;
+	Value dst;
+	Value a;
+	Value b;
+	int64_t imm;
+	union {
+		Symbol callee;
+		Block_Index target;
+	};
+	union {
+		Node_List args; // call and tail call arguments on Ir_Function::call_args
+		Block_Index other;
+	};
+} Ir_Instruction;
+
+typedef struct {
+	// SYMBOL_NONE for temporaries introduced by the lowering
+	Symbol name;
+	IrType type;
+} Ir_Local;
+
+typedef struct {
+	std::vector<Ir_Instruction> instructions;
+	// while loops the block is nested in
+	uint32_t loop_depth;
+} Ir_Block;
+
+/**
+ * @brief Function as a list of basic blocks in layout order, the first one
+ * is the entry, every block ends with a jmp, br, ret or tail call
+ */
+typedef struct {
+	Symbol name;
+	uint32_t arguments;
+	std::vector<Ir_Local> locals;
+	std::vector<Ir_Block> blocks;
+	std::vector<Value> call_args;
+	// virtual registers used, every Value is lower than it
+	uint32_t values;
+} Ir_Function;
+
+/**
+ * @brief Program lowered from the Ast, functions in source order
+ */
+class IrModule {
+public:
+	std::vector<Ir_Function> functions;
+	// contents of the string literals, escapes already resolved
+	std::vector<std::string> strings;
+
+	/**
+	 * @brief Human readable listing of every function, used by --emit-ir
+	 */
+	std::string dump() const;
+};
+
+// Set of values or locals for the data flow analyses, one bit per id
+typedef std::vector<uint64_t> Bitset;
+
+inline bool test_bit(const Bitset& set, uint32_t id) {
+	return (set[id / 64] >> (id % 64)) & 1;
+}
+
+inline void set_bit(Bitset& set, uint32_t id) {
+	set[id / 64] |= (uint64_t) 1 << (id % 64);
+}
+
+inline void clear_bit(Bitset& set, uint32_t id) {
+	set[id / 64] &= ~((uint64_t) 1 << (id % 64));
+}
+
+/**
+ * @brief Whether instruction ends its block
+ */
+bool is_terminator(const Ir_Instruction& instruction);
+
+/**
+ * @brief Drop the blocks the entry can't reach, keeping the layout order of
+ * the rest and renumbering the jumps
+ * @return whether any block was removed
+ */
+bool remove_unreachable_blocks(Ir_Function& function);
+
+/**
+ * @brief Insert block at position, moving the jumps to the blocks after it.
+ * The jumps of block itself must already use the new numbering.
+ */
+void insert_block(Ir_Function& function, Block_Index position, Ir_Block block);
+
+/**
+ * @brief Locals whose value may still be read at the start of every block
+ */
+std::vector<Bitset> local_live_in(const Ir_Function& function);
+
+/**
+ * @brief Replace every read of the virtual register from by to
+ */
+void replace_uses(Ir_Function& function, Value from, Value to);
+
+/**
+ * @brief Call f on every virtual register read by instruction, in order.
+ * Given a mutable function and instruction f may rewrite the operands.
+ */
+template <typename Function, typename Instruction, typename F>
+void for_each_use(Function& function, Instruction& instruction, F f) {
+	static_assert(IR_OP_COUNTER == 15, "Unhandled IR_OP_COUNTER on for_each_use() at ir.hpp");
+	switch (instruction.opcode) {
+		case IR_OP_BINARY:
+		case IR_OP_STORE:
+			f(instruction.a);
+			f(instruction.b);
+			break;
+		case IR_OP_NEG:
+		case IR_OP_NOT:
+		case IR_OP_STORE_LOCAL:
+		case IR_OP_LOAD:
+		case IR_OP_BR:
+			f(instruction.a);
+			break;
+		case IR_OP_RET:
+			if (instruction.a != VALUE_NONE) {
+				f(instruction.a);
+			}
+			break;
+		case IR_OP_CALL:
+		case IR_OP_TAIL_CALL:
+			for (uint32_t i = 0; i < instruction.args.count; i++) {
+				f(function.call_args[instruction.args.first + i]);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * @brief Call f on every block terminator may jump to
+ */
+template <typename F>
+void for_each_successor(const Ir_Instruction& terminator, F f) {
+	if (terminator.opcode == IR_OP_JMP) {
+		f(terminator.target);
+	} else if (terminator.opcode == IR_OP_BR) {
+		f(terminator.target);
+		f(terminator.other);
+	}
+}
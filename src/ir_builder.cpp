@@ -0,0 +1,447 @@
+#include <iterator>
+#include "ir_builder.hpp"
+#include "utils.hpp"
+
+IrBuilder::IrBuilder(const Ast& ast, ThreadPool* pool) : ast(ast), pool(pool), program(this), function(nullptr), current(0), loop_depth(0) {
+	register_function(Interner::intern("printint"), {VAR_TYPE(VAR_TYPE_INT, 0)}); // printint.asm
+	register_function(Interner::intern("__syscall1"), {VAR_TYPE(VAR_TYPE_ANY, 0)});
+	register_function(Interner::intern("__syscall2"), {VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0)});
+	register_function(Interner::intern("__syscall3"), {VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0)});
+	register_function(Interner::intern("__syscall4"), {VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0)});
+	register_function(Interner::intern("__syscall5"), {VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0), VAR_TYPE(VAR_TYPE_ANY, 0)});
+
+	// disabled until fixing 6 parameter limitation on function calls
+	// register_function(Interner::intern("__syscall6"), {VAR_TYPE(VAR_TYPE_ANY, 0)});
+}
+
+IrBuilder::IrBuilder(const IrBuilder* program) : ast(program->ast), pool(nullptr), program(program), function(nullptr), current(0), loop_depth(0) {}
+
+IrModule IrBuilder::build() {
+	std::vector<const Func_Def*> definitions;
+	for (Stmt_Index index: ast.program) {
+		const Statement& stmt = ast.statements[index];
+		switch (stmt.type) {
+			case STMT_TYPE_FUNCTION_DECLARATION:
+				definitions.push_back(&ast.functions[stmt.fnc]);
+				break;
+
+			default:
+				Utils::error("Unknown top level statement");
+				exit(1);
+		}
+	}
+
+	// Every signature is known before any body, calls can go to functions defined after them
+	for (const Func_Def* fnc: definitions) {
+		if (find_function(fnc->name) != nullptr) {
+			Utils::error("Function already declared before: " + std::string(Interner::name(fnc->name)));
+		}
+		std::vector<VarType> data_types;
+		for (const Func_Arg& arg: ast.function_arguments(*fnc)) {
+			data_types.push_back(arg.type);
+		}
+		register_function(fnc->name, data_types);
+	}
+
+	// Each body is lowered with a string table of its own, the register is only read
+	std::vector<IrModule> lowered(definitions.size());
+	auto lower = [this, &definitions, &lowered](size_t i) {
+		IrBuilder builder(this);
+		builder.lower_function(*definitions[i]);
+		lowered[i] = std::move(builder.module);
+	};
+	if (pool != nullptr) {
+		std::vector<std::string> errors(definitions.size());
+		for (size_t i = 0; i < definitions.size(); i++) {
+			pool->submit([&lower, &errors, i] {
+				errors[i] = Utils::capture_errors([&lower, i] {
+					lower(i);
+				});
+			});
+		}
+		pool->wait();
+
+		// the error of the earliest function is the one lowering them in order stops on
+		for (const std::string& error: errors) {
+			if (!error.empty()) {
+				Utils::report_error(error);
+			}
+		}
+	} else {
+		for (size_t i = 0; i < definitions.size(); i++) {
+			lower(i);
+		}
+	}
+
+	// Strings are renumbered in source order, as lowering the bodies one after another would
+	for (IrModule& part: lowered) {
+		int64_t offset = module.strings.size();
+		for (Ir_Function& lowered_function: part.functions) {
+			for (Ir_Block& block: lowered_function.blocks) {
+				for (Ir_Instruction& instruction: block.instructions) {
+					if (instruction.opcode == IR_OP_STRING) {
+						instruction.imm += offset;
+					}
+				}
+			}
+			module.functions.push_back(std::move(lowered_function));
+		}
+		module.strings.insert(module.strings.end(), std::make_move_iterator(part.strings.begin()), std::make_move_iterator(part.strings.end()));
+	}
+
+	return std::move(module);
+}
+
+IrType IrBuilder::type_of(VarType data_type) {
+	static_assert(VAR_TYPE_COUNTER == 5, "Unhandled VAR_TYPE_COUNTER on type_of at ir_builder.cpp");
+	if (data_type.stars > 0) {
+		return IR_TYPE_I64;
+	}
+
+	switch (data_type.type) {
+		case VAR_TYPE_LONG: return IR_TYPE_I64;
+		case VAR_TYPE_ANY: return IR_TYPE_I64;
+		case VAR_TYPE_INT: return IR_TYPE_I32;
+		case VAR_TYPE_BOOL: return IR_TYPE_I8;
+		case VAR_TYPE_CHAR: return IR_TYPE_I8;
+		default: Utils::error("Unknown datatype"); exit(1);
+	}
+}
+
+Block_Index IrBuilder::new_block() {
+	function->blocks.push_back({.instructions = {}, .loop_depth = loop_depth});
+	return function->blocks.size() - 1;
+}
+
+Ir_Instruction IrBuilder::instruction(IrOpcode opcode) {
+	Ir_Instruction instruction = {};
+	instruction.opcode = opcode;
+	instruction.type = IR_TYPE_I64;
+	instruction.dst = VALUE_NONE;
+	instruction.a = VALUE_NONE;
+	instruction.b = VALUE_NONE;
+	return instruction;
+}
+
+void IrBuilder::emit(const Ir_Instruction& instruction) {
+	function->blocks[current].instructions.push_back(instruction);
+}
+
+Value IrBuilder::define(Ir_Instruction instruction) {
+	instruction.dst = function->values++;
+	emit(instruction);
+	return instruction.dst;
+}
+
+Local_Index IrBuilder::new_local(Symbol name, IrType type) {
+	function->locals.push_back({.name = name, .type = type});
+	return function->locals.size() - 1;
+}
+
+void IrBuilder::lower_function(const Func_Def& fnc) {
+	module.functions.push_back({.name = fnc.name, .arguments = fnc.arguments.count, .locals = {}, .blocks = {}, .call_args = {}, .values = 0});
+	function = &module.functions.back();
+	var_declare = Symbol_Map<Var_Declared>();
+	loop_depth = 0;
+	current = new_block();
+
+	if (fnc.arguments.count > 6) {
+		Utils::error("No more than 6 arguments on functions are allowed.");
+	}
+
+	int64_t parameter = 0;
+	for (const Func_Arg& arg: ast.function_arguments(fnc)) {
+		Ir_Instruction param = instruction(IR_OP_PARAM);
+		param.imm = parameter++;
+		Value value = define(param);
+
+		Ir_Instruction store = instruction(IR_OP_STORE_LOCAL);
+		store.type = type_of(arg.type);
+		store.imm = new_local(arg.name, store.type);
+		store.a = value;
+		emit(store);
+
+		var_declare[arg.name] = {.local = (Local_Index) store.imm, .type = arg.type};
+	}
+
+	lower_block(fnc.body);
+
+	Ir_Instruction ret = instruction(IR_OP_RET);
+	emit(ret);
+	function = nullptr;
+}
+
+void IrBuilder::lower_block(Node_List block) {
+	for (Stmt_Index stmt: ast.list(block)) {
+		lower_statement(ast.statements[stmt]);
+	}
+}
+
+void IrBuilder::lower_statement(const Statement& stmt) {
+	static_assert(STMT_TYPE_COUNTER == 7, "Unhandled STMT_TYPE_COUNTER on lower_statement on ir_builder.cpp");
+	switch (stmt.type) {
+		case STMT_TYPE_EXPR: lower_expr(ast.exprs[stmt.expr]); break;
+		case STMT_TYPE_RETURN: lower_return(stmt); break;
+		case STMT_TYPE_VAR_DECLARATION: lower_var(stmt); break;
+		case STMT_TYPE_VAR_REASIGNATION: lower_var_reasignation(stmt); break;
+		case STMT_TYPE_IF: lower_if(stmt); break;
+		case STMT_TYPE_WHILE: lower_while(stmt); break;
+		default: Utils::error("Unknown expression"); exit(1);
+	}
+}
+
+void IrBuilder::lower_while(const Statement& stmt) {
+	Block_Index header = new_block();
+	Ir_Instruction jmp = instruction(IR_OP_JMP);
+	jmp.target = header;
+	emit(jmp);
+
+	loop_depth++;
+	function->blocks[header].loop_depth = loop_depth;
+	current = header;
+	Ir_Instruction br = instruction(IR_OP_BR);
+	br.a = lower_expr(ast.exprs[stmt.whilee.condition]);
+	Block_Index branch = current;
+	br.target = new_block();
+	emit(br);
+
+	current = br.target;
+	lower_block(stmt.whilee.block);
+	jmp.target = header;
+	emit(jmp);
+	loop_depth--;
+
+	// the exit is only known once the body is lowered
+	Block_Index exit = new_block();
+	function->blocks[branch].instructions.back().other = exit;
+	current = exit;
+}
+
+void IrBuilder::lower_if(const Statement& stmt) {
+	Ir_Instruction br = instruction(IR_OP_BR);
+	br.a = lower_expr(ast.exprs[stmt.iif.condition]);
+	Block_Index branch = current;
+	br.target = new_block();
+	emit(br);
+
+	Ir_Instruction jmp = instruction(IR_OP_JMP);
+	current = br.target;
+	lower_block(stmt.iif.then);
+	Block_Index then_end = current;
+
+	Block_Index elsse = new_block();
+	function->blocks[branch].instructions.back().other = elsse;
+	current = elsse;
+	lower_block(stmt.iif.elsse);
+	Block_Index else_end = current;
+
+	Block_Index end = new_block();
+	jmp.target = end;
+	function->blocks[then_end].instructions.push_back(jmp);
+	function->blocks[else_end].instructions.push_back(jmp);
+	current = end;
+}
+
+void IrBuilder::lower_return(const Statement& stmt) {
+	Ir_Instruction ret = instruction(IR_OP_RET);
+	ret.a = lower_expr(ast.exprs[stmt.expr]);
+	emit(ret);
+
+	// statements after a return are still checked, on a block nothing reaches
+	current = new_block();
+}
+
+void IrBuilder::lower_var(const Statement& stmt) {
+	if (var_declare.count(stmt.var.name) != 0) {
+		Utils::error("Variable already declared before: " + std::string(Interner::name(stmt.var.name)));
+	}
+
+	Ir_Instruction store = instruction(IR_OP_STORE_LOCAL);
+	store.a = lower_expr(ast.exprs[stmt.var.value]);
+	store.type = type_of(stmt.var.type);
+	store.imm = new_local(stmt.var.name, store.type);
+	emit(store);
+	var_declare[stmt.var.name] = {.local = (Local_Index) store.imm, .type = stmt.var.type};
+}
+
+void IrBuilder::lower_var_reasignation(const Statement& stmt) {
+	if (var_declare.count(stmt.var.name) == 0) {
+		Utils::error("Trying to reasign an undeclared variable: " + std::string(Interner::name(stmt.var.name)));
+	}
+	Var_Declared vd = *var_declare.find(stmt.var.name);
+
+	Value value = lower_expr(ast.exprs[stmt.var.value]);
+
+	if (stmt.var.is_ptr) {
+		Ir_Instruction load = instruction(IR_OP_LOAD_LOCAL);
+		load.type = type_of(vd.type);
+		load.imm = vd.local;
+
+		Ir_Instruction store = instruction(IR_OP_STORE);
+		store.type = type_of(VAR_TYPE(vd.type.type, vd.type.stars - 1));
+		store.a = define(load);
+		store.b = value;
+		emit(store);
+	} else {
+		Ir_Instruction store = instruction(IR_OP_STORE_LOCAL);
+		store.type = type_of(vd.type);
+		store.imm = vd.local;
+		store.a = value;
+		emit(store);
+	}
+}
+
+Value IrBuilder::lower_expr(const Expr& expr) {
+	static_assert(EXPR_TYPE_COUNTER == 7, "Unhandled EXPR_TYPE_COUNTER in lower_expr on ir_builder.cpp");
+	switch (expr.type) {
+		case EXPR_TYPE_FUNC_CALL: return lower_func_call(expr);
+		case EXPR_TYPE_LITERAL_BOOL: return lower_constant(expr.boolean);
+		case EXPR_TYPE_LITERAL_NUMBER: return lower_constant(expr.number);
+		case EXPR_TYPE_LITERAL_STRING: {
+			Ir_Instruction string = instruction(IR_OP_STRING);
+			string.imm = module.strings.size();
+			module.strings.emplace_back(ast.string(expr.string));
+			return define(string);
+		}
+		case EXPR_TYPE_VAR_READ: return lower_var_read(expr);
+		case EXPR_TYPE_OP: return lower_op(expr);
+		case EXPR_TYPE_UNARY: return lower_unary(expr);
+		default: Utils::error("Unknown expression"); exit(1);
+	}
+}
+
+Value IrBuilder::lower_constant(int64_t value) {
+	Ir_Instruction constant = instruction(IR_OP_CONST);
+	constant.imm = value;
+	return define(constant);
+}
+
+Value IrBuilder::lower_op(const Expr& expr) {
+	if (expr.op.type == OP_TYPE_AND || expr.op.type == OP_TYPE_OR) {
+		return lower_logical_op(expr);
+	}
+
+	Ir_Instruction op = instruction(IR_OP_BINARY);
+	op.op = expr.op.type;
+	op.a = lower_expr(ast.exprs[expr.op.lhs]);
+	op.b = lower_expr(ast.exprs[expr.op.rhs]);
+	return define(op);
+}
+
+Value IrBuilder::lower_logical_op(const Expr& expr) {
+	// the rhs is skipped once the lhs decides the result, both paths leave
+	// the truth of their last operand on a temporary local
+	Local_Index result = new_local(SYMBOL_NONE, IR_TYPE_I64);
+	auto store_truth = [&](Value value) {
+		Ir_Instruction neq = instruction(IR_OP_BINARY);
+		neq.op = OP_TYPE_NEQ;
+		neq.a = value;
+		neq.b = lower_constant(0);
+
+		Ir_Instruction store = instruction(IR_OP_STORE_LOCAL);
+		store.imm = result;
+		store.a = define(neq);
+		emit(store);
+		return store.a;
+	};
+
+	Ir_Instruction br = instruction(IR_OP_BR);
+	br.a = store_truth(lower_expr(ast.exprs[expr.op.lhs]));
+	Block_Index branch = current;
+	Block_Index rhs = new_block();
+	emit(br);
+
+	current = rhs;
+	store_truth(lower_expr(ast.exprs[expr.op.rhs]));
+
+	// the rhs may have opened blocks of its own, the join goes after them
+	Block_Index end = new_block();
+	Ir_Instruction jmp = instruction(IR_OP_JMP);
+	jmp.target = end;
+	emit(jmp);
+
+	Ir_Instruction& patched = function->blocks[branch].instructions.back();
+	patched.target = expr.op.type == OP_TYPE_AND ? rhs : end;
+	patched.other = expr.op.type == OP_TYPE_AND ? end : rhs;
+	current = end;
+
+	Ir_Instruction load = instruction(IR_OP_LOAD_LOCAL);
+	load.imm = result;
+	return define(load);
+}
+
+Value IrBuilder::lower_unary(const Expr& expr) {
+	static_assert(UNARY_TYPE_COUNT == 2, "Unhandled UNARY_TYPE_COUNT on lower_unary() at ir_builder.cpp");
+	Ir_Instruction unary = instruction(expr.unary.type == UNARY_TYPE_NEG ? IR_OP_NEG : IR_OP_NOT);
+	unary.a = lower_expr(ast.exprs[expr.unary.operand]);
+	return define(unary);
+}
+
+Value IrBuilder::lower_var_read(const Expr& expr) {
+	Var_Declared* vd = var_declare.find(expr.var_read.var_name);
+	if (vd == nullptr) {
+		Utils::error("Undefined variable: " + std::string(Interner::name(expr.var_read.var_name)));
+	}
+
+	Ir_Instruction load = instruction(IR_OP_LOAD_LOCAL);
+	load.type = type_of(vd->type);
+	load.imm = vd->local;
+	Value value = define(load);
+
+	VarType data_type = vd->type;
+	for (uint32_t stars = expr.var_read.stars; stars > 0; stars--) {
+		data_type.stars -= 1;
+		Ir_Instruction deref = instruction(IR_OP_LOAD);
+		deref.type = type_of(data_type);
+		deref.a = value;
+		value = define(deref);
+	}
+
+	return value;
+}
+
+Value IrBuilder::lower_func_call(const Expr& expr) {
+	std::span<const Expr_Index> args = ast.list(expr.func_call.args);
+	if (args.size() > 6) {
+		Utils::error("Max number of params allowed in functions: 6");
+	}
+
+	// Check if function is declared
+	const Func_Signature* func = find_function(expr.func_call.name);
+	if (func == nullptr) {
+		Utils::error("Undefined function: " + std::string(Interner::name(expr.func_call.name)));
+	}
+
+	if (args.size() != func->arguments.size()) {
+		Utils::error("Unexpected number of arguments on function call");
+	}
+
+	// arguments are evaluated left to right, calls among them included
+	std::vector<Value> values;
+	for (Expr_Index arg: args) {
+		values.push_back(lower_expr(ast.exprs[arg]));
+	}
+
+	Ir_Instruction call = instruction(IR_OP_CALL);
+	call.callee = expr.func_call.name;
+	call.args = {.first = (uint32_t) function->call_args.size(), .count = (uint32_t) values.size()};
+	function->call_args.insert(function->call_args.end(), values.begin(), values.end());
+	return define(call);
+}
+
+void IrBuilder::register_function(Symbol name, std::vector<VarType> arguments) {
+	if (name >= global_function_register.size()) {
+		global_function_register.resize(Interner::size());
+	}
+
+	global_function_register[name] = {.declared = true, .arguments = std::move(arguments)};
+}
+
+const Func_Signature* IrBuilder::find_function(Symbol name) const {
+	const std::vector<Func_Signature>& functions = program->global_function_register;
+	if (name >= functions.size() || !functions[name].declared) {
+		return nullptr;
+	}
+
+	return &functions[name];
+}
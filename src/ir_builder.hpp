@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+#include "ast.hpp"
+#include "interner.hpp"
+#include "ir.hpp"
+#include "thread_pool.hpp"
+
+typedef struct {
+	Local_Index local;
+	VarType type;
+} Var_Declared;
+
+typedef struct {
+	bool declared;
+	std::vector<VarType> arguments;
+} Func_Signature;
+
+/**
+ * @brief Lowers the Ast to the IR, checking names and calls on the way.
+ * Variables become locals accessed by explicit loads and stores, every
+ * expression node gets its own virtual register. The signatures of every
+ * function are registered first, then each body is lowered on its own
+ * builder, in parallel when there is a pool.
+ */
+class IrBuilder {
+private:
+	const Ast& ast;
+	ThreadPool* pool;
+	// function and string literals lowered by this builder
+	IrModule module;
+	// Global function register, indexed by the function name Symbol
+	std::vector<Func_Signature> global_function_register;
+	// builder of the whole program, holding the register calls are checked on
+	const IrBuilder* program;
+
+	// state of the function being lowered
+	Ir_Function* function;
+	Block_Index current;
+	uint32_t loop_depth;
+	Symbol_Map<Var_Declared> var_declare;
+
+	/**
+	 * @brief Builder lowering a single function of program
+	 */
+	explicit IrBuilder(const IrBuilder* program);
+
+	void register_function(Symbol name, std::vector<VarType> arguments);
+	const Func_Signature* find_function(Symbol name) const;
+
+	Block_Index new_block();
+	Ir_Instruction instruction(IrOpcode opcode);
+	void emit(const Ir_Instruction& instruction);
+	Value define(Ir_Instruction instruction);
+	Local_Index new_local(Symbol name, IrType type);
+
+	void lower_function(const Func_Def& fnc);
+	void lower_block(Node_List block);
+	void lower_statement(const Statement& stmt);
+	void lower_var(const Statement& stmt);
+	void lower_var_reasignation(const Statement& stmt);
+	void lower_if(const Statement& stmt);
+	void lower_while(const Statement& stmt);
+	void lower_return(const Statement& stmt);
+	Value lower_expr(const Expr& expr);
+	Value lower_func_call(const Expr& expr);
+	Value lower_op(const Expr& expr);
+	Value lower_logical_op(const Expr& expr);
+	Value lower_unary(const Expr& expr);
+	Value lower_var_read(const Expr& expr);
+	Value lower_constant(int64_t value);
+
+public:
+	/**
+	 * @brief Builder over the program parsed on ast, it must outlive the
+	 * builder. Function bodies are lowered on pool when it isn't null
+	 */
+	IrBuilder(const Ast& ast, ThreadPool* pool = nullptr);
+
+	/**
+	 * @brief Lower every function. The module is the same whatever the pool:
+	 * functions keep the source order and the string literals are numbered
+	 * in it
+	 */
+	IrModule build();
+
+	/**
+	 * @brief Width a variable of data_type takes on memory
+	 */
+	static IrType type_of(VarType data_type);
+};
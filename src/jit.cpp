@@ -0,0 +1,47 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "jit.hpp"
+#include "utils.hpp"
+
+static size_t page_align(size_t size) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	return (size + page - 1) & ~(page - 1);
+}
+
+Jit_Image jit_map(size_t text_size, size_t data_size) {
+	Jit_Image image = {.memory = nullptr, .size = page_align(text_size) + page_align(data_size), .text_size = text_size, .entry = 0};
+	void* memory = mmap(nullptr, image.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if (memory == MAP_FAILED) {
+		Utils::error("Couldn't map memory for the program");
+	}
+	image.memory = (uint8_t*) memory;
+	return image;
+}
+
+uint64_t jit_data_address(const Jit_Image& image) {
+	return (uint64_t) image.memory + page_align(image.text_size);
+}
+
+void jit_load(Jit_Image& image, const std::vector<uint8_t>& text, const std::vector<uint8_t>& data) {
+	memcpy(image.memory, text.data(), text.size());
+	memcpy((uint8_t*) jit_data_address(image), data.data(), data.size());
+	if (mprotect(image.memory, page_align(image.text_size), PROT_READ | PROT_EXEC) != 0) {
+		Utils::error("Couldn't make the program executable");
+	}
+}
+
+int jit_run(Jit_Image& image, int argc, char** argv, char** envp) {
+	// the program writes with syscalls, anything buffered goes out before it
+	std::cout.flush();
+	std::cerr.flush();
+	fflush(nullptr);
+
+	typedef int64_t (*Main)(int64_t argc, char** argv, char** envp);
+	Main main = (Main) (image.memory + image.entry);
+	int exit_code = (uint8_t) main(argc, argv, envp);
+	munmap(image.memory, image.size);
+	return exit_code;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Anonymous mapping holding a program to run in process: the text on
+ * its first pages and the data on the ones after them. It is mapped on the
+ * low 2GB, so the absolute string addresses of the text fit on an imm32 as
+ * they do on a static executable.
+ */
+typedef struct {
+	uint8_t* memory;
+	size_t size;
+	size_t text_size;
+	// offset of main on the text
+	size_t entry;
+} Jit_Image;
+
+/**
+ * @brief Map a writable image with room for text_size bytes of text and
+ * data_size bytes of data
+ */
+Jit_Image jit_map(size_t text_size, size_t data_size);
+
+/**
+ * @brief Address the data of image is loaded at
+ */
+uint64_t jit_data_address(const Jit_Image& image);
+
+/**
+ * @brief Copy text and data to image and make the text executable
+ */
+void jit_load(Jit_Image& image, const std::vector<uint8_t>& text, const std::vector<uint8_t>& data);
+
+/**
+ * @brief Call main(argc, argv, envp) of a loaded image like the _start stub
+ * does, then unmap the image
+ * @return the exit code the executable would have had
+ */
+int jit_run(Jit_Image& image, int argc, char** argv, char** envp);
@@ -1,51 +1,90 @@
 #include <iostream>
 #include "lexer.hpp"
 #include "token.hpp"
+#include "scan.hpp"
+
+static constexpr Keyword keywords[] = {
+	{"(", Token::Type::OPEN_PAREN},
+	{")", Token::Type::CLOSE_PAREN},
+	{"[", Token::Type::OPEN_BRACKET},
+	{"]", Token::Type::CLOSE_BRACKET},
+	{"{", Token::Type::OPEN_CURLY},
+	{"}", Token::Type::CLOSE_CURLY},
+	{">", Token::Type::GREATER_THAN},
+	{"<", Token::Type::LOWER_THAN},
+	{";", Token::Type::SEMICOLON},
+	{":", Token::Type::COLON},
+	{",", Token::Type::COMMA},
+	{"=", Token::Type::EQUALS},
+	{"==", Token::Type::EQUALS_COMPARE},
+	{"<=", Token::Type::LOWER_THAN_EQUALS},
+	{">=", Token::Type::GREATER_THAN_EQUALS},
+	{"&&", Token::Type::LOGICAL_AND},
+	{"||", Token::Type::LOGICAL_OR},
+	{"&", Token::Type::BIT_AND},
+	{"|", Token::Type::BIT_OR},
+	{"^", Token::Type::BIT_XOR},
+	{"~", Token::Type::BIT_NOT},
+	{"<<", Token::Type::SHIFT_LEFT},
+	{">>", Token::Type::SHIFT_RIGHT},
+	{"!=", Token::Type::BANG_EQUALS},
+	{"-", Token::Type::SUB},
+	{"+", Token::Type::ADD},
+	{"/", Token::Type::DIV},
+	{"*", Token::Type::MUL},
+	{"%", Token::Type::MOD},
+	{"function", Token::Type::FUNCTION},
+	{"return", Token::Type::RETURN},
+	{"var", Token::Type::VAR},
+	{"if", Token::Type::IF},
+	{"for", Token::Type::FOR},
+	{"include", Token::Type::INCLUDE_DIRECTIVE},
+	{"else", Token::Type::ELSE},
+	{"while", Token::Type::WHILE},
+	{"->", Token::Type::ARROW},
+};
+
+// Built at compile time and shared by every lexer
+static constexpr Trie trie(keywords);
 
 Token Lexer::get_next_token() {
 	Token token;
-	long start = index;
-	token.set_type(trie.lookup(file_content, index));
+	long start = cursor;
+	token.set_loc(current_loc());
+	token.set_type(trie.lookup(file_content, cursor));
 	if (token.get_type() != Token::Type::UNKNOWN) {
-		token.set_value(file_content.substr(start, index - start));
+		token.set_value(file_content.substr(start, cursor - start));
 	}
 
 	if (token.get_type() == Token::Type::UNKNOWN) {
-		if (is_letter(file_content[index])) {
+		if (is_letter(file_content[cursor])) {
 			token.set_type(Token::Type::NAME);
 			token.set_value(form_name());
-		} else if (is_number(file_content[index])) {
+			token.set_symbol(Interner::intern(token.get_value()));
+		} else if (is_number(file_content[cursor])) {
 			token.set_type(Token::Type::LITERAL_NUMBER);
 			token.set_value(form_number());
-		} else if (file_content[index] == '"') {
+		} else if (file_content[cursor] == '"') {
 			token.set_type(Token::Type::LITERAL_STRING);
 			token.set_value(form_string());
 		} else {
-			Utils::error("Unknown token found ", TokenLoc(this->row, this->column, this->filename));
+			Utils::error("Unknown token found ", token.get_loc());
 		}
 	}
 
-	
-	column += token.get_value().size();
-	token.set_loc(TokenLoc(this->row, this->column, this->filename));
 	return token;
 }
 
 bool Lexer::has_more_tokens() {
-	return this->index < (long) file_content.size();
+	return this->cursor < (long) file_content.size();
 }
 
 void Lexer::tokenize() {
-	while (has_more_tokens()) {
-		skip_whitespace();
-		if (!has_more_tokens()) {
-			break;
-		}
-
-		tokens.push_back(get_next_token());
+	Token token;
+	while (scan_token(token)) {
+		tokens.push_back(token);
 	}
-
-	this->index = 0;
+	buffer = tokens;
 }
 
 bool Lexer::is_number(char c) {
@@ -56,119 +95,165 @@ bool Lexer::is_letter(char c) {
 	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
 }
 
-void Lexer::skip_whitespace() {
-	while (Utils::is_blankspace(file_content[index]) && index < (int) file_content.size()) {
-		if (file_content[index] == '\n') {
-			row += 1;
-			column = 0;
-		}
+TokenLoc Lexer::current_loc() {
+	return TokenLoc(row, cursor - line_start + 1, file_id);
+}
 
-		column += 1;
-		index += 1;
+void Lexer::skip_newlines(size_t newlines, const char* last_newline) {
+	if (newlines != 0) {
+		row += newlines;
+		line_start = last_newline + 1 - file_content.data();
 	}
 }
 
-std::string Lexer::form_name() {
-	long start = index;
-	while (is_letter(file_content[index]) || is_number(file_content[index])) {
-		index += 1;
+void Lexer::skip_whitespace() {
+	// most tokens are not preceded by blankspaces at all
+	if (!Utils::is_blankspace(file_content[cursor])) {
+		return;
 	}
 
-	return file_content.substr(start, index - start);
+	size_t newlines = 0;
+	const char* last_newline = nullptr;
+	const char* end = file_content.data() + file_content.size();
+	const char* p = Scan::skip_blankspace(file_content.data() + cursor, end, newlines, last_newline);
+
+	cursor = p - file_content.data();
+	skip_newlines(newlines, last_newline);
+}
+
+std::string_view Lexer::form_name() {
+	long start = cursor;
+	const char* end = file_content.data() + file_content.size();
+	cursor = Scan::skip_name(file_content.data() + cursor, end) - file_content.data();
+
+	return file_content.substr(start, cursor - start);
+}
+
+std::string_view Lexer::form_number() {
+	long start = cursor;
+	const char* end = file_content.data() + file_content.size();
+	cursor = Scan::skip_number(file_content.data() + cursor, end) - file_content.data();
+
+	return file_content.substr(start, cursor - start);
 }
 
-std::string Lexer::form_number() {
-	long start = index;
-	while (is_number(file_content[index])) {
-		index += 1;
+std::string_view Lexer::form_string() {
+	TokenLoc loc = current_loc();
+	long start = cursor++;
+
+	size_t newlines = 0;
+	const char* last_newline = nullptr;
+	const char* end = file_content.data() + file_content.size();
+	cursor = Scan::find_quote(file_content.data() + cursor, end, newlines, last_newline) - file_content.data();
+	if (!has_more_tokens()) {
+		Utils::error("Unterminated string literal", loc);
 	}
+	skip_newlines(newlines, last_newline);
+	cursor++;
 
-	return file_content.substr(start, index - start);
+	return file_content.substr(start + 1, cursor - start - 2);
 }
 
-std::string Lexer::form_string() {
-	long start = index++;
-	while (file_content[index] != '"') {
-		index++;
+const Token& Lexer::expect_next_token(Token::Type token_type, const char* error_msg) {
+	if (!fill(index)) {
+		Utils::error("Parsing error: unexpected end of file, " + std::string(error_msg));
+	}
+
+	const Token& token = at(index);
+	if (token.get_type() != token_type) {
+		Utils::error(std::string(error_msg) + ", but got '" + std::string(token.get_value()) + "'", token.get_loc());
 	}
+
 	index++;
+	return token;
+}
+
+bool Lexer::scan_token(Token& token) {
+	if (!has_more_tokens()) {
+		return false;
+	}
 
-	return file_content.substr(start + 1, index - start - 2);
+	skip_whitespace();
+	if (!has_more_tokens()) {
+		return false;
+	}
+
+	token = get_next_token();
+	return true;
 }
 
-Token Lexer::expect_next_token(Token::Type token_type, std::string error_msg) {
-	if (this->tokens[index].get_type() == token_type) {
-		return this->tokens[index++];
-	} else {
-		Utils::error(error_msg, this->tokens[index].get_loc());
-		exit(1);
+bool Lexer::fill(long i) {
+	if (mode == BUFFERED) {
+		return i < (long) buffer.size();
+	}
+
+	while (produced <= i && !exhausted) {
+		Token& slot = ring[produced & (LOOKAHEAD_SIZE - 1)];
+		exhausted = source ? !source(slot) : !scan_token(slot);
+		if (!exhausted) {
+			produced++;
+		}
 	}
+
+	return i < produced;
 }
 
-Token Lexer::next_token() {
-	return this->tokens[index++];
+const Token& Lexer::at(long i) {
+	if (mode == BUFFERED) {
+		return buffer[i];
+	}
+
+	if (i < produced - LOOKAHEAD_SIZE) {
+		Utils::error("Lexer error: token is out of the lookahead window");
+	}
+	return ring[i & (LOOKAHEAD_SIZE - 1)];
 }
 
-Token Lexer::explore_next_token() {
-	return this->tokens[index];
+const Token& Lexer::next_token() {
+	if (!fill(index)) {
+		Utils::error("Parsing error: unexpected end of file");
+	}
+	return at(index++);
 }
 
-Token Lexer::explore_last_token() {
-	return this->tokens[index - 1];
+const Token& Lexer::explore_next_token() {
+	if (!fill(index)) {
+		Utils::error("Parsing error: unexpected end of file");
+	}
+	return at(index);
+}
+
+const Token& Lexer::explore_last_token() {
+	return at(index - 1);
 }
 
 bool Lexer::is_parsed() {
-	return (long) this->tokens.size() <= index;
-}
-
-void Lexer::register_keywords() {
-	trie.add_keyword("(", Token::Type::OPEN_PAREN);
-	trie.add_keyword(")", Token::Type::CLOSE_PAREN);
-	trie.add_keyword("[", Token::Type::OPEN_BRACKET);
-	trie.add_keyword("]", Token::Type::CLOSE_BRACKET);
-	trie.add_keyword("{", Token::Type::OPEN_CURLY);
-	trie.add_keyword("}", Token::Type::CLOSE_CURLY);
-	trie.add_keyword(">", Token::Type::GREATER_THAN);
-	trie.add_keyword("<", Token::Type::LOWER_THAN);
-	trie.add_keyword(";", Token::Type::SEMICOLON);
-	trie.add_keyword(":", Token::Type::COLON);
-	trie.add_keyword(",", Token::Type::COMMA);
-	trie.add_keyword("=", Token::Type::EQUALS);
-	trie.add_keyword("==", Token::Type::EQUALS_COMPARE);
-	trie.add_keyword("<=", Token::Type::LOWER_THAN_EQUALS);
-	trie.add_keyword("!=", Token::Type::BANG_EQUALS);
-	trie.add_keyword("-", Token::Type::SUB);
-	trie.add_keyword("+", Token::Type::ADD);
-	trie.add_keyword("/", Token::Type::DIV);
-	trie.add_keyword("*", Token::Type::MUL);
-	trie.add_keyword("%", Token::Type::MOD);
-	trie.add_keyword("function", Token::Type::FUNCTION);
-	trie.add_keyword("return", Token::Type::RETURN);
-	trie.add_keyword("var", Token::Type::VAR);
-	trie.add_keyword("if", Token::Type::IF);
-	trie.add_keyword("for", Token::Type::FOR);
-	trie.add_keyword("include", Token::Type::INCLUDE_DIRECTIVE);
-	trie.add_keyword("else", Token::Type::ELSE);
-	trie.add_keyword("while", Token::Type::WHILE);
-	trie.add_keyword("->", Token::Type::ARROW);
+	return !fill(index);
 }
 
 void Lexer::return_index() {
 	index -= 1;
 }
 
-void Lexer::set_file_content(std::string file_content) { this->file_content = file_content; }
-std::string Lexer::get_file_content() { return this->file_content; }
-void Lexer::set_tokens(std::vector<Token> tokens) { this->tokens = tokens; }
-std::vector<Token> Lexer::get_tokens() { return this->tokens; }
+void Lexer::set_file_content(std::string_view file_content) { this->file_content = file_content; }
+std::string_view Lexer::get_file_content() { return this->file_content; }
+void Lexer::set_tokens(std::vector<Token>&& tokens) { this->tokens = std::move(tokens); this->buffer = this->tokens; }
+void Lexer::set_tokens(std::span<const Token> tokens) { this->buffer = tokens; }
+const std::vector<Token>& Lexer::get_tokens() { return this->tokens; }
+std::vector<Token> Lexer::take_tokens() { this->buffer = {}; return std::move(this->tokens); }
 void Lexer::set_index(long index) { this->index = index; }
 long Lexer::get_index() { return this->index; }
 
-Lexer::Lexer() : index(0) {}
-Lexer::Lexer(std::string filepath) : file_content(Utils::read_file(filepath)), index(0), row(1), column(0), filename(filepath) {
-	register_keywords();
-	tokenize();
+Lexer::Lexer() : mode(BUFFERED), cursor(0), index(0) {}
+Lexer::Lexer(const std::string& filepath, Mode mode) : Lexer(SourceTable::open(filepath), mode) {}
+Lexer::Lexer(uint32_t file_id, Mode mode)
+	: mode(mode), cursor(0), row(1), line_start(0), file_id(file_id), index(0), produced(0), exhausted(false) {
+	file_content = SourceTable::content(file_id);
+	if (mode == BUFFERED) {
+		tokenize();
+	}
 }
+Lexer::Lexer(Token_Source source) : mode(STREAMING), cursor(0), index(0), source(std::move(source)), produced(0), exhausted(false) {}
 
 
-static_assert(Token::Type::TOKEN_COUNTER == 33, "Unhandled TOKEN_COUNTER on lexer.cpp");
+static_assert(Token::Type::TOKEN_COUNTER == 42, "Unhandled TOKEN_COUNTER on lexer.cpp");
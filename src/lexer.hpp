@@ -1,47 +1,118 @@
 #pragma once
+#include <functional>
+#include <span>
 #include <string>
 #include <vector>
 #include "utils.hpp"
+#include "source.hpp"
 #include "token.hpp"
 #include "trie.hpp"
 
+// Tokens kept around in streaming mode, must be a power of two
+#define LOOKAHEAD_SIZE 8
+
+/**
+ * @brief Produces the next token of a stream, returns false when it's exhausted
+ */
+typedef std::function<bool(Token&)> Token_Source;
+
 class Lexer {
+public:
+	enum Mode {
+		// whole file is tokenized on construction into the token list
+		BUFFERED,
+		// tokens are scanned on demand and only the last LOOKAHEAD_SIZE are kept
+		STREAMING,
+	};
+
 private:
-	Trie trie;
-	std::string file_content;
-	std::vector<Token> tokens;
-	long index;
+	Mode mode;
 
+	// scanner state over the mapped file
+	std::string_view file_content;
+	long cursor;
 	size_t row;
-	size_t column;
-	std::string filename;
+	long line_start; // cursor of the first character of the current row
+	uint32_t file_id;
+
+	// index of the next token handed to the parser
+	long index;
+
+	// BUFFERED mode, buffer is either tokens or a range owned by someone else
+	std::vector<Token> tokens;
+	std::span<const Token> buffer;
+
+	// STREAMING mode, tokens [produced - LOOKAHEAD_SIZE, produced) are on the ring
+	Token_Source source;
+	Token ring[LOOKAHEAD_SIZE];
+	long produced;
+	bool exhausted;
 
 	Token get_next_token();
 	bool has_more_tokens();
 	void tokenize();
 	bool is_number(char c);
 	bool is_letter(char c);
-	std::string form_name();
-	std::string form_number();
-	std::string form_string();
-	void register_keywords();
+	std::string_view form_name();
+	std::string_view form_number();
+	std::string_view form_string();
 	void skip_whitespace();
+	void skip_newlines(size_t newlines, const char* last_newline);
+	TokenLoc current_loc();
+
+	/**
+	 * @brief Make sure token i is available, pulling tokens in STREAMING mode
+	 *
+	 * @return false if the stream ends before token i
+	 */
+	bool fill(long i);
+
+	/**
+	 * @brief Token i of the stream, it must be available (see fill)
+	 */
+	const Token& at(long i);
 
 public:
-	void set_file_content(std::string file_content);
-	std::string get_file_content();
-	void set_tokens(std::vector<Token> tokens);
-	std::vector<Token> get_tokens();
+	void set_file_content(std::string_view file_content);
+	std::string_view get_file_content();
+	void set_tokens(std::vector<Token>&& tokens);
+
+	/**
+	 * @brief Read tokens without copying them, they must outlive the lexer
+	 */
+	void set_tokens(std::span<const Token> tokens);
+	const std::vector<Token>& get_tokens();
+
+	/**
+	 * @brief Move the token list out of a BUFFERED lexer
+	 */
+	std::vector<Token> take_tokens();
 	void set_index(long index);
 	long get_index();
-	Token expect_next_token(Token::Type token_type, std::string error_msg);
 
 	/**
-	 * @brief Get next token adding one to the token list index
+	 * @brief Get next token adding one to the token list index, it must be
+	 * of token_type
+	 *
+	 * @param error_msg reported with the unexpected token otherwise
+	 */
+	const Token& expect_next_token(Token::Type token_type, const char* error_msg);
+
+	/**
+	 * @brief Scan the next token of the file
+	 *
+	 * @param token
+	 * @return false at end of file
+	 */
+	bool scan_token(Token& token);
+
+	/**
+	 * @brief Get next token adding one to the token list index. Returned
+	 * references stay valid until LOOKAHEAD_SIZE more tokens are read.
 	 * 
 	 * @return Token 
 	 */
-	Token next_token();
+	const Token& next_token();
 
 	/**
 	 * @brief Substracts one to the token list index
@@ -54,15 +125,37 @@ public:
 	 * 
 	 * @return Token 
 	 */
-	Token explore_next_token();
+	const Token& explore_next_token();
 
 	/**
 	 * @brief Get previous token without moving the token list index
 	 * 
 	 * @return Token 
 	 */
-	Token explore_last_token();
+	const Token& explore_last_token();
 	bool is_parsed();
-	Lexer(std::string filepath);
+
+	/**
+	 * @brief Lexer over a file, BUFFERED tokenizes it on construction and
+	 * STREAMING scans it while the tokens are requested
+	 */
+	Lexer(const std::string& filepath, Mode mode = BUFFERED);
+
+	/**
+	 * @brief Lexer over a file already registered on the SourceTable
+	 */
+	Lexer(uint32_t file_id, Mode mode = BUFFERED);
+
+	/**
+	 * @brief STREAMING lexer pulling its tokens from source
+	 */
+	Lexer(Token_Source source);
 	Lexer();
+
+	/**
+	 * @brief buffer may point into tokens, a copy would keep reading the
+	 * tokens of the original
+	 */
+	Lexer(const Lexer&) = delete;
+	Lexer& operator=(const Lexer&) = delete;
 };
@@ -0,0 +1,765 @@
+#include <algorithm>
+#include "loop_optimizer.hpp"
+
+// Scale a pointer may grow by per counter step to replace the loop test
+#define MAX_TEST_SCALE (1 << 16)
+
+LoopOptimizer::LoopOptimizer(Ir_Function& function) : function(function) {}
+
+static Ir_Instruction new_instruction(IrOpcode opcode) {
+	Ir_Instruction instruction = {};
+	instruction.opcode = opcode;
+	instruction.type = IR_TYPE_I64;
+	instruction.dst = VALUE_NONE;
+	instruction.a = VALUE_NONE;
+	instruction.b = VALUE_NONE;
+	return instruction;
+}
+
+void LoopOptimizer::find_loops() {
+	analyze();
+	while (add_preheader()) {
+		analyze();
+	}
+
+	// a loop back to the entry has nowhere to hoist to
+	loops.erase(std::remove_if(loops.begin(), loops.end(), [](const Ir_Loop& loop) {
+		return loop.preheader == BLOCK_NONE;
+	}), loops.end());
+}
+
+void LoopOptimizer::analyze() {
+	size_t blocks = function.blocks.size();
+	std::vector<std::vector<Block_Index>> successors(blocks);
+	predecessors.assign(blocks, {});
+	for (Block_Index block = 0; block < blocks; block++) {
+		for_each_successor(function.blocks[block].instructions.back(), [&](Block_Index successor) {
+			successors[block].push_back(successor);
+			predecessors[successor].push_back(block);
+		});
+	}
+
+	// post order from the entry without recursion
+	std::vector<Block_Index> postorder;
+	std::vector<size_t> postorder_numbers(blocks, SIZE_MAX);
+	std::vector<bool> visited(blocks, false);
+	std::vector<std::pair<Block_Index, size_t>> stack = {{0, 0}};
+	visited[0] = true;
+	while (!stack.empty()) {
+		Block_Index block = stack.back().first;
+		size_t next = stack.back().second++;
+		if (next == successors[block].size()) {
+			postorder_numbers[block] = postorder.size();
+			postorder.push_back(block);
+			stack.pop_back();
+		} else if (!visited[successors[block][next]]) {
+			visited[successors[block][next]] = true;
+			stack.push_back({successors[block][next], 0});
+		}
+	}
+
+	// Cooper, Harvey and Kennedy: iterate in reverse post order until the
+	// immediate dominators settle
+	dominators.assign(blocks, BLOCK_NONE);
+	dominators[0] = 0;
+	auto intersect = [&](Block_Index a, Block_Index b) {
+		while (a != b) {
+			while (postorder_numbers[a] < postorder_numbers[b]) {
+				a = dominators[a];
+			}
+			while (postorder_numbers[b] < postorder_numbers[a]) {
+				b = dominators[b];
+			}
+		}
+		return a;
+	};
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t i = postorder.size(); i-- > 0;) {
+			Block_Index block = postorder[i];
+			if (block == 0) {
+				continue;
+			}
+
+			Block_Index dominator = BLOCK_NONE;
+			for (Block_Index predecessor: predecessors[block]) {
+				if (dominators[predecessor] != BLOCK_NONE) {
+					dominator = dominator == BLOCK_NONE ? predecessor : intersect(predecessor, dominator);
+				}
+			}
+			changed = changed || dominators[block] != dominator;
+			dominators[block] = dominator;
+		}
+	}
+
+	// every edge back to a dominator closes a loop, loops sharing a header
+	// are the same one
+	loops.clear();
+	std::vector<size_t> header_loops(blocks, SIZE_MAX);
+	for (Block_Index block = 0; block < blocks; block++) {
+		for (Block_Index successor: successors[block]) {
+			if (!dominates(successor, block)) {
+				continue;
+			}
+			if (header_loops[successor] == SIZE_MAX) {
+				header_loops[successor] = loops.size();
+				loops.push_back({.header = successor, .preheader = BLOCK_NONE, .blocks = std::vector<bool>(blocks, false),
+					.nested = std::vector<bool>(blocks, false), .latches = {}});
+			}
+			loops[header_loops[successor]].latches.push_back(block);
+		}
+	}
+
+	for (Ir_Loop& loop: loops) {
+		loop.blocks[loop.header] = true;
+		std::vector<Block_Index> pending = loop.latches;
+		while (!pending.empty()) {
+			Block_Index block = pending.back();
+			pending.pop_back();
+			if (loop.blocks[block]) {
+				continue;
+			}
+			loop.blocks[block] = true;
+			for (Block_Index predecessor: predecessors[block]) {
+				if (dominators[predecessor] != BLOCK_NONE) {
+					pending.push_back(predecessor);
+				}
+			}
+		}
+	}
+
+	// a loop nested on another one has less blocks
+	std::sort(loops.begin(), loops.end(), [](const Ir_Loop& a, const Ir_Loop& b) {
+		return std::count(a.blocks.begin(), a.blocks.end(), true) < std::count(b.blocks.begin(), b.blocks.end(), true);
+	});
+
+	for (Ir_Loop& loop: loops) {
+		for (const Ir_Loop& other: loops) {
+			if (other.header != loop.header && loop.blocks[other.header]) {
+				for (Block_Index block = 0; block < blocks; block++) {
+					loop.nested[block] = loop.nested[block] || other.blocks[block];
+				}
+			}
+		}
+
+		std::vector<Block_Index> entries;
+		for (Block_Index predecessor: predecessors[loop.header]) {
+			if (!loop.blocks[predecessor]) {
+				entries.push_back(predecessor);
+			}
+		}
+		if (entries.size() == 1 && function.blocks[entries[0]].instructions.back().opcode == IR_OP_JMP) {
+			loop.preheader = entries[0];
+		}
+	}
+}
+
+bool LoopOptimizer::add_preheader() {
+	for (const Ir_Loop& loop: loops) {
+		if (loop.preheader != BLOCK_NONE || loop.header == 0) {
+			continue;
+		}
+
+		// the new block goes right before the header, falling through to it
+		Block_Index header = loop.header;
+		Ir_Instruction jump = new_instruction(IR_OP_JMP);
+		jump.target = header + 1;
+		uint32_t loop_depth = function.blocks[header].loop_depth;
+		insert_block(function, header, {.instructions = {jump}, .loop_depth = loop_depth > 0 ? loop_depth - 1 : 0});
+
+		for (Block_Index predecessor: predecessors[header]) {
+			if (loop.blocks[predecessor]) {
+				continue;
+			}
+			Ir_Instruction& terminator = function.blocks[predecessor + (predecessor >= header)].instructions.back();
+			if (terminator.target == header + 1) {
+				terminator.target = header;
+			}
+			if (terminator.opcode == IR_OP_BR && terminator.other == header + 1) {
+				terminator.other = header;
+			}
+		}
+		return true;
+	}
+
+	return false;
+}
+
+bool LoopOptimizer::dominates(Block_Index dominator, Block_Index block) {
+	if (dominators[block] == BLOCK_NONE) {
+		return false;
+	}
+	while (block != dominator) {
+		if (block == 0) {
+			return false;
+		}
+		block = dominators[block];
+	}
+	return true;
+}
+
+void LoopOptimizer::find_definitions() {
+	definitions.assign(function.values, new_instruction(IR_OP_COUNTER));
+	definition_blocks.assign(function.values, BLOCK_NONE);
+	definition_positions.assign(function.values, 0);
+	for (Block_Index block = 0; block < function.blocks.size(); block++) {
+		const std::vector<Ir_Instruction>& instructions = function.blocks[block].instructions;
+		for (size_t i = 0; i < instructions.size(); i++) {
+			if (instructions[i].dst != VALUE_NONE) {
+				definitions[instructions[i].dst] = instructions[i];
+				definition_blocks[instructions[i].dst] = block;
+				definition_positions[instructions[i].dst] = i;
+			}
+		}
+	}
+}
+
+bool LoopOptimizer::is_defined_in(const Ir_Loop& loop, Value value) {
+	return definition_blocks[value] != BLOCK_NONE && loop.blocks[definition_blocks[value]];
+}
+
+bool LoopOptimizer::is_invariant(const Ir_Loop& loop, Value value) {
+	// constants are rematerialized where they are used, they stay on the loop
+	IrOpcode opcode = definitions[value].opcode;
+	return !is_defined_in(loop, value) || opcode == IR_OP_CONST || opcode == IR_OP_STRING;
+}
+
+bool LoopOptimizer::is_constant(Value value, int64_t& constant) {
+	constant = definitions[value].imm;
+	return definitions[value].opcode == IR_OP_CONST;
+}
+
+Value LoopOptimizer::materialize(const Ir_Loop& loop, Value value) {
+	if (!is_defined_in(loop, value)) {
+		return value;
+	}
+	Ir_Instruction copy = definitions[value];
+	copy.dst = function.values++;
+	return emit(loop, copy);
+}
+
+Value LoopOptimizer::emit(const Ir_Loop& loop, Ir_Instruction instruction) {
+	std::vector<Ir_Instruction>& instructions = function.blocks[loop.preheader].instructions;
+	instructions.insert(instructions.end() - 1, instruction);
+	if (instruction.dst != VALUE_NONE) {
+		if (instruction.dst >= definitions.size()) {
+			definitions.resize(function.values, new_instruction(IR_OP_COUNTER));
+			definition_blocks.resize(function.values, BLOCK_NONE);
+			definition_positions.resize(function.values, 0);
+		}
+		definitions[instruction.dst] = instruction;
+		definition_blocks[instruction.dst] = loop.preheader;
+		definition_positions[instruction.dst] = instructions.size() - 2;
+	}
+	return instruction.dst;
+}
+
+size_t LoopOptimizer::hoist_invariants() {
+	find_loops();
+	size_t hoisted = 0;
+	for (const Ir_Loop& loop: loops) {
+		hoisted += hoist(loop);
+	}
+	return hoisted;
+}
+
+bool LoopOptimizer::is_hoistable(const Ir_Loop& loop, const std::vector<bool>& stored, const Ir_Instruction& instruction) {
+	static_assert(IR_OP_COUNTER == 15, "Unhandled IR_OP_COUNTER on is_hoistable at loop_optimizer.cpp");
+	int64_t divisor;
+	switch (instruction.opcode) {
+		case IR_OP_BINARY:
+			// the division may not run on every iteration, nor at all
+			if ((instruction.op == OP_TYPE_DIV || instruction.op == OP_TYPE_MOD)
+				&& (!is_constant(instruction.b, divisor) || divisor == 0 || divisor == -1)) {
+				return false;
+			}
+			return is_invariant(loop, instruction.a) && is_invariant(loop, instruction.b);
+		case IR_OP_NEG:
+		case IR_OP_NOT:
+			return is_invariant(loop, instruction.a);
+		case IR_OP_LOAD_LOCAL:
+			return !stored[instruction.imm];
+		default:
+			return false;
+	}
+}
+
+size_t LoopOptimizer::hoist(const Ir_Loop& loop) {
+	find_definitions();
+	std::vector<bool> stored(function.locals.size(), false);
+	for (Block_Index block = 0; block < function.blocks.size(); block++) {
+		for (const Ir_Instruction& instruction: function.blocks[block].instructions) {
+			if (loop.blocks[block] && instruction.opcode == IR_OP_STORE_LOCAL) {
+				stored[instruction.imm] = true;
+			}
+		}
+	}
+
+	// blocks aren't visited in dominance order, an operand may be hoisted
+	// after the instruction using it
+	size_t hoisted = 0;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (Block_Index block = 0; block < function.blocks.size(); block++) {
+			if (!loop.blocks[block]) {
+				continue;
+			}
+
+			std::vector<Ir_Instruction>& instructions = function.blocks[block].instructions;
+			size_t kept = 0;
+			for (size_t i = 0; i < instructions.size(); i++) {
+				Ir_Instruction instruction = instructions[i];
+				if (!is_hoistable(loop, stored, instruction)) {
+					instructions[kept++] = instruction;
+					continue;
+				}
+
+				for_each_use(function, instruction, [&](Value& value) {
+					value = materialize(loop, value);
+				});
+				emit(loop, instruction);
+				hoisted++;
+				changed = true;
+			}
+			instructions.resize(kept);
+		}
+	}
+
+	return hoisted;
+}
+
+std::vector<Induction_Variable> LoopOptimizer::find_induction_variables(const Ir_Loop& loop) {
+	std::vector<uint32_t> stores(function.locals.size(), 0);
+	std::vector<std::pair<Block_Index, size_t>> positions(function.locals.size());
+	for (Block_Index block = 0; block < function.blocks.size(); block++) {
+		const std::vector<Ir_Instruction>& instructions = function.blocks[block].instructions;
+		for (size_t i = 0; i < instructions.size(); i++) {
+			if (loop.blocks[block] && instructions[i].opcode == IR_OP_STORE_LOCAL) {
+				stores[instructions[i].imm]++;
+				positions[instructions[i].imm] = {block, i};
+			}
+		}
+	}
+
+	// the store runs exactly once on every iteration: outside the nested
+	// loops and on every path back to the header
+	std::vector<Induction_Variable> variables;
+	for (Local_Index local = 0; local < function.locals.size(); local++) {
+		auto [block, position] = positions[local];
+		if (stores[local] != 1 || loop.nested[block] || block == loop.header) {
+			continue;
+		}
+		bool every_iteration = true;
+		for (Block_Index latch: loop.latches) {
+			every_iteration = every_iteration && dominates(block, latch);
+		}
+		const Ir_Instruction& store = function.blocks[block].instructions[position];
+		if (!every_iteration || definition_blocks[store.a] != block || definitions[store.a].opcode != IR_OP_BINARY
+			|| definitions[store.a].op != OP_TYPE_ADD) {
+			continue;
+		}
+
+		auto reads_local = [&](Value value) {
+			const Ir_Instruction& load = definitions[value];
+			return definition_blocks[value] == block && load.opcode == IR_OP_LOAD_LOCAL && load.imm == local && load.type == store.type;
+		};
+		const Ir_Instruction& add = definitions[store.a];
+		if (reads_local(add.a) && is_invariant(loop, add.b)) {
+			variables.push_back({.local = local, .type = store.type, .block = block, .store = position, .step = add.b});
+		} else if (reads_local(add.b) && is_invariant(loop, add.a)) {
+			variables.push_back({.local = local, .type = store.type, .block = block, .store = position, .step = add.a});
+		}
+	}
+
+	return variables;
+}
+
+bool LoopOptimizer::linear_chain(const Ir_Loop& loop, const Induction_Variable& variable, Value value, Block_Index block,
+	size_t position, int64_t& scale, std::vector<Ir_Instruction>& chain) {
+	if (!is_defined_in(loop, value) || definition_blocks[value] != block) {
+		return false;
+	}
+
+	const Ir_Instruction instruction = definitions[value];
+	if (instruction.opcode == IR_OP_LOAD_LOCAL && instruction.imm == variable.local) {
+		// both sides of the increment read different values
+		if (block == variable.block && (definition_positions[value] < variable.store) != (position < variable.store)) {
+			return false;
+		}
+		scale = 1;
+		chain.push_back(instruction);
+		return true;
+	}
+	if (instruction.opcode != IR_OP_BINARY) {
+		return false;
+	}
+
+	int64_t constant;
+	switch (instruction.op) {
+		case OP_TYPE_ADD:
+		case OP_TYPE_SUB:
+			if (is_invariant(loop, instruction.b)) {
+				if (!linear_chain(loop, variable, instruction.a, block, position, scale, chain)) {
+					return false;
+				}
+			} else if (is_invariant(loop, instruction.a)) {
+				if (!linear_chain(loop, variable, instruction.b, block, position, scale, chain)) {
+					return false;
+				}
+				scale = instruction.op == OP_TYPE_SUB ? (int64_t) -(uint64_t) scale : scale;
+			} else {
+				return false;
+			}
+			break;
+		case OP_TYPE_MUL:
+			if (is_constant(instruction.b, constant)) {
+				if (!linear_chain(loop, variable, instruction.a, block, position, scale, chain)) {
+					return false;
+				}
+			} else if (is_constant(instruction.a, constant)) {
+				if (!linear_chain(loop, variable, instruction.b, block, position, scale, chain)) {
+					return false;
+				}
+			} else {
+				return false;
+			}
+			scale = (int64_t) ((uint64_t) scale * (uint64_t) constant);
+			break;
+		default:
+			return false;
+	}
+
+	chain.push_back(instruction);
+	return true;
+}
+
+Value LoopOptimizer::clone_chain(const Ir_Loop& loop, const Induction_Variable& variable, const std::vector<Ir_Instruction>& chain, Value start) {
+	std::vector<std::pair<Value, Value>> renamed;
+	auto rename = [&](Value value) {
+		for (auto [from, to]: renamed) {
+			if (from == value) {
+				return to;
+			}
+		}
+		return materialize(loop, value);
+	};
+
+	Value last = start;
+	for (const Ir_Instruction& instruction: chain) {
+		if (instruction.opcode == IR_OP_LOAD_LOCAL && instruction.imm == variable.local) {
+			last = start;
+		} else {
+			Ir_Instruction copy = instruction;
+			copy.a = rename(instruction.a);
+			copy.b = rename(instruction.b);
+			copy.dst = function.values++;
+			last = emit(loop, copy);
+		}
+		renamed.push_back({instruction.dst, last});
+	}
+	return last;
+}
+
+size_t LoopOptimizer::reduce_induction_variables() {
+	find_loops();
+	size_t reduced = 0;
+	for (const Ir_Loop& loop: loops) {
+		reductions.clear();
+		while (reduce_address(loop)) {
+			reduced++;
+		}
+		while (replace_test(loop)) {
+			reduced++;
+		}
+	}
+	return reduced;
+}
+
+bool LoopOptimizer::reduce_address(const Ir_Loop& loop) {
+	find_definitions();
+	std::vector<Induction_Variable> variables = find_induction_variables(loop);
+	for (Block_Index block = 0; block < function.blocks.size(); block++) {
+		if (!loop.blocks[block]) {
+			continue;
+		}
+
+		for (const Ir_Instruction& access: function.blocks[block].instructions) {
+			if (access.opcode != IR_OP_LOAD && access.opcode != IR_OP_STORE) {
+				continue;
+			}
+			// a counter loaded right away is already as cheap as a pointer
+			Value address = access.a;
+			if (!is_defined_in(loop, address) || definitions[address].opcode != IR_OP_BINARY) {
+				continue;
+			}
+
+			for (const Induction_Variable& variable: variables) {
+				int64_t scale;
+				std::vector<Ir_Instruction> chain;
+				// values on virtual registers are 64 bits, only 64 bit counters
+				// grow as the pointer does
+				if (variable.type != IR_TYPE_I64 || !linear_chain(loop, variable, address, definition_blocks[address],
+					definition_positions[address], scale, chain) || scale == 0) {
+					continue;
+				}
+
+				// the pointer starts at the address of the first iteration
+				Local_Index pointer = function.locals.size();
+				function.locals.push_back({.name = SYMBOL_NONE, .type = IR_TYPE_I64});
+				Ir_Instruction load = new_instruction(IR_OP_LOAD_LOCAL);
+				load.dst = function.values++;
+				load.imm = variable.local;
+				Value start = emit(loop, load);
+				Ir_Instruction store = new_instruction(IR_OP_STORE_LOCAL);
+				store.a = clone_chain(loop, variable, chain, start);
+				store.imm = pointer;
+				emit(loop, store);
+
+				Value step = materialize(loop, variable.step);
+				if (scale != 1) {
+					Ir_Instruction constant = new_instruction(IR_OP_CONST);
+					constant.dst = function.values++;
+					constant.imm = scale;
+					Ir_Instruction multiply = new_instruction(IR_OP_BINARY);
+					multiply.op = OP_TYPE_MUL;
+					multiply.dst = function.values++;
+					multiply.a = step;
+					multiply.b = emit(loop, constant);
+					step = emit(loop, multiply);
+				}
+
+				// the address reads the pointer, increased right after the counter
+				Ir_Instruction& definition = function.blocks[definition_blocks[address]].instructions[definition_positions[address]];
+				definition = new_instruction(IR_OP_LOAD_LOCAL);
+				definition.dst = address;
+				definition.imm = pointer;
+
+				Ir_Instruction current = new_instruction(IR_OP_LOAD_LOCAL);
+				current.dst = function.values++;
+				current.imm = pointer;
+				Ir_Instruction increment = new_instruction(IR_OP_BINARY);
+				increment.op = OP_TYPE_ADD;
+				increment.dst = function.values++;
+				increment.a = current.dst;
+				increment.b = step;
+				store.a = increment.dst;
+				std::vector<Ir_Instruction>& instructions = function.blocks[variable.block].instructions;
+				instructions.insert(instructions.begin() + variable.store + 1, {current, increment, store});
+
+				reductions.push_back({.counter = variable.local, .pointer = pointer, .scale = scale, .chain = chain});
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool LoopOptimizer::replace_test(const Ir_Loop& loop) {
+	find_definitions();
+	std::vector<Induction_Variable> variables = find_induction_variables(loop);
+	std::vector<Ir_Instruction>& header = function.blocks[loop.header].instructions;
+	if (header.back().opcode != IR_OP_BR || definition_blocks[header.back().a] != loop.header) {
+		return false;
+	}
+	Value test = header.back().a;
+
+	const Ir_Instruction compare = definitions[test];
+	if (compare.opcode != IR_OP_BINARY || (compare.op != OP_TYPE_LT && compare.op != OP_TYPE_LTE)
+		|| definition_blocks[compare.a] != loop.header || !is_invariant(loop, compare.b)) {
+		return false;
+	}
+	auto counter = std::find_if(variables.begin(), variables.end(), [&](const Induction_Variable& variable) {
+		return definitions[compare.a].opcode == IR_OP_LOAD_LOCAL && definitions[compare.a].imm == variable.local;
+	});
+	if (counter == variables.end() || !is_removable(loop, *counter, test)) {
+		return false;
+	}
+
+	// The limit is start + scale * (bound - counter start), with a 32 bit
+	// bound and counter start the distance takes 33 bits and the scale 16
+	// more, so added to an address of the program it can't wrap
+	int64_t step;
+	IrType narrow = counter->type == IR_TYPE_I8 ? IR_TYPE_I8 : IR_TYPE_I32;
+	if (!is_constant(counter->step, step) || step <= 0 || !fits(compare.b, narrow) || !starts_narrow(loop, *counter, narrow)) {
+		return false;
+	}
+	// a narrower counter may wrap, unless it stops right at the bound
+	if (counter->type != IR_TYPE_I64 && (step != 1 || compare.op != OP_TYPE_LT)) {
+		return false;
+	}
+
+	// counter < bound holds while the pointer is below its address for bound
+	Value limit = VALUE_NONE;
+	Local_Index replacement = 0;
+	for (const Reduced_Address& reduction: reductions) {
+		if (reduction.counter == counter->local && reduction.scale > 0 && reduction.scale <= MAX_TEST_SCALE) {
+			limit = clone_chain(loop, *counter, reduction.chain, materialize(loop, compare.b));
+			replacement = reduction.pointer;
+			break;
+		}
+	}
+
+	// or while another pointer growing k times as fast is below start + k * (bound - counter)
+	if (limit == VALUE_NONE) {
+		for (const Induction_Variable& other: variables) {
+			int64_t other_step;
+			if (other.local == counter->local || other.type != IR_TYPE_I64 || !is_constant(other.step, other_step)
+				|| other_step <= 0 || other_step % step != 0 || other_step / step > MAX_TEST_SCALE
+				|| !is_dereferenced(loop, other.local)) {
+				continue;
+			}
+
+			Ir_Instruction start = new_instruction(IR_OP_LOAD_LOCAL);
+			start.dst = function.values++;
+			start.imm = other.local;
+			Ir_Instruction first = new_instruction(IR_OP_LOAD_LOCAL);
+			first.dst = function.values++;
+			first.imm = counter->local;
+			first.type = counter->type;
+			Ir_Instruction distance = new_instruction(IR_OP_BINARY);
+			distance.op = OP_TYPE_SUB;
+			distance.dst = function.values++;
+			distance.a = materialize(loop, compare.b);
+			distance.b = emit(loop, first);
+			Value offset = emit(loop, distance);
+			if (other_step != step) {
+				Ir_Instruction factor = new_instruction(IR_OP_CONST);
+				factor.dst = function.values++;
+				factor.imm = other_step / step;
+				Ir_Instruction multiply = new_instruction(IR_OP_BINARY);
+				multiply.op = OP_TYPE_MUL;
+				multiply.dst = function.values++;
+				multiply.a = offset;
+				multiply.b = emit(loop, factor);
+				offset = emit(loop, multiply);
+			}
+			Ir_Instruction sum = new_instruction(IR_OP_BINARY);
+			sum.op = OP_TYPE_ADD;
+			sum.dst = function.values++;
+			sum.a = emit(loop, start);
+			sum.b = offset;
+			limit = emit(loop, sum);
+			replacement = other.local;
+			break;
+		}
+	}
+	if (limit == VALUE_NONE) {
+		return false;
+	}
+
+	// the test compares the replacement, the counter is no longer increased
+	Ir_Instruction load = new_instruction(IR_OP_LOAD_LOCAL);
+	load.dst = function.values++;
+	load.imm = replacement;
+	size_t position = definition_positions[test];
+	header.insert(header.begin() + position, load);
+	header[position + 1].a = load.dst;
+	header[position + 1].b = limit;
+
+	std::vector<Ir_Instruction>& instructions = function.blocks[counter->block].instructions;
+	instructions.erase(instructions.begin() + counter->store);
+	return true;
+}
+
+bool LoopOptimizer::fits(Value value, IrType type) {
+	int64_t constant;
+	if (is_constant(value, constant)) {
+		return type == IR_TYPE_I64 || constant == (type == IR_TYPE_I8 ? (int8_t) constant : (int32_t) constant);
+	}
+	// loads of narrower values are sign extended
+	const Ir_Instruction& definition = definitions[value];
+	return type == IR_TYPE_I64 || ((definition.opcode == IR_OP_LOAD_LOCAL || definition.opcode == IR_OP_LOAD) && definition.type <= type);
+}
+
+bool LoopOptimizer::starts_narrow(const Ir_Loop& loop, const Induction_Variable& variable, IrType type) {
+	if (variable.type <= type) {
+		return true;
+	}
+
+	// the last store before the loop, on the blocks leading to its preheader
+	Block_Index block = loop.preheader;
+	for (size_t visited = 0; visited < function.blocks.size(); visited++) {
+		const std::vector<Ir_Instruction>& instructions = function.blocks[block].instructions;
+		for (size_t i = instructions.size(); i-- > 0;) {
+			if (instructions[i].opcode == IR_OP_STORE_LOCAL && instructions[i].imm == variable.local) {
+				return fits(instructions[i].a, type);
+			}
+		}
+		if (predecessors[block].size() != 1) {
+			return false;
+		}
+		block = predecessors[block][0];
+	}
+	return false;
+}
+
+bool LoopOptimizer::is_dereferenced(const Ir_Loop& loop, Local_Index local) {
+	// an address the program loads or stores through is below 2^47
+	for (Block_Index block = 0; block < function.blocks.size(); block++) {
+		if (!loop.blocks[block]) {
+			continue;
+		}
+		for (const Ir_Instruction& access: function.blocks[block].instructions) {
+			if ((access.opcode == IR_OP_LOAD || access.opcode == IR_OP_STORE) && definitions[access.a].opcode == IR_OP_LOAD_LOCAL
+				&& definitions[access.a].imm == local) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool LoopOptimizer::is_removable(const Ir_Loop& loop, const Induction_Variable& variable, Value test) {
+	static_assert(IR_OP_COUNTER == 15, "Unhandled IR_OP_COUNTER on is_removable at loop_optimizer.cpp");
+	// not read once the loop is left
+	std::vector<Bitset> live_in = local_live_in(function);
+	for (Block_Index block = 0; block < function.blocks.size(); block++) {
+		bool read_outside = false;
+		if (loop.blocks[block]) {
+			for_each_successor(function.blocks[block].instructions.back(), [&](Block_Index successor) {
+				read_outside = read_outside || (!loop.blocks[successor] && test_bit(live_in[successor], variable.local));
+			});
+		}
+		if (read_outside) {
+			return false;
+		}
+	}
+
+	// values some side effect depends on, besides the increment and the test
+	std::vector<bool> needed(function.values, false);
+	std::vector<Value> pending;
+	auto need = [&](Value value) {
+		if (!needed[value]) {
+			needed[value] = true;
+			pending.push_back(value);
+		}
+	};
+	for (const Ir_Block& block: function.blocks) {
+		for (const Ir_Instruction& instruction: block.instructions) {
+			bool effect = instruction.dst == VALUE_NONE || instruction.opcode == IR_OP_CALL || instruction.opcode == IR_OP_LOAD
+				|| (instruction.opcode == IR_OP_BINARY && (instruction.op == OP_TYPE_DIV || instruction.op == OP_TYPE_MOD));
+			bool increment = instruction.opcode == IR_OP_STORE_LOCAL && instruction.imm == variable.local;
+			if (effect && !increment && instruction.dst != test) {
+				for_each_use(function, instruction, need);
+			}
+		}
+	}
+	while (!pending.empty()) {
+		Value value = pending.back();
+		pending.pop_back();
+		if (value != test) {
+			for_each_use(function, definitions[value], need);
+		}
+	}
+
+	for (Value value = 0; value < function.values; value++) {
+		const Ir_Instruction& definition = definitions[value];
+		if (needed[value] && is_defined_in(loop, value) && definition.opcode == IR_OP_LOAD_LOCAL && definition.imm == variable.local) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+#include "ir.hpp"
+
+typedef struct {
+	Block_Index header;
+	// only block entering the loop, ends jumping to the header
+	Block_Index preheader;
+	std::vector<bool> blocks;
+	// blocks of the loops nested on this one
+	std::vector<bool> nested;
+	// blocks jumping back to the header
+	std::vector<Block_Index> latches;
+} Ir_Loop;
+
+// Local only written once on every iteration, adding an invariant step
+typedef struct {
+	Local_Index local;
+	IrType type;
+	Block_Index block;
+	// position of the store on block
+	size_t store;
+	Value step;
+} Induction_Variable;
+
+// Address strength reduced to a pointer increased along with counter
+typedef struct {
+	Local_Index counter;
+	Local_Index pointer;
+	// the pointer grows scale times as fast as the counter
+	int64_t scale;
+	// instructions computing the address from a load of the counter
+	std::vector<Ir_Instruction> chain;
+} Reduced_Address;
+
+/**
+ * @brief Optimizes the natural loops of a function, the while loops of the
+ * source. Instructions computing the same value on every iteration move to
+ * a preheader run once before entering the loop. Addresses growing linearly
+ * with a counter get a local of their own increased along with it, and when
+ * the counter is then only left for the loop test the test compares one of
+ * those pointers against its final value and the counter goes away, as long
+ * as the final value can't wrap around.
+ */
+class LoopOptimizer {
+private:
+	Ir_Function& function;
+	std::vector<std::vector<Block_Index>> predecessors;
+	// immediate dominator of every block, BLOCK_NONE if the entry can't reach it
+	std::vector<Block_Index> dominators;
+	// innermost loops first
+	std::vector<Ir_Loop> loops;
+	// copy of the instruction defining every value, its block and position
+	std::vector<Ir_Instruction> definitions;
+	std::vector<Block_Index> definition_blocks;
+	std::vector<size_t> definition_positions;
+	// addresses reduced on the loop being visited
+	std::vector<Reduced_Address> reductions;
+
+	void find_loops();
+	void analyze();
+	bool add_preheader();
+	bool dominates(Block_Index dominator, Block_Index block);
+	void find_definitions();
+	bool is_defined_in(const Ir_Loop& loop, Value value);
+	bool is_invariant(const Ir_Loop& loop, Value value);
+	bool is_constant(Value value, int64_t& constant);
+	bool is_hoistable(const Ir_Loop& loop, const std::vector<bool>& stored, const Ir_Instruction& instruction);
+	Value materialize(const Ir_Loop& loop, Value value);
+	Value emit(const Ir_Loop& loop, Ir_Instruction instruction);
+	size_t hoist(const Ir_Loop& loop);
+
+	std::vector<Induction_Variable> find_induction_variables(const Ir_Loop& loop);
+	bool linear_chain(const Ir_Loop& loop, const Induction_Variable& variable, Value value, Block_Index block, size_t position, int64_t& scale, std::vector<Ir_Instruction>& chain);
+	Value clone_chain(const Ir_Loop& loop, const Induction_Variable& variable, const std::vector<Ir_Instruction>& chain, Value start);
+	bool reduce_address(const Ir_Loop& loop);
+	bool replace_test(const Ir_Loop& loop);
+	bool fits(Value value, IrType type);
+	bool starts_narrow(const Ir_Loop& loop, const Induction_Variable& variable, IrType type);
+	bool is_dereferenced(const Ir_Loop& loop, Local_Index local);
+	bool is_removable(const Ir_Loop& loop, const Induction_Variable& variable, Value test);
+
+public:
+	LoopOptimizer(Ir_Function& function);
+
+	/**
+	 * @brief Move the instructions without side effects whose operands
+	 * don't change inside a loop to its preheader, inner loops first
+	 * @return number of instructions hoisted
+	 */
+	size_t hoist_invariants();
+
+	/**
+	 * @brief Strength reduce the addresses computed from induction variables
+	 * and replace the loop tests on counters only used by them
+	 * @return number of addresses reduced and counters removed
+	 */
+	size_t reduce_induction_variables();
+};
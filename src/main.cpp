@@ -1,41 +1,146 @@
+#include <algorithm>
+#include <charconv>
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <thread>
 #include <vector>
+#include <unistd.h>
 #include "lexer.hpp"
 #include "parser.hpp"
 #include "compiler.hpp"
+#include "inliner.hpp"
+#include "ir_builder.hpp"
+#include "optimizer.hpp"
 #include "preprocessor.hpp"
+#include "thread_pool.hpp"
+#include "token_cache.hpp"
 
-int main(int argc, char** argv) {
-	if (argc < 2) {
-		std::cerr << "Syntax: " << argv[0] << " <filename>" << std::endl;
-		exit(1);
+static void usage(char* program) {
+	std::cerr << "Syntax: " << program << " <filename> [-j <threads>] [--no-cache] [--emit-ir] [--emit-asm] [--stats] [--inline-threshold <instructions>] [--inline-report] [--run [arguments...]]" << std::endl;
+	exit(1);
+}
+
+/**
+ * @brief Value of a numeric option, anything but a whole non negative number
+ * prints the usage
+ */
+static size_t parse_count(char* program, std::string_view text) {
+	size_t count;
+	auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), count);
+	if (error != std::errc() || end != text.data() + text.size()) {
+		usage(program);
 	}
+	return count;
+}
 
-	std::string filename = argv[1];
-	std::vector<std::string> filenames;
+int main(int argc, char** argv) {
+	std::string filename;
+	// 1 streams the tokens to the parser, more lexes, parses, lowers and
+	// compiles the functions in parallel, 0 uses one thread per CPU
+	size_t jobs = 1;
+	bool emit_ir = false;
+	bool emit_asm = false;
+	// arguments of the program when it runs in memory, its name first
+	std::vector<char*> run_arguments;
+	Optimization_Options options = {.stats = false, .inline_threshold = DEFAULT_INLINE_THRESHOLD, .inline_report = false};
 
-	std::vector<Token> tokens;
-	Preprocessor::preprocess_includes(filename, filenames, tokens);
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-j") {
+			if (i + 1 == argc) {
+				usage(argv[0]);
+			}
+			jobs = parse_count(argv[0], argv[++i]);
+		} else if (arg.rfind("-j", 0) == 0) {
+			jobs = parse_count(argv[0], std::string_view(arg).substr(2));
+		} else if (arg == "--no-cache") {
+			TokenCache::set_directory("");
+		} else if (arg == "--emit-ir") {
+			emit_ir = true;
+		} else if (arg == "--emit-asm") {
+			emit_asm = true;
+		} else if (arg == "--stats") {
+			options.stats = true;
+		} else if (arg == "--inline-threshold") {
+			if (i + 1 == argc) {
+				usage(argv[0]);
+			}
+			options.inline_threshold = parse_count(argv[0], argv[++i]);
+		} else if (arg == "--inline-report") {
+			options.inline_report = true;
+		} else if (arg == "--run") {
+			if (filename.empty()) {
+				usage(argv[0]);
+			}
+			run_arguments.push_back(filename.data());
+			run_arguments.insert(run_arguments.end(), argv + i + 1, argv + argc);
+			run_arguments.push_back(nullptr);
+			break;
+		} else if (filename.empty()) {
+			filename = arg;
+		} else {
+			usage(argv[0]);
+		}
+	}
 
-	std::unique_ptr<Lexer> lex = std::make_unique<Lexer>();
-	lex->set_tokens(tokens);
+	if (filename.empty()) {
+		usage(argv[0]);
+	}
+	if (jobs == 0) {
+		jobs = std::max(1u, std::thread::hardware_concurrency());
+	}
 
-	Parser parser = Parser(std::move(lex));
-	std::vector<std::shared_ptr<Statement>> statements = parser.parse_code();
+	// Lexing, parsing, lowering and code generation share the workers
+	std::unique_ptr<ThreadPool> pool = jobs > 1 ? std::make_unique<ThreadPool>(jobs) : nullptr;
+	Ast ast;
+	if (pool != nullptr) {
+		// Lex the include graph and parse the top level functions in parallel
+		std::vector<Token> tokens;
+		Preprocessor::preprocess_includes(filename, tokens, *pool);
+		ast = Parser::parse_code(tokens, *pool);
+	} else {
+		// Tokens are pulled through the preprocessor while parsing
+		Preprocessor preprocessor = Preprocessor(filename);
+		std::unique_ptr<Lexer> lex = std::make_unique<Lexer>([&preprocessor](Token& token) {
+			return preprocessor.next_token(token);
+		});
+		Parser parser = Parser(std::move(lex));
+		ast = parser.parse_code();
+	}
 
-	Compiler compiler = Compiler(statements);
-	std::string program = compiler.compile_program();
+	IrModule module = IrBuilder(ast, pool.get()).build();
+	Optimizer(module, options).optimize();
+	if (emit_ir) {
+		std::cout << module.dump();
+		return 0;
+	}
 
-	std::ofstream file("main.asm");
-	file << program;
-	file.close();
+	Compiler compiler = Compiler(module, pool.get());
+	if (!run_arguments.empty()) {
+		Jit_Image image = compiler.compile_image();
+		if (options.stats) {
+			compiler.print_peephole_stats();
+		}
+		// exiting through the exit syscall only ends the calling thread
+		pool.reset();
+		return jit_run(image, run_arguments.size() - 1, run_arguments.data(), environ);
+	}
+	if (emit_asm) {
+		// The NASM source is kept next to the executable for debugging
+		{
+			OutputSink out("main.asm");
+			compiler.compile_program(out);
+		}
 
-	system("nasm -f elf64 -o main.o main.asm");
-	system("ld -o main.out main.o");
-	system("rm main.asm");
-	system("rm main.o");
+		system("nasm -f elf64 -o main.o main.asm");
+		system("ld -o main.out main.o");
+		system("rm main.o");
+	} else {
+		compiler.compile_executable("main.out");
+	}
+	if (options.stats) {
+		compiler.print_peephole_stats();
+	}
 
 	return 0;
 }
@@ -0,0 +1,64 @@
+#include <iostream>
+#include "optimizer.hpp"
+#include "constant_folder.hpp"
+#include "dead_code_eliminator.hpp"
+#include "inliner.hpp"
+#include "loop_optimizer.hpp"
+#include "tail_call_optimizer.hpp"
+
+Optimizer::Optimizer(IrModule& module, Optimization_Options options) : module(module), options(options) {}
+
+void Optimizer::optimize() {
+	function_stats.assign(module.functions.size(), {});
+	for (uint32_t function = 0; function < module.functions.size(); function++) {
+		// a function looping on itself is no longer recursive for the inliner
+		function_stats[function].tail_calls += TailCallOptimizer(module.functions[function]).loop_self_calls();
+		simplify(function);
+	}
+
+	// callees are inlined once simplified, and the callers simplified again
+	Inliner inliner(module, options.inline_threshold);
+	for (uint32_t function: inliner.bottom_up_order()) {
+		size_t inlined = inliner.inline_calls(module.functions[function]);
+		function_stats[function].inlined += inlined;
+		if (inlined > 0) {
+			simplify(function);
+		}
+	}
+
+	// loops are final once inlining is over, preheaders are added to all
+	// of them so the function is simplified again either way
+	for (uint32_t function = 0; function < module.functions.size(); function++) {
+		LoopOptimizer loop_optimizer(module.functions[function]);
+		function_stats[function].hoisted += loop_optimizer.hoist_invariants();
+		function_stats[function].reduced += loop_optimizer.reduce_induction_variables();
+		simplify(function);
+	}
+
+	for (uint32_t function = 0; function < module.functions.size(); function++) {
+		function_stats[function].tail_calls += TailCallOptimizer(module.functions[function]).mark_tail_calls();
+	}
+
+	if (options.inline_report) {
+		for (const std::string& line: inliner.get_report()) {
+			std::cerr << "inlined " << line << std::endl;
+		}
+	}
+	if (options.stats) {
+		print_stats();
+	}
+}
+
+void Optimizer::simplify(uint32_t function) {
+	function_stats[function].folded += ConstantFolder(module.functions[function]).fold();
+	function_stats[function].removed += DeadCodeEliminator(module.functions[function]).eliminate();
+}
+
+void Optimizer::print_stats() {
+	for (uint32_t function = 0; function < module.functions.size(); function++) {
+		const Optimization_Stats& stats = function_stats[function];
+		std::cerr << Interner::name(module.functions[function].name) << ": " << stats.folded << " folded, "
+			<< stats.removed << " removed, " << stats.inlined << " inlined, " << stats.tail_calls << " tail calls, "
+			<< stats.hoisted << " hoisted, " << stats.reduced << " reduced" << std::endl;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "ir.hpp"
+
+typedef struct {
+	// print what every pass did on each function to stderr
+	bool stats;
+	// callees up to this many instructions are inlined, 0 disables it
+	size_t inline_threshold;
+	// print every call inlined to stderr
+	bool inline_report;
+} Optimization_Options;
+
+typedef struct {
+	size_t folded;
+	size_t removed;
+	size_t inlined;
+	size_t tail_calls;
+	size_t hoisted;
+	size_t reduced;
+} Optimization_Stats;
+
+/**
+ * @brief Runs the IR passes over every function of a module before the
+ * backend selects instructions
+ */
+class Optimizer {
+private:
+	IrModule& module;
+	Optimization_Options options;
+	std::vector<Optimization_Stats> function_stats;
+
+	void simplify(uint32_t function);
+	void print_stats();
+
+public:
+	Optimizer(IrModule& module, Optimization_Options options);
+	void optimize();
+};
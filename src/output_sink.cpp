@@ -0,0 +1,65 @@
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "output_sink.hpp"
+#include "utils.hpp"
+
+OutputSink::OutputSink(const std::string& path) : path(path), buffer(OUTPUT_SINK_BUFFER_SIZE), used(0) {
+	fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		Utils::error("Couldn't write " + path + ": " + strerror(errno));
+	}
+}
+
+OutputSink::~OutputSink() {
+	flush();
+	close(fd);
+}
+
+void OutputSink::write_buffer(const char* data, size_t size) {
+	while (size > 0) {
+		ssize_t written = write(fd, data, size);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		} else if (written < 0) {
+			Utils::error("Couldn't write " + path + ": " + strerror(errno));
+		}
+		data += written;
+		size -= written;
+	}
+}
+
+OutputSink& OutputSink::append(std::string_view text) {
+	if (used + text.size() > buffer.size()) {
+		flush();
+		// larger than the whole buffer, nothing to gain copying it
+		if (text.size() > buffer.size()) {
+			write_buffer(text.data(), text.size());
+			return *this;
+		}
+	}
+	memcpy(buffer.data() + used, text.data(), text.size());
+	used += text.size();
+	return *this;
+}
+
+OutputSink& OutputSink::append(char c) {
+	if (used == buffer.size()) {
+		flush();
+	}
+	buffer[used++] = c;
+	return *this;
+}
+
+OutputSink& OutputSink::append_number(int64_t number) {
+	char digits[24];
+	char* end = std::to_chars(digits, digits + sizeof(digits), number).ptr;
+	return append(std::string_view(digits, end - digits));
+}
+
+void OutputSink::flush() {
+	write_buffer(buffer.data(), used);
+	used = 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Bytes gathered before they are written to the file
+#define OUTPUT_SINK_BUFFER_SIZE (64 * 1024)
+
+/**
+ * @brief Append-only text written to a file through a fixed size buffer.
+ * Everything generated goes straight to it, so writing the output takes
+ * time linear in its size and memory bounded by the buffer.
+ */
+class OutputSink {
+private:
+	int fd;
+	std::string path;
+	std::vector<char> buffer;
+	size_t used;
+
+	void write_buffer(const char* data, size_t size);
+
+public:
+	/**
+	 * @brief Sink truncating the file at path
+	 */
+	OutputSink(const std::string& path);
+
+	/**
+	 * @brief Flush and close the file
+	 */
+	~OutputSink();
+	OutputSink(const OutputSink&) = delete;
+	OutputSink& operator=(const OutputSink&) = delete;
+
+	OutputSink& append(std::string_view text);
+	OutputSink& append(char c);
+	OutputSink& append_number(int64_t number);
+
+	/**
+	 * @brief Write the buffered bytes to the file
+	 */
+	void flush();
+};
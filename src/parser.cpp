@@ -1,15 +1,72 @@
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include "parser.hpp"
 
-Parser::Parser(std::unique_ptr<Lexer>&& lexer) : tokens(lexer->get_tokens()), lexer(std::move(lexer)) {}
-std::vector<std::shared_ptr<Statement>> Parser::parse_code() {
-	std::vector<std::shared_ptr<Statement>> stmt_vector;
+typedef struct {
+	Token::Type token;
+	OpType type;
+	// higher binds tighter, every binary operator is left associative
+	int precedence;
+} Binary_Operator;
+
+static constexpr Binary_Operator operator_table[] = {
+	{Token::Type::LOGICAL_OR, OP_TYPE_OR, 1},
+	{Token::Type::LOGICAL_AND, OP_TYPE_AND, 2},
+	{Token::Type::BIT_OR, OP_TYPE_BIT_OR, 3},
+	{Token::Type::BIT_XOR, OP_TYPE_BIT_XOR, 4},
+	{Token::Type::BIT_AND, OP_TYPE_BIT_AND, 5},
+	{Token::Type::EQUALS_COMPARE, OP_TYPE_EQ, 6},
+	{Token::Type::BANG_EQUALS, OP_TYPE_NEQ, 6},
+	{Token::Type::LOWER_THAN, OP_TYPE_LT, 7},
+	{Token::Type::GREATER_THAN, OP_TYPE_GT, 7},
+	{Token::Type::LOWER_THAN_EQUALS, OP_TYPE_LTE, 7},
+	{Token::Type::GREATER_THAN_EQUALS, OP_TYPE_GTE, 7},
+	{Token::Type::SHIFT_LEFT, OP_TYPE_SHL, 8},
+	{Token::Type::SHIFT_RIGHT, OP_TYPE_SHR, 8},
+	{Token::Type::ADD, OP_TYPE_ADD, 9},
+	{Token::Type::SUB, OP_TYPE_SUB, 9},
+	{Token::Type::MUL, OP_TYPE_MUL, 10},
+	{Token::Type::DIV, OP_TYPE_DIV, 10},
+	{Token::Type::MOD, OP_TYPE_MOD, 10},
+};
+
+static_assert(std::size(operator_table) == OP_TYPE_COUNT, "Unhandled OP_TYPE_COUNT on operator_table at parser.cpp");
+
+// prefix operators bind tighter than any binary operator
+#define UNARY_PRECEDENCE 11
+
+// operator_table indexed by token type, precedence 0 for tokens that aren't binary operators
+static constexpr std::array<Binary_Operator, Token::Type::TOKEN_COUNTER> binary_operators = [] {
+	std::array<Binary_Operator, Token::Type::TOKEN_COUNTER> operators = {};
+	for (const Binary_Operator& op: operator_table) {
+		operators[op.token] = op;
+	}
+	return operators;
+}();
+
+static long parse_number(std::string_view value) {
+	long number = 0;
+	std::from_chars(value.data(), value.data() + value.size(), number);
+	return number;
+}
+
+Parser::Parser(std::unique_ptr<Lexer>&& lexer) : lexer(std::move(lexer)) {}
+
+Node_List Parser::end_list(size_t list_start) {
+	Node_List list = ast.add_list(std::span<const uint32_t>(pending_list.data() + list_start, pending_list.size() - list_start));
+	pending_list.resize(list_start);
+	return list;
+}
+
+Ast Parser::parse_code() {
 	while (!lexer->is_parsed()) {
 		Token token = lexer->next_token();
 		switch (token.get_type()) {
 			case Token::Type::FUNCTION:
-				stmt_vector.push_back(parse_function());
+				ast.program.push_back(parse_function());
 				break;
 
 			default:
@@ -18,61 +75,144 @@ std::vector<std::shared_ptr<Statement>> Parser::parse_code() {
 		}
 	}
 
-	return stmt_vector;
+	return std::move(ast);
 }
 
-std::shared_ptr<Statement> Parser::parse_function() {
-	std::shared_ptr<Statement> stmt = std::make_shared<Statement>(); 
-	stmt->fnc = std::make_shared<Func_Def>();
-	stmt->type = STMT_TYPE_FUNCTION_DECLARATION;
+// below this many tokens per chunk the merge costs more than the parallelism saves
+#define PARSE_CHUNK_MIN_TOKENS 4096
+// chunks per thread, more chunks balance uneven functions better
+#define PARSE_CHUNKS_PER_THREAD 8
+
+/**
+ * @brief Starts of the chunks the tokens are split into, every chunk begins
+ * with a top level function keyword (or is the whole stream)
+ */
+static std::vector<size_t> split_top_level(std::span<const Token> tokens, size_t chunk_count) {
+	size_t chunk_size = std::max(tokens.size() / std::max(chunk_count, (size_t) 1), (size_t) PARSE_CHUNK_MIN_TOKENS);
+	std::vector<size_t> starts = {0};
+	long depth = 0;
+
+	for (size_t i = 0; i < tokens.size(); i++) {
+		switch (tokens[i].get_type()) {
+			case Token::Type::OPEN_CURLY:
+				depth++;
+				break;
+			case Token::Type::CLOSE_CURLY:
+				depth--;
+				break;
+			case Token::Type::FUNCTION:
+				if (depth == 0 && i - starts.back() >= chunk_size) {
+					starts.push_back(i);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	// unbalanced braces, leave the error to a single sequential parse
+	if (depth != 0) {
+		starts.resize(1);
+	}
 
-	Token token = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after function keyword, but got " + lexer->explore_last_token().get_value());
-	stmt->fnc->name = token.get_value();
+	return starts;
+}
+
+Ast Parser::parse_code(std::span<const Token> tokens, ThreadPool& pool) {
+	std::vector<size_t> starts = split_top_level(tokens, pool.size() * PARSE_CHUNKS_PER_THREAD);
+	starts.push_back(tokens.size());
+
+	std::vector<Ast> chunks(starts.size() - 1);
+	std::vector<std::string> errors(chunks.size());
+	for (size_t i = 0; i + 1 < starts.size(); i++) {
+		pool.submit([&tokens, &starts, &chunks, &errors, i] {
+			errors[i] = Utils::capture_errors([&] {
+				std::unique_ptr<Lexer> lexer = std::make_unique<Lexer>();
+				lexer->set_tokens(tokens.subspan(starts[i], starts[i + 1] - starts[i]));
+				Parser parser = Parser(std::move(lexer));
+				chunks[i] = parser.parse_code();
+			});
+		});
+	}
+	pool.wait();
+
+	// the first error of the earliest chunk is the one a sequential parse stops on
+	for (const std::string& error: errors) {
+		if (!error.empty()) {
+			Utils::report_error(error);
+		}
+	}
+
+	// every chunk knows where its nodes go once they are all parsed, so
+	// they are also relocated into the final arenas in parallel
+	Ast ast = std::move(chunks[0]);
+	std::span<const Ast> rest = std::span<const Ast>(chunks).subspan(1);
+	std::vector<Ast_Offsets> places = ast.grow(rest);
+	for (size_t i = 0; i < rest.size(); i++) {
+		pool.submit([&ast, &rest, &places, i] {
+			ast.place(rest[i], places[i]);
+		});
+	}
+	pool.wait();
+
+	return ast;
+}
+
+Stmt_Index Parser::parse_function() {
+	Func_Def fnc = {};
+
+	fnc.name = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after function keyword").get_symbol();
 
 	lexer->expect_next_token(Token::Type::OPEN_PAREN, "Parsing error: expected open paren after function declaration");
 
-	token = lexer->next_token();
+	const Token& token = lexer->next_token();
 	if (token.get_type() != Token::Type::CLOSE_PAREN && token.get_type() != Token::Type::NAME){
 		Utils::error("Parsing error: expected name or close parent on function arguments");
 	}
 
 	if (token.get_type() == Token::Type::NAME) {
-		stmt->fnc->arguments = parse_fnc_arguments(token);
+		fnc.arguments = parse_fnc_arguments(token);
 	} 
 
 	lexer->expect_next_token(Token::Type::ARROW, "Parsing error: expected type after function arguments");
 
 	size_t stars = count_stars();
-	std::string typestr = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected a name as function type").get_value();
-	stmt->fnc->return_type = get_type_from_string(stars, typestr);
+	const Token& typetok = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected a name as function type");
+	fnc.return_type = get_type_from_token(stars, typetok);
 
 	lexer->expect_next_token(Token::Type::OPEN_CURLY, "Parsing error: expected block after function declaration");
-	stmt->fnc->body = parse_block();
+	fnc.body = parse_block();
 
-	return stmt;
+	Statement stmt;
+	stmt.type = STMT_TYPE_FUNCTION_DECLARATION;
+	stmt.fnc = ast.add(fnc);
+	return ast.add(stmt);
 }
 
-std::vector<std::shared_ptr<Func_Arg>> Parser::parse_fnc_arguments(Token name_token) {
-	std::vector<std::shared_ptr<Func_Arg>> function_arguments;
+Node_List Parser::parse_fnc_arguments(const Token& name_token) {
+	// arguments don't nest, they are contiguous on the arena
+	Node_List function_arguments = {.first = (uint32_t) ast.arguments.size(), .count = 0};
+	Symbol name = name_token.get_symbol();
 	while (true) {
-		std::shared_ptr<Func_Arg> argument = std::make_shared<Func_Arg>();
-		argument->name = name_token.get_value();
+		Func_Arg argument;
+		argument.name = name;
 		lexer->expect_next_token(Token::Type::COLON, "Parsing error: expected colon after name on function definition arguments");
 
 		size_t stars = count_stars();
-		std::string datastr = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after colon on function definition arguments").get_value();
-		argument->type = get_type_from_string(stars, datastr);
+		const Token& datatok = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after colon on function definition arguments");
+		argument.type = get_type_from_token(stars, datatok);
 
-		function_arguments.push_back(argument);
+		ast.arguments.push_back(argument);
+		function_arguments.count++;
 
-		name_token = lexer->next_token();
-		if (name_token.get_type() == Token::Type::CLOSE_PAREN) {
+		const Token& separator = lexer->next_token();
+		if (separator.get_type() == Token::Type::CLOSE_PAREN) {
 			break;
 		}
-		if (name_token.get_type() != Token::Type::COMMA) {
-			Utils::error("Parsing error: expected COMMA as argument separator on token: " + name_token.get_value());
+		if (separator.get_type() != Token::Type::COMMA) {
+			Utils::error("Parsing error: expected COMMA as argument separator on token: " + std::string(separator.get_value()), separator.get_loc());
 		}
-		name_token = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after COMMA separator");
+		name = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after COMMA separator").get_symbol();
 	}
 
 	return function_arguments;
@@ -88,48 +228,44 @@ size_t Parser::count_stars() {
   return counter;
 }
 
-VarType Parser::get_type_from_string(size_t stars, std::string val) {
-	static_assert(VAR_TYPE_COUNTER == 5, "Unhandled VAR_TYPE_COUNTER on get_type_from_string");
+VarType Parser::get_type_from_token(size_t stars, const Token& val) {
+	static_assert(VAR_TYPE_COUNTER == 5, "Unhandled VAR_TYPE_COUNTER on get_type_from_token");
 	VarType varType;
 	varType.stars = stars;
 
-	if (val == "int") {
-		varType.type = VAR_TYPE_INT;
-	} else if (val == "bool") {
-		varType.type = VAR_TYPE_BOOL;
-	} else if (val == "long") {
-		varType.type = VAR_TYPE_LONG;
-	} else if (val == "char") {
-		varType.type = VAR_TYPE_CHAR;
-	} else {
-		Utils::error("Parsing error: unknown type (types allowed: int, bool, long, char), but got " + val);
+	switch (val.get_symbol()) {
+		case SYMBOL_INT: varType.type = VAR_TYPE_INT; break;
+		case SYMBOL_BOOL: varType.type = VAR_TYPE_BOOL; break;
+		case SYMBOL_LONG: varType.type = VAR_TYPE_LONG; break;
+		case SYMBOL_CHAR: varType.type = VAR_TYPE_CHAR; break;
+		default: Utils::error("Parsing error: unknown type (types allowed: int, bool, long, char), but got " + std::string(val.get_value()));
 	}
 
   return varType;
 }
 
-std::vector<std::shared_ptr<Statement>> Parser::parse_block() {
+Node_List Parser::parse_block() {
 	static_assert(STMT_TYPE_COUNTER == 7, "Unhandled STMT_TYPE_COUNTER on parse_block() at parser.cpp");
 	bool unfinished_block = true;
-	std::vector<std::shared_ptr<Statement>> block;
+	size_t block = pending_list.size();
 
 	while (unfinished_block) {
-		Token token = lexer->next_token();
+		const Token& token = lexer->next_token();
 		switch (token.get_type()) {
 			case Token::Type::NAME: 
-				block.push_back(parse_name()); // This can be FUNC_CALL or VAR_REASIGNATION 
+				pending_list.push_back(parse_name()); // This can be FUNC_CALL or VAR_REASIGNATION 
 				break;
 			case Token::Type::RETURN:
-				block.push_back(parse_return());
+				pending_list.push_back(parse_return());
 				break;
 			case Token::Type::VAR:
-				block.push_back(parse_var());
+				pending_list.push_back(parse_var());
 				break;
 			case Token::Type::IF:
-				block.push_back(parse_if());
+				pending_list.push_back(parse_if());
 				continue; 
 			case Token::Type::WHILE:
-				block.push_back(parse_while());
+				pending_list.push_back(parse_while());
 				continue;
 			case Token::Type::MUL: {
 				// if extra stars report an error and exit
@@ -139,16 +275,14 @@ std::vector<std::shared_ptr<Statement>> Parser::parse_block() {
 					exit(1);
 				}
 
-				std::shared_ptr<Var_Asign> var = std::make_shared<Var_Asign>();
-				var->name = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after star on statement").get_value();
-				var->is_ptr = true;
+				Statement stmt;
+				stmt.type = STMT_TYPE_VAR_REASIGNATION;
+				stmt.var = {};
+				stmt.var.name = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after star on statement").get_symbol();
+				stmt.var.is_ptr = true;
 				lexer->expect_next_token(Token::Type::EQUALS, "Parsing error: expected equals after left hand side on pointer var reasignation");
-				var->value = parse_expr(lexer->next_token());
-
-				std::shared_ptr<Statement> stmt = std::make_shared<Statement>();
-				stmt->type = STMT_TYPE_VAR_REASIGNATION;
-				stmt->var = var;
-				block.push_back(stmt);
+				stmt.var.value = parse_expr(lexer->next_token());
+				pending_list.push_back(ast.add(stmt));
 				break;
 			}
 			case Token::Type::CLOSE_CURLY: 
@@ -158,280 +292,233 @@ std::vector<std::shared_ptr<Statement>> Parser::parse_block() {
 				// Allows optional semicolon at end of the statement
 				break;
 			default:
-				Utils::error("Parsing error: couldn't parse expression " + token.get_value());
+				Utils::error("Parsing error: couldn't parse expression " + std::string(token.get_value()), token.get_loc());
 		}
 	}
 
-	return block;
+	return end_list(block);
 }
 
-std::shared_ptr<Statement> Parser::parse_while() {
-	std::shared_ptr<Statement> stmt = std::make_shared<Statement>();
-	stmt->type = STMT_TYPE_WHILE;
-	stmt->whilee = std::make_shared<While>();
-	stmt->whilee->condition = parse_expr(lexer->next_token());
-	lexer->expect_next_token(Token::Type::OPEN_CURLY, "Parsing error: expected open curly after if condition, but got " + lexer->explore_last_token().get_value());
-	stmt->whilee->block = parse_block();
-	return stmt;
+Stmt_Index Parser::parse_while() {
+	Statement stmt;
+	stmt.type = STMT_TYPE_WHILE;
+	stmt.whilee.condition = parse_expr(lexer->next_token());
+	lexer->expect_next_token(Token::Type::OPEN_CURLY, "Parsing error: expected open curly after while condition");
+	stmt.whilee.block = parse_block();
+	return ast.add(stmt);
 }
 
-std::shared_ptr<Statement> Parser::parse_if() {
-	std::shared_ptr<Statement> stmt = std::make_shared<Statement>();
-	stmt->type = STMT_TYPE_IF;
-	stmt->iif = std::make_shared<If>();
-	stmt->iif->condition = parse_expr(lexer->next_token());
-	lexer->expect_next_token(Token::Type::OPEN_CURLY, "Parsing error: expected open curly after if condition, but got " + lexer->explore_last_token().get_value());
-	stmt->iif->then = parse_block();
-	Token token = lexer->explore_next_token();
-	if (token.get_type() == Token::Type::ELSE) {
+Stmt_Index Parser::parse_if() {
+	Statement stmt;
+	stmt.type = STMT_TYPE_IF;
+	stmt.iif = {};
+	stmt.iif.condition = parse_expr(lexer->next_token());
+	lexer->expect_next_token(Token::Type::OPEN_CURLY, "Parsing error: expected open curly after if condition");
+	stmt.iif.then = parse_block();
+	if (lexer->explore_next_token().get_type() == Token::Type::ELSE) {
 		lexer->next_token();
 		lexer->expect_next_token(Token::Type::OPEN_CURLY, "Parsing error: expected open curly after else statement");
-		stmt->iif->elsse = parse_block();
+		stmt.iif.elsse = parse_block();
 	}
 
-	return stmt;
+	return ast.add(stmt);
 }
 
-std::shared_ptr<Statement> Parser::parse_return() {
-	std::shared_ptr<Statement> ret = std::make_shared<Statement>();
-	ret->type = STMT_TYPE_RETURN;
-	ret->expr = parse_expr(lexer->next_token());
-	return ret;
+Stmt_Index Parser::parse_return() {
+	Statement ret;
+	ret.type = STMT_TYPE_RETURN;
+	ret.expr = parse_expr(lexer->next_token());
+	return ast.add(ret);
 }
 
-std::shared_ptr<Statement> Parser::parse_var() {
-	std::shared_ptr<Statement> var = std::make_shared<Statement>();
-	var->var = std::make_shared<Var_Asign>();
-	var->type = STMT_TYPE_VAR_DECLARATION;
-	Token token = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after var keyword");
-	var->var->name = token.get_value();
+Stmt_Index Parser::parse_var() {
+	Statement var;
+	var.type = STMT_TYPE_VAR_DECLARATION;
+	var.var = {};
+	var.var.name = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after var keyword").get_symbol();
 	lexer->expect_next_token(Token::Type::COLON, "Parsing error: missing semicolon after var name");
 
 	size_t stars = count_stars();
-	std::string typestr = lexer->expect_next_token(Token::Type::NAME, "Parsing error: untyped variables are not allowed").get_value();
-	var->var->type = get_type_from_string(stars, typestr);
+	const Token& typetok = lexer->expect_next_token(Token::Type::NAME, "Parsing error: untyped variables are not allowed");
+	var.var.type = get_type_from_token(stars, typetok);
 
 	lexer->expect_next_token(Token::Type::EQUALS, "Parsing error: expected expresion after variable declaration");
-	var->var->value = parse_expr(lexer->next_token());
-	return var;
+	var.var.value = parse_expr(lexer->next_token());
+	return ast.add(var);
 }
 
-std::shared_ptr<Statement> Parser::parse_name() {
-	Token token = lexer->explore_last_token();
-	Token ntoken = lexer->next_token();
-	switch (ntoken.get_type()) {
-		case Token::Type::EQUALS: return parse_var_reasignation(token);
+Stmt_Index Parser::parse_name() {
+	Symbol name = lexer->explore_last_token().get_symbol();
+	switch (lexer->next_token().get_type()) {
+		case Token::Type::EQUALS: return parse_var_reasignation(name);
 		case Token::Type::OPEN_PAREN: {
-			std::shared_ptr<Statement> stmt = std::make_shared<Statement>();
-			stmt->expr = std::make_shared<Expr>();
-			stmt->type = STMT_TYPE_EXPR;
-			stmt->expr->type = EXPR_TYPE_FUNC_CALL;
-			stmt->expr->func_call = parse_func_call(token);
-			return stmt;
+			Expr expr;
+			expr.type = EXPR_TYPE_FUNC_CALL;
+			expr.func_call = parse_func_call(name);
+
+			Statement stmt;
+			stmt.type = STMT_TYPE_EXPR;
+			stmt.expr = ast.add(expr);
+			return ast.add(stmt);
 		}
-		default: Utils::error("Parsing error: exppected '=' or '(' symbol after using a name as an statement"); exit(1);
+		default: Utils::error("Parsing error: exppected '=' or '(' symbol after using a name as an statement", lexer->explore_last_token().get_loc()); exit(1);
 	}
 }
 
-std::shared_ptr<Statement> Parser::parse_var_reasignation(Token name) {
-	std::shared_ptr<Statement> stmt = std::make_shared<Statement>();
-	stmt->var = std::make_shared<Var_Asign>();
-	stmt->type = STMT_TYPE_VAR_REASIGNATION;
-	stmt->var->name = name.get_value();
-	stmt->var->value = parse_expr(lexer->next_token());
-	return stmt;
+Stmt_Index Parser::parse_var_reasignation(Symbol name) {
+	Statement stmt;
+	stmt.type = STMT_TYPE_VAR_REASIGNATION;
+	stmt.var = {};
+	stmt.var.name = name;
+	stmt.var.value = parse_expr(lexer->next_token());
+	return ast.add(stmt);
 }
 
-std::shared_ptr<Func_Call> Parser::parse_func_call(Token name) {
-	std::shared_ptr<Func_Call> func_call = std::make_shared<Func_Call>();
-	func_call->name = name.get_value();
+Func_Call Parser::parse_func_call(Symbol name) {
+	Func_Call func_call = {.name = name, .args = {}};
 
-	Token token = lexer->next_token();
+	const Token& token = lexer->next_token();
 	if (token.get_type() != Token::Type::CLOSE_PAREN) {
-		func_call->expr = parse_func_call_args(token);
+		func_call.args = parse_func_call_args(token);
 	}
 
 	return func_call;
 }
 
-std::vector<std::shared_ptr<Expr>> Parser::parse_func_call_args(Token token) {
-	std::vector<std::shared_ptr<Expr>> func_call_args;
-	func_call_args.push_back(parse_expr(token));
+Node_List Parser::parse_func_call_args(const Token& token) {
+	size_t func_call_args = pending_list.size();
+	pending_list.push_back(parse_expr(token));
 	while (true) {
-		token = lexer->next_token();
-
-		if (token.get_type() == Token::Type::CLOSE_PAREN) {
+		const Token& separator = lexer->next_token();
+		if (separator.get_type() == Token::Type::CLOSE_PAREN) {
 			break;
 		}
-		if (token.get_type() != Token::Type::COMMA) {
-			Utils::error("Expected COMMA function as argument separator, got " + token.get_value());
+		if (separator.get_type() != Token::Type::COMMA) {
+			Utils::error("Expected COMMA function as argument separator, got " + std::string(separator.get_value()), separator.get_loc());
 		}
-		token = lexer->next_token();
-		func_call_args.push_back(parse_expr(token));
+		pending_list.push_back(parse_expr(lexer->next_token()));
 	}
 
-	return func_call_args;
+	return end_list(func_call_args);
 }
 
-std::shared_ptr<Expr> Parser::parse_expr(Token token) {
-	return parse_expr_with_precedence(token, OP_PREC_0);
+Expr_Index Parser::parse_expr(const Token& token) {
+	return parse_expr_with_precedence(token, 1);
 }
 
-std::shared_ptr<Expr> Parser::parse_primary_expr(Token token) {
-	static_assert(EXPR_TYPE_COUNTER == 6, "Unhandled EXPR_TYPE_FUNC_COUNT on parse_expr() on file parser.cpp");
-	std::shared_ptr<Expr> expr = std::make_shared<Expr>();
-	switch (token.get_type()) {
-		case Token::Type::NAME:
-			if (token.get_value() == "true") {
-				expr->type = EXPR_TYPE_LITERAL_BOOL;
-				expr->boolean = true;
-				return expr;
-			} else if (token.get_value() == "false") {
-				expr->type = EXPR_TYPE_LITERAL_BOOL;
-				expr->boolean = false;
-				return expr;
-			} else {
-				Token ntoken = lexer->explore_next_token();
-				if (ntoken.get_type() == Token::Type::OPEN_PAREN) {
-					lexer->next_token(); // skip OPEN_PAREN
-					expr->type = EXPR_TYPE_FUNC_CALL;
-					expr->func_call = parse_func_call(token);
-					return expr;
-				} else {
-					expr->type = EXPR_TYPE_VAR_READ;
-
-					Var_Read varRead;
-					varRead.stars = 0;
-					varRead.var_name = token.get_value();
-					expr->var_read = varRead;
-					return expr;
-				}
-			}
-		case Token::Type::LITERAL_NUMBER: {
-			expr->type = EXPR_TYPE_LITERAL_NUMBER;
-			expr->number = std::atoi(token.get_value().c_str());
-			return expr;
-		}
-
-		case Token::Type::LITERAL_STRING: {
-			expr->type = EXPR_TYPE_LITERAL_STRING;
-			std::string str = token.get_value();
-			int strsize = str.size();
-			for (int i = 0; i < strsize; i++) {
-				if (str[i] == '\\') {
-					switch (str[i + 1]) {
-						case 'n':
-							str.replace(i, i + 2, "\n");
-							i += 1;
-							break;
-						default: Utils::error("Parsing error: unrecognized escaping sequence"); exit(1);
-					}
-				}
-			}
+Expr_Index Parser::parse_expr_with_precedence(const Token& token, int min_precedence) {
+	Expr_Index lhs = parse_unary_expr(token);
 
-			expr->string = str; 
-			return expr;
+	while (true) {
+		const Binary_Operator& op = binary_operators[lexer->explore_next_token().get_type()];
+		if (op.precedence == 0 || op.precedence < min_precedence) {
+			return lhs;
 		}
+		lexer->next_token();
 
-		case Token::Type::MUL: {
-			expr->type = EXPR_TYPE_VAR_READ;
-			Var_Read varRead;
-
-			lexer->return_index();
-			varRead.stars = count_stars();
-			varRead.var_name = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after '*' symbol on expression").get_value();
-			expr->var_read = varRead;
-			return expr;
-		}
+		Expr expr;
+		expr.type = EXPR_TYPE_OP;
+		expr.op.type = op.type;
+		expr.op.lhs = lhs;
+		// operands of the same precedence on the right are left for this loop
+		expr.op.rhs = parse_expr_with_precedence(lexer->next_token(), op.precedence + 1);
+		lhs = ast.add(expr);
+	}
+}
 
+Expr_Index Parser::parse_unary_expr(const Token& token) {
+	static_assert(UNARY_TYPE_COUNT == 2, "Unhandled UNARY_TYPE_COUNT on parse_unary_expr() at parser.cpp");
+	Expr expr;
+	switch (token.get_type()) {
 		case Token::Type::SUB: {
-			Token n = lexer->expect_next_token(Token::Type::LITERAL_NUMBER, "Parsing error: only numbers are expected after minus simbol");
-			expr->type = EXPR_TYPE_LITERAL_NUMBER;
-			expr->number = atoi(token.get_value().c_str());
-			return expr;
+			const Token& operand = lexer->next_token();
+			if (operand.get_type() == Token::Type::LITERAL_NUMBER) {
+				expr.type = EXPR_TYPE_LITERAL_NUMBER;
+				expr.number = -parse_number(operand.get_value());
+				return ast.add(expr);
+			}
+
+			expr.type = EXPR_TYPE_UNARY;
+			expr.unary = {.type = UNARY_TYPE_NEG, .operand = parse_unary_expr(operand)};
+			return ast.add(expr);
 		}
 
-		default: Utils::error("Unexpected parsing expression: " + token.get_value()); exit(1);
-	}
-}
+		case Token::Type::BIT_NOT:
+			expr.type = EXPR_TYPE_UNARY;
+			expr.unary = {.type = UNARY_TYPE_BIT_NOT, .operand = parse_unary_expr(lexer->next_token())};
+			return ast.add(expr);
 
-std::shared_ptr<Expr> Parser::parse_expr_with_precedence(Token token, OpPrec prec) {
-	if (prec >= OP_PREC_COUNT) {
-		return parse_primary_expr(token);
+		default: return parse_primary_expr(token);
 	}
+}
 
-	std::shared_ptr<Expr> expr = std::make_shared<Expr>();
-	std::shared_ptr<Expr> lhs = parse_expr_with_precedence(token, (OpPrec) (prec + 1));
+static std::string unescape_string(const Token& token) {
+	std::string_view value = token.get_value();
+	std::string str;
+	str.reserve(value.size());
+	for (size_t i = 0; i < value.size(); i++) {
+		if (value[i] != '\\') {
+			str += value[i];
+			continue;
+		}
 
-	token = lexer->explore_next_token();
-	if (is_op(token) && get_prec_by_op_type(get_op_type_by_token_type(token)) == prec) {
-		lexer->next_token();
-		expr->type = EXPR_TYPE_OP;
-		std::shared_ptr<Op> op = std::make_shared<Op>();
-		op->type = get_op_type_by_token_type(token);
-		op->lhs = lhs;
-		op->rhs = parse_expr_with_precedence(lexer->next_token(), prec);
-
-		expr->op = op;
-	} else {
-		expr = lhs;
+		switch (i + 1 < value.size() ? value[++i] : '\0') {
+			case 'n': str += '\n'; break;
+			case 't': str += '\t'; break;
+			case '\\': str += '\\'; break;
+			case '0': str += '\0'; break;
+			default: Utils::error("Parsing error: unrecognized escaping sequence", token.get_loc()); exit(1);
+		}
 	}
 
-	return expr;
+	return str;
 }
 
-OpType Parser::get_op_type_by_token_type(Token token) {
-	static_assert(OP_TYPE_COUNT == 10, "Unhandled OP_TYPE_COUNT on get_op_type_by_token_type at parser.cpp");
+Expr_Index Parser::parse_primary_expr(const Token& token) {
+	static_assert(EXPR_TYPE_COUNTER == 7, "Unhandled EXPR_TYPE_FUNC_COUNT on parse_expr() on file parser.cpp");
+	Expr expr;
 	switch (token.get_type()) {
-		case Token::Type::ADD: return OP_TYPE_ADD;
-		case Token::Type::SUB: return OP_TYPE_SUB;
-		case Token::Type::MUL: return OP_TYPE_MUL;
-		case Token::Type::DIV: return OP_TYPE_DIV;
-		case Token::Type::MOD: return OP_TYPE_MOD;
-		case Token::Type::LOWER_THAN: return OP_TYPE_LT;
-		case Token::Type::GREATER_THAN: return OP_TYPE_GT;
-		case Token::Type::EQUALS_COMPARE: return OP_TYPE_EQ;
-		case Token::Type::BANG_EQUALS: return OP_TYPE_NEQ;
-		case Token::Type::LOWER_THAN_EQUALS: return OP_TYPE_LTE;
-		default: Utils::error("Unknown token type: " + token.get_value()); exit(1);
-	}
-}
+		case Token::Type::NAME: {
+			Symbol name = token.get_symbol();
+			if (name == SYMBOL_TRUE || name == SYMBOL_FALSE) {
+				expr.type = EXPR_TYPE_LITERAL_BOOL;
+				expr.boolean = name == SYMBOL_TRUE;
+			} else if (lexer->explore_next_token().get_type() == Token::Type::OPEN_PAREN) {
+				lexer->next_token(); // skip OPEN_PAREN
+				expr.type = EXPR_TYPE_FUNC_CALL;
+				expr.func_call = parse_func_call(name);
+			} else {
+				expr.type = EXPR_TYPE_VAR_READ;
+				expr.var_read = {.var_name = name, .stars = 0};
+			}
+			return ast.add(expr);
+		}
 
-OpPrec Parser::get_prec_by_op_type(OpType op_type) {
-	static_assert(OP_TYPE_COUNT == 10, "Unhandled OP_TYPE_COUNT on get_prec_by_op_type at parser.cpp");
-	switch (op_type) {
-		case OP_TYPE_LT:
-		case OP_TYPE_GT:
-		case OP_TYPE_EQ:
-		case OP_TYPE_NEQ:
-		case OP_TYPE_LTE:
-			return OP_PREC_0;
-		case OP_TYPE_ADD: 
-		case OP_TYPE_SUB:
-			return OP_PREC_1;
-		case OP_TYPE_MUL: 
-		case OP_TYPE_DIV: 
-		case OP_TYPE_MOD:
-			return OP_PREC_2;
-		default: Utils::error("Unknown operation type"); exit(1);
-	}
-}
+		case Token::Type::LITERAL_NUMBER:
+			expr.type = EXPR_TYPE_LITERAL_NUMBER;
+			expr.number = parse_number(token.get_value());
+			return ast.add(expr);
 
-bool Parser::is_op(Token token) {
-	static_assert(OP_TYPE_COUNT == 10, "Unhandled OP_TYPE_COUNT on get_op_type_by_token_type at parser.cpp");
-	switch (token.get_type()) {
-		case Token::Type::LOWER_THAN:
-		case Token::Type::GREATER_THAN:
-		case Token::Type::EQUALS_COMPARE:
-		case Token::Type::BANG_EQUALS:
-		case Token::Type::LOWER_THAN_EQUALS:
-		case Token::Type::ADD:
-		case Token::Type::SUB:
-		case Token::Type::MUL:
-		case Token::Type::DIV:
-		case Token::Type::MOD:
-			return true;
-
-		default: return false;
+		case Token::Type::LITERAL_STRING:
+			expr.type = EXPR_TYPE_LITERAL_STRING;
+			expr.string = ast.add_string(unescape_string(token));
+			return ast.add(expr);
+
+		case Token::Type::MUL: {
+			expr.type = EXPR_TYPE_VAR_READ;
+			lexer->return_index();
+			uint32_t stars = count_stars();
+			Symbol name = lexer->expect_next_token(Token::Type::NAME, "Parsing error: expected name after '*' symbol on expression").get_symbol();
+			expr.var_read = {.var_name = name, .stars = stars};
+			return ast.add(expr);
+		}
+
+		case Token::Type::OPEN_PAREN: {
+			Expr_Index inner = parse_expr(lexer->next_token());
+			lexer->expect_next_token(Token::Type::CLOSE_PAREN, "Parsing error: expected close paren after expression");
+			return inner;
+		}
+
+		default: Utils::error("Unexpected parsing expression: " + std::string(token.get_value()), token.get_loc()); exit(1);
 	}
 }
@@ -0,0 +1,602 @@
+#include <iostream>
+#include "peephole.hpp"
+
+// Flags take the bit after the registers on the live sets
+#define FLAGS_BIT ((uint32_t) 1 << X86_REGISTER_COUNT)
+// Returned by a rule that didn't fire, otherwise the last position it touched
+#define NOT_APPLIED SIZE_MAX
+// Instructions a scratch register is followed along
+#define MAX_WINDOW 8
+
+const PeepholeOptimizer::Rule PeepholeOptimizer::rules[] = {
+	{"forward_store", &PeepholeOptimizer::forward_store},
+	{"scratch_register", &PeepholeOptimizer::rename_scratch_register},
+	{"self_move", &PeepholeOptimizer::remove_self_move},
+	{"move_back", &PeepholeOptimizer::remove_move_back},
+	{"compare_branch", &PeepholeOptimizer::fuse_compare_branch},
+	{"copy_operand", &PeepholeOptimizer::copy_operand},
+	{"compare_operand", &PeepholeOptimizer::compare_operand},
+	{"dead_write", &PeepholeOptimizer::remove_dead_write},
+	{"jump_to_next", &PeepholeOptimizer::remove_jump_to_next},
+	{"branch_over_jump", &PeepholeOptimizer::invert_branch_over_jump},
+};
+
+PeepholeOptimizer::PeepholeOptimizer(std::vector<X86_Instruction>& code, Peephole_Stats& stats) : code(code), stats(stats) {
+	stats.hits.resize(std::size(rules), 0);
+}
+
+static uint32_t bit(X86Register reg) {
+	return (uint32_t) 1 << reg;
+}
+
+/**
+ * @brief Registers reading operand needs, the address ones for memory
+ */
+static uint32_t operand_reads(const X86_Operand& operand) {
+	if (operand.kind == X86_OPERAND_MEMORY && operand.scale != 0) {
+		return bit(operand.reg) | bit(operand.index);
+	}
+	return operand.kind == X86_OPERAND_REGISTER || operand.kind == X86_OPERAND_MEMORY ? bit(operand.reg) : 0;
+}
+
+/**
+ * @brief Registers writing operand needs, only the address ones for memory
+ */
+static uint32_t address_reads(const X86_Operand& operand) {
+	return operand.kind == X86_OPERAND_MEMORY ? operand_reads(operand) : 0;
+}
+
+static uint32_t written_register(const X86_Operand& operand) {
+	return operand.kind == X86_OPERAND_REGISTER ? bit(operand.reg) : 0;
+}
+
+static bool uses_register(const X86_Operand& operand, X86Register reg) {
+	return (operand_reads(operand) & bit(reg)) != 0;
+}
+
+static bool is_register(const X86_Operand& operand, X86Register reg, uint8_t size = 8) {
+	return operand.kind == X86_OPERAND_REGISTER && operand.reg == reg && operand.size == size;
+}
+
+/**
+ * @brief Whether instruction moves a register or memory into a whole register
+ */
+static bool is_extension(const X86_Instruction& instruction) {
+	bool moves = instruction.opcode == X86_MOV || instruction.opcode == X86_MOVSXD || instruction.opcode == X86_MOVZX;
+	return moves && instruction.a.kind == X86_OPERAND_REGISTER && instruction.a.size == 8;
+}
+
+/**
+ * @brief Registers and flags instruction reads and writes. Writes to part of
+ * a register also read the rest of it.
+ */
+static void effects(const X86_Instruction& instruction, uint32_t& reads, uint32_t& writes) {
+	static_assert(X86_OPCODE_COUNTER == 31, "Unhandled X86_OPCODE_COUNTER on effects at peephole.cpp");
+	const uint32_t arguments = bit(X86_RDI) | bit(X86_RSI) | bit(X86_RDX) | bit(X86_RCX) | bit(X86_R8) | bit(X86_R9);
+	const uint32_t callee_saved = bit(X86_RBX) | bit(X86_RSP) | bit(X86_RBP) | bit(X86_R12) | bit(X86_R13) | bit(X86_R14) | bit(X86_R15);
+	const uint32_t caller_saved = bit(X86_RAX) | arguments | bit(X86_R10) | bit(X86_R11) | FLAGS_BIT;
+	const X86_Operand& a = instruction.a;
+	const X86_Operand& b = instruction.b;
+	reads = 0;
+	writes = 0;
+	switch (instruction.opcode) {
+		case X86_MOV:
+		case X86_MOVSXD:
+		case X86_MOVZX:
+			reads = operand_reads(b) | address_reads(a) | (a.size == 1 ? written_register(a) : 0);
+			writes = written_register(a);
+			break;
+		case X86_LEA:
+			reads = address_reads(b);
+			writes = written_register(a);
+			break;
+		case X86_IMUL:
+			if (b.kind == X86_OPERAND_NONE) {
+				reads = operand_reads(a) | bit(X86_RAX);
+				writes = bit(X86_RAX) | bit(X86_RDX) | FLAGS_BIT;
+				break;
+			}
+			[[fallthrough]];
+		case X86_ADD:
+		case X86_SUB:
+		case X86_AND:
+		case X86_OR:
+		case X86_XOR:
+			reads = operand_reads(a) | operand_reads(b);
+			writes = written_register(a) | FLAGS_BIT;
+			break;
+		case X86_NEG:
+			reads = operand_reads(a);
+			writes = written_register(a) | FLAGS_BIT;
+			break;
+		case X86_NOT:
+			reads = operand_reads(a);
+			writes = written_register(a);
+			break;
+		case X86_SHL:
+		case X86_SAR:
+		case X86_SHR:
+			reads = operand_reads(a) | (b.kind == X86_OPERAND_NONE ? bit(X86_RCX) : 0);
+			writes = written_register(a) | FLAGS_BIT;
+			break;
+		case X86_CQO:
+			reads = bit(X86_RAX);
+			writes = bit(X86_RDX);
+			break;
+		case X86_IDIV:
+			reads = operand_reads(a) | bit(X86_RAX) | bit(X86_RDX);
+			writes = bit(X86_RAX) | bit(X86_RDX) | FLAGS_BIT;
+			break;
+		case X86_CMP:
+		case X86_TEST:
+			reads = operand_reads(a) | operand_reads(b);
+			writes = FLAGS_BIT;
+			break;
+		case X86_SETCC:
+			reads = operand_reads(a) | FLAGS_BIT;
+			writes = written_register(a);
+			break;
+		case X86_JCC:
+			reads = FLAGS_BIT;
+			break;
+		case X86_JMP:
+			// a tail call leaves the arguments and the registers of the caller
+			reads = a.kind == X86_OPERAND_FUNCTION ? arguments | callee_saved : 0;
+			break;
+		case X86_CALL:
+			reads = arguments | bit(X86_RSP);
+			writes = caller_saved;
+			break;
+		case X86_RET:
+			reads = bit(X86_RAX) | callee_saved;
+			break;
+		case X86_PUSH:
+			reads = operand_reads(a) | bit(X86_RSP);
+			writes = bit(X86_RSP);
+			break;
+		case X86_POP:
+			reads = address_reads(a) | bit(X86_RSP);
+			writes = written_register(a) | bit(X86_RSP);
+			break;
+		case X86_CDQE:
+			reads = bit(X86_RAX);
+			writes = bit(X86_RAX);
+			break;
+		case X86_SYSCALL:
+			reads = bit(X86_RAX) | bit(X86_RDI) | bit(X86_RSI) | bit(X86_RDX) | bit(X86_R10) | bit(X86_R8) | bit(X86_R9);
+			writes = bit(X86_RAX) | bit(X86_RCX) | bit(X86_R11);
+			break;
+		case X86_LEAVE:
+			reads = bit(X86_RBP);
+			writes = bit(X86_RSP) | bit(X86_RBP);
+			break;
+		default:
+			break;
+	}
+}
+
+void PeepholeOptimizer::find_live_registers() {
+	size_t size = code.size();
+	// position of every label, the return label is -1
+	std::vector<size_t> labels;
+	for (size_t i = 0; i < size; i++) {
+		if (code[i].opcode == X86_LABEL) {
+			size_t label = code[i].a.imm + 1;
+			if (label >= labels.size()) {
+				labels.resize(label + 1, SIZE_MAX);
+			}
+			labels[label] = i;
+		}
+	}
+
+	std::vector<uint32_t> live_before(size, 0);
+	live_after.assign(size, 0);
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t i = size; i-- > 0;) {
+			const X86_Instruction& instruction = code[i];
+			uint32_t out = 0;
+			if (instruction.opcode != X86_JMP && instruction.opcode != X86_RET && i + 1 < size) {
+				out |= live_before[i + 1];
+			}
+			if ((instruction.opcode == X86_JMP || instruction.opcode == X86_JCC) && instruction.a.kind == X86_OPERAND_LABEL) {
+				out |= live_before[labels[instruction.a.imm + 1]];
+			}
+
+			uint32_t reads, writes;
+			effects(instruction, reads, writes);
+			uint32_t in = reads | (out & ~writes);
+			changed = changed || in != live_before[i] || out != live_after[i];
+			live_before[i] = in;
+			live_after[i] = out;
+		}
+	}
+}
+
+void PeepholeOptimizer::optimize() {
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		find_live_registers();
+		removed.assign(code.size(), false);
+
+		// a rewritten window isn't looked at again until the next round, the
+		// registers live inside it changed
+		for (size_t position = 0; position < code.size(); position++) {
+			if (removed[position]) {
+				continue;
+			}
+			for (size_t rule = 0; rule < std::size(rules); rule++) {
+				size_t last = (this->*rules[rule].apply)(position);
+				if (last != NOT_APPLIED) {
+					stats.hits[rule]++;
+					changed = true;
+					position = last;
+					break;
+				}
+			}
+		}
+
+		size_t kept = 0;
+		for (size_t i = 0; i < code.size(); i++) {
+			if (!removed[i]) {
+				code[kept++] = code[i];
+			}
+		}
+		code.resize(kept);
+	}
+}
+
+size_t PeepholeOptimizer::next(size_t position) {
+	position++;
+	while (position < code.size() && removed[position]) {
+		position++;
+	}
+	return position;
+}
+
+bool PeepholeOptimizer::is_dead(uint32_t registers, size_t position) {
+	return (live_after[position] & registers) == 0;
+}
+
+// forward_store: mov [m], reg / mov reg2, [m] reads reg instead
+size_t PeepholeOptimizer::forward_store(size_t position) {
+	const X86_Instruction& store = code[position];
+	size_t load = next(position);
+	if (store.opcode != X86_MOV || store.a.kind != X86_OPERAND_MEMORY || store.b.kind != X86_OPERAND_REGISTER
+		|| load >= code.size() || !x86_same_operand(code[load].b, store.a)) {
+		return NOT_APPLIED;
+	}
+
+	// the load extends the value the way the store width needs
+	X86Opcode extension = store.a.size == 8 ? X86_MOV : store.a.size == 4 ? X86_MOVSXD : X86_MOVZX;
+	if (code[load].opcode != extension || code[load].a.kind != X86_OPERAND_REGISTER) {
+		return NOT_APPLIED;
+	}
+	code[load].b = store.b;
+	return load;
+}
+
+// scratch_register: mov tmp, x / op tmp, y / mov reg, tmp computes on reg directly
+size_t PeepholeOptimizer::rename_scratch_register(size_t position) {
+	const X86_Instruction& first = code[position];
+	bool loads = first.opcode == X86_MOV || first.opcode == X86_MOVSXD || first.opcode == X86_MOVZX || first.opcode == X86_LEA;
+	// rcx is read by the shifts without naming it
+	X86Register scratch = first.a.reg;
+	if (!loads || first.a.kind != X86_OPERAND_REGISTER || first.a.size != 8
+		|| scratch == X86_RCX || scratch == X86_RSP || scratch == X86_RBP) {
+		return NOT_APPLIED;
+	}
+
+	std::vector<size_t> window;
+	size_t current = next(position);
+	for (size_t steps = 0; steps < MAX_WINDOW && current < code.size(); steps++, current = next(current)) {
+		const X86_Instruction& instruction = code[current];
+		if (is_extension(instruction) && instruction.b.kind == X86_OPERAND_REGISTER && instruction.b.reg == scratch
+			&& instruction.a.reg != scratch) {
+			break;
+		}
+
+		switch (instruction.opcode) {
+			case X86_MOV:
+			case X86_MOVSXD:
+			case X86_MOVZX:
+			case X86_ADD:
+			case X86_SUB:
+			case X86_IMUL:
+			case X86_AND:
+			case X86_OR:
+			case X86_XOR:
+			case X86_NEG:
+			case X86_NOT:
+			case X86_SHL:
+			case X86_SAR:
+			case X86_SHR:
+			case X86_CMP:
+			case X86_TEST:
+			case X86_SETCC:
+				break;
+			default:
+				return NOT_APPLIED;
+		}
+		// the scratch register as an address stays, it would need the renamed value as a pointer
+		if ((instruction.a.kind == X86_OPERAND_MEMORY && uses_register(instruction.a, scratch))
+			|| (instruction.b.kind == X86_OPERAND_MEMORY && uses_register(instruction.b, scratch))) {
+			return NOT_APPLIED;
+		}
+		// the widening multiply reads and writes rax and rdx on its own
+		if (instruction.opcode == X86_IMUL && instruction.b.kind == X86_OPERAND_NONE) {
+			return NOT_APPLIED;
+		}
+		window.push_back(current);
+	}
+	if (current >= code.size() || !is_extension(code[current]) || code[current].b.kind != X86_OPERAND_REGISTER
+		|| code[current].b.reg != scratch) {
+		return NOT_APPLIED;
+	}
+
+	X86Register target = code[current].a.reg;
+	if (target == X86_RCX || target == X86_RSP || target == X86_RBP || !is_dead(bit(scratch), current)) {
+		return NOT_APPLIED;
+	}
+	for (size_t i: window) {
+		if (uses_register(code[i].a, target) || uses_register(code[i].b, target)) {
+			return NOT_APPLIED;
+		}
+	}
+
+	code[position].a.reg = target;
+	for (size_t i: window) {
+		for (X86_Operand* operand: {&code[i].a, &code[i].b}) {
+			if (operand->kind == X86_OPERAND_REGISTER && operand->reg == scratch) {
+				operand->reg = target;
+			}
+		}
+	}
+	// a narrower final move still extends the value, now from the target itself
+	if (code[current].opcode == X86_MOV && code[current].b.size == 8) {
+		removed[current] = true;
+	} else {
+		code[current].b.reg = target;
+	}
+	return current;
+}
+
+// self_move: mov reg, reg
+size_t PeepholeOptimizer::remove_self_move(size_t position) {
+	const X86_Instruction& instruction = code[position];
+	if (instruction.opcode != X86_MOV || instruction.a.kind != X86_OPERAND_REGISTER || instruction.a.size != 8
+		|| !x86_same_operand(instruction.a, instruction.b)) {
+		return NOT_APPLIED;
+	}
+	removed[position] = true;
+	return position;
+}
+
+// move_back: mov a, b / ... / mov b, a while neither a nor b changed
+size_t PeepholeOptimizer::remove_move_back(size_t position) {
+	const X86_Instruction& first = code[position];
+	if (first.opcode != X86_MOV) {
+		return NOT_APPLIED;
+	}
+
+	// one side is a whole register, not the base of the other side
+	const X86_Operand& reg = first.a.kind == X86_OPERAND_REGISTER ? first.a : first.b;
+	const X86_Operand& other = first.a.kind == X86_OPERAND_REGISTER ? first.b : first.a;
+	if (reg.kind != X86_OPERAND_REGISTER || reg.size != 8 || other.size != 8
+		|| (other.kind == X86_OPERAND_MEMORY && uses_register(other, reg.reg))) {
+		return NOT_APPLIED;
+	}
+
+	// registers can be copied back further down, memory may be stored through a pointer
+	size_t window = other.kind == X86_OPERAND_REGISTER ? MAX_WINDOW : 1;
+	uint32_t copied = bit(reg.reg) | written_register(other);
+	size_t current = next(position);
+	for (size_t steps = 0; steps < window && current < code.size(); steps++, current = next(current)) {
+		const X86_Instruction& instruction = code[current];
+		if (instruction.opcode == X86_MOV && x86_same_operand(first.a, instruction.b) && x86_same_operand(first.b, instruction.a)) {
+			removed[current] = true;
+			return current;
+		}
+
+		uint32_t reads, writes;
+		effects(instruction, reads, writes);
+		bool straight = instruction.opcode != X86_LABEL && instruction.opcode != X86_JMP && instruction.opcode != X86_JCC
+			&& instruction.opcode != X86_CALL && instruction.opcode != X86_RET;
+		if (!straight || (writes & copied) != 0) {
+			return NOT_APPLIED;
+		}
+	}
+	return NOT_APPLIED;
+}
+
+// compare_branch: setcc r8 / movzx reg, r8 / test reg, reg / je jumps on the comparison itself
+size_t PeepholeOptimizer::fuse_compare_branch(size_t position) {
+	const X86_Instruction& set = code[position];
+	if (set.opcode != X86_SETCC || set.a.kind != X86_OPERAND_REGISTER) {
+		return NOT_APPLIED;
+	}
+	size_t extend = next(position);
+	size_t test = next(extend);
+	size_t jump = next(test);
+	if (jump >= code.size() || code[extend].opcode != X86_MOVZX || code[extend].a.kind != X86_OPERAND_REGISTER
+		|| !x86_same_operand(code[extend].b, set.a)) {
+		return NOT_APPLIED;
+	}
+	X86Register reg = code[extend].a.reg;
+	if (code[test].opcode != X86_TEST || !is_register(code[test].a, reg) || !is_register(code[test].b, reg)
+		|| code[jump].opcode != X86_JCC || !is_dead(bit(reg) | bit(set.a.reg), jump)) {
+		return NOT_APPLIED;
+	}
+	if (code[jump].condition != X86_CC_E && code[jump].condition != X86_CC_NE) {
+		return NOT_APPLIED;
+	}
+
+	code[jump].condition = code[jump].condition == X86_CC_NE ? set.condition : x86_negate(set.condition);
+	removed[position] = true;
+	removed[extend] = true;
+	removed[test] = true;
+	return jump;
+}
+
+// copy_operand: mov reg, reg2 / op ..., reg reads reg2 when reg is dead
+size_t PeepholeOptimizer::copy_operand(size_t position) {
+	const X86_Instruction& move = code[position];
+	size_t user = next(position);
+	if (move.opcode != X86_MOV || move.a.kind != X86_OPERAND_REGISTER || move.a.size != 8 || move.b.kind != X86_OPERAND_REGISTER
+		|| move.b.size != 8 || user >= code.size()) {
+		return NOT_APPLIED;
+	}
+
+	// only instructions reading nothing but their operands
+	X86_Instruction& instruction = code[user];
+	switch (instruction.opcode) {
+		case X86_MOV:
+		case X86_MOVSXD:
+		case X86_MOVZX:
+		case X86_LEA:
+		case X86_ADD:
+		case X86_SUB:
+		case X86_IMUL:
+		case X86_AND:
+		case X86_OR:
+		case X86_XOR:
+		case X86_CMP:
+		case X86_TEST:
+			break;
+		default:
+			return NOT_APPLIED;
+	}
+	X86Register copy = move.a.reg;
+	uint32_t reads, writes;
+	effects(instruction, reads, writes);
+	bool implicit = instruction.opcode == X86_IMUL && instruction.b.kind == X86_OPERAND_NONE;
+	if (implicit || (reads & bit(copy)) == 0 || (writes & bit(copy)) != 0 || !is_dead(bit(copy), user)) {
+		return NOT_APPLIED;
+	}
+
+	for (X86_Operand* operand: {&instruction.a, &instruction.b}) {
+		if (uses_register(*operand, copy)) {
+			operand->reg = move.b.reg;
+		}
+	}
+	removed[position] = true;
+	return user;
+}
+
+// compare_operand: mov reg, x / cmp reg, y compares x when reg is dead
+size_t PeepholeOptimizer::compare_operand(size_t position) {
+	const X86_Instruction& move = code[position];
+	size_t compare = next(position);
+	if (move.opcode != X86_MOV || move.a.kind != X86_OPERAND_REGISTER || move.a.size != 8 || compare >= code.size()
+		|| (code[compare].opcode != X86_CMP && code[compare].opcode != X86_TEST) || !is_register(code[compare].a, move.a.reg)
+		|| !is_dead(bit(move.a.reg), compare)) {
+		return NOT_APPLIED;
+	}
+
+	X86_Instruction& instruction = code[compare];
+	if (instruction.opcode == X86_TEST) {
+		// test reg, reg with the other register
+		if (move.b.kind != X86_OPERAND_REGISTER || !x86_same_operand(instruction.a, instruction.b)) {
+			return NOT_APPLIED;
+		}
+		instruction.b = move.b;
+	} else {
+		// cmp takes a register or memory on the left, never both sides on memory
+		bool valid = move.b.kind == X86_OPERAND_REGISTER
+			|| (move.b.kind == X86_OPERAND_MEMORY && instruction.b.kind != X86_OPERAND_MEMORY);
+		if (!valid || uses_register(instruction.b, move.a.reg)) {
+			return NOT_APPLIED;
+		}
+	}
+	instruction.a = move.b;
+	removed[position] = true;
+	return compare;
+}
+
+// dead_write: instructions writing registers and flags nothing reads
+size_t PeepholeOptimizer::remove_dead_write(size_t position) {
+	const X86_Instruction& instruction = code[position];
+	switch (instruction.opcode) {
+		case X86_MOV:
+		case X86_MOVSXD:
+		case X86_MOVZX:
+		case X86_LEA:
+		case X86_ADD:
+		case X86_SUB:
+		case X86_IMUL:
+		case X86_AND:
+		case X86_OR:
+		case X86_XOR:
+		case X86_NEG:
+		case X86_NOT:
+		case X86_SHL:
+		case X86_SAR:
+		case X86_SHR:
+		case X86_CQO:
+		case X86_CMP:
+		case X86_TEST:
+		case X86_SETCC:
+			break;
+		default:
+			return NOT_APPLIED;
+	}
+
+	// stores stay, and so do loads outside the frame that may fault
+	bool compares = instruction.opcode == X86_CMP || instruction.opcode == X86_TEST;
+	auto in_frame = [](const X86_Operand& operand) {
+		return operand.kind != X86_OPERAND_MEMORY || (operand.reg == X86_RBP && operand.scale == 0);
+	};
+	if ((instruction.a.kind == X86_OPERAND_MEMORY && !compares) || !in_frame(instruction.a)
+		|| (!in_frame(instruction.b) && instruction.opcode != X86_LEA)) {
+		return NOT_APPLIED;
+	}
+
+	uint32_t reads, writes;
+	effects(instruction, reads, writes);
+	if (writes == 0 || (writes & (bit(X86_RSP) | bit(X86_RBP))) != 0 || !is_dead(writes, position)) {
+		return NOT_APPLIED;
+	}
+	removed[position] = true;
+	return position;
+}
+
+// jump_to_next: jmp .L / .L:
+size_t PeepholeOptimizer::remove_jump_to_next(size_t position) {
+	const X86_Instruction& jump = code[position];
+	if (jump.opcode != X86_JMP || jump.a.kind != X86_OPERAND_LABEL) {
+		return NOT_APPLIED;
+	}
+	for (size_t label = next(position); label < code.size() && code[label].opcode == X86_LABEL; label = next(label)) {
+		if (code[label].a.imm == jump.a.imm) {
+			removed[position] = true;
+			return position;
+		}
+	}
+	return NOT_APPLIED;
+}
+
+// branch_over_jump: jcc .A / jmp .B / .A: becomes jncc .B / .A:
+size_t PeepholeOptimizer::invert_branch_over_jump(size_t position) {
+	X86_Instruction& branch = code[position];
+	size_t jump = next(position);
+	size_t label = next(jump);
+	if (branch.opcode != X86_JCC || label >= code.size() || code[jump].opcode != X86_JMP || code[jump].a.kind != X86_OPERAND_LABEL
+		|| code[label].opcode != X86_LABEL || code[label].a.imm != branch.a.imm) {
+		return NOT_APPLIED;
+	}
+
+	branch.condition = x86_negate(branch.condition);
+	branch.a = code[jump].a;
+	removed[jump] = true;
+	return jump;
+}
+
+void PeepholeOptimizer::print_stats(const Peephole_Stats& stats) {
+	std::cerr << "peephole:";
+	for (size_t rule = 0; rule < std::size(rules); rule++) {
+		std::cerr << (rule == 0 ? " " : ", ") << (rule < stats.hits.size() ? stats.hits[rule] : 0) << " " << rules[rule].name;
+	}
+	std::cerr << std::endl;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "x86.hpp"
+
+// Times every rule of the peephole table fired, indexed like the table
+typedef struct {
+	std::vector<size_t> hits;
+} Peephole_Stats;
+
+/**
+ * @brief Rewrites the instructions selected for a function, one rule of a
+ * table at a time over short windows of them. The registers and flags live
+ * after every instruction are solved over the jumps between labels first,
+ * so rules can drop writes nothing reads. Runs until no rule fires.
+ */
+class PeepholeOptimizer {
+private:
+	std::vector<X86_Instruction>& code;
+	Peephole_Stats& stats;
+	// registers and flags read after every instruction before being written
+	std::vector<uint32_t> live_after;
+	// instructions dropped on this round
+	std::vector<bool> removed;
+
+	void find_live_registers();
+	size_t next(size_t position);
+	bool is_dead(uint32_t registers, size_t position);
+
+	size_t remove_self_move(size_t position);
+	size_t remove_move_back(size_t position);
+	size_t rename_scratch_register(size_t position);
+	size_t fuse_compare_branch(size_t position);
+	size_t copy_operand(size_t position);
+	size_t compare_operand(size_t position);
+	size_t remove_dead_write(size_t position);
+	size_t forward_store(size_t position);
+	size_t remove_jump_to_next(size_t position);
+	size_t invert_branch_over_jump(size_t position);
+
+	// rules return the last position they rewrote, SIZE_MAX when they didn't fire
+	typedef struct {
+		const char* name;
+		size_t (PeepholeOptimizer::*apply)(size_t position);
+	} Rule;
+	static const Rule rules[];
+
+public:
+	PeepholeOptimizer(std::vector<X86_Instruction>& code, Peephole_Stats& stats);
+
+	/**
+	 * @brief Apply the rules until none fires anymore
+	 */
+	void optimize();
+
+	/**
+	 * @brief Print the hits of every rule on one line, used by --stats
+	 */
+	static void print_stats(const Peephole_Stats& stats);
+};
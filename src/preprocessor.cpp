@@ -1,38 +1,207 @@
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
-#include <sstream>
+#include <sys/stat.h>
 #include "preprocessor.hpp"
 #include "utils.hpp"
 #include "lexer.hpp"
 #include "token.hpp"
+#include "token_cache.hpp"
 
-void Preprocessor::preprocess_includes(const std::string& filename, std::vector<std::string>& global_filenames, std::vector<Token>& tokens) {
-	std::stringstream fstring;
+Include_Set::File_Key Include_Set::key(const std::string& filename) {
+	struct stat st;
+	if (stat(filename.c_str(), &st) < 0) {
+		Utils::error("File doesn't exists: " + filename);
+	}
+
+	return {.device = st.st_dev, .inode = st.st_ino};
+}
+
+bool Include_Set::insert(const std::string& filename) {
+	return files.insert(key(filename)).second;
+}
+
+Preprocessor::Preprocessor(const std::string& filename) {
+	included.insert(filename);
+	push_file(filename);
+}
+
+void Preprocessor::push_file(const std::string& filename) {
+	include_stack.push_back({.lexer = std::make_unique<Lexer>(filename, Lexer::Mode::STREAMING), .tokens = {}, .next = 0, .in_header = true});
+}
+
+void Preprocessor::push_include(const std::string& filename) {
+	include_stack.push_back({.lexer = nullptr, .tokens = TokenCache::tokenize(filename), .next = 0, .in_header = true});
+}
+
+bool Preprocessor::frame_token(Include_Frame& frame, Token& token) {
+	if (frame.lexer) {
+		return frame.lexer->scan_token(token);
+	}
+	if (frame.next == frame.tokens.size()) {
+		return false;
+	}
+
+	token = frame.tokens[frame.next++];
+	return true;
+}
+
+Token Preprocessor::expect_token(Include_Frame& frame, Token::Type token_type, const char* error_msg) {
+	Token token;
+	if (!frame_token(frame, token)) {
+		Utils::error(error_msg);
+	}
+	if (token.get_type() != token_type) {
+		Utils::error(error_msg, token.get_loc());
+	}
 
-	Lexer lex(filename);
-	std::vector<Token> toks = lex.get_tokens();
-	while (lex.next_token().get_type() == Token::Type::INCLUDE_DIRECTIVE) {
-		std::string name = lex.expect_next_token(Token::Type::LITERAL_STRING, "Preprocessing error: expected string after include").get_value();
-		lex.expect_next_token(Token::Type::SEMICOLON, "Preprocessing error: expected semicolon after include directive");
+	return token;
+}
+
+bool Preprocessor::next_token(Token& token) {
+	while (!include_stack.empty()) {
+		Include_Frame& frame = include_stack.back();
+		if (!frame_token(frame, token)) {
+			include_stack.pop_back();
+			continue;
+		}
 
-		toks.erase(toks.begin());
-		toks.erase(toks.begin());
-		toks.erase(toks.begin());
+		if (frame.in_header && token.get_type() == Token::Type::INCLUDE_DIRECTIVE) {
+			std::string name(expect_token(frame, Token::Type::LITERAL_STRING, "Preprocessing error: expected string after include").get_value());
+			expect_token(frame, Token::Type::SEMICOLON, "Preprocessing error: expected semicolon after include directive");
 
-		bool skip = false;
-		for (auto n: global_filenames) {
-			if (n == name) {
-				skip = true;
-				break;
+			if (included.insert(name)) {
+				push_include(name);
 			}
+			continue;
 		}
 
-		if (!skip) {
-			global_filenames.push_back(name);
-			preprocess_includes(name, global_filenames, tokens);
+		frame.in_header = false;
+		return true;
+	}
+
+	return false;
+}
+
+void Preprocessor::preprocess_includes(const std::string& filename, std::vector<Token>& tokens) {
+	Include_Set included;
+	included.insert(filename);
+	preprocess_file(filename, true, included, tokens);
+}
+
+size_t Preprocessor::parse_includes(const std::vector<Token>& toks, std::vector<std::string>& includes) {
+	size_t i = 0;
+	while (i < toks.size() && toks[i].get_type() == Token::Type::INCLUDE_DIRECTIVE) {
+		if (i + 1 >= toks.size() || toks[i + 1].get_type() != Token::Type::LITERAL_STRING) {
+			Utils::error("Preprocessing error: expected string after include", toks[i].get_loc());
+		}
+		if (i + 2 >= toks.size() || toks[i + 2].get_type() != Token::Type::SEMICOLON) {
+			Utils::error("Preprocessing error: expected semicolon after include directive", toks[i + 1].get_loc());
 		}
+
+		includes.push_back(std::string(toks[i + 1].get_value()));
+		i += 3;
+	}
+
+	return i;
+}
+
+void Preprocessor::preprocess_file(const std::string& filename, bool root, Include_Set& included, std::vector<Token>& tokens) {
+	std::vector<Token> toks = root ? Lexer(filename).take_tokens() : TokenCache::tokenize(filename);
+
+	// include directives are consumed by index, the rest of the file is
+	// spliced once into the program tokens
+	std::vector<std::string> includes;
+	size_t body = parse_includes(toks, includes);
+	for (const std::string& name: includes) {
+		if (included.insert(name)) {
+			preprocess_file(name, false, included, tokens);
+		}
+	}
+
+	tokens.insert(tokens.end(), toks.begin() + body, toks.end());
+}
+
+typedef struct {
+	std::vector<Token> tokens;
+	// first token after the include directives
+	size_t body;
+	std::vector<Include_Set::File_Key> includes;
+	// first error lexing the file or finding its includes, empty if none
+	std::string error;
+} Lexed_File;
+
+typedef std::unordered_map<Include_Set::File_Key, std::unique_ptr<Lexed_File>, Include_Set::File_Key_Hash> Lexed_Files;
+
+static void splice_file(Lexed_Files& files, const Include_Set::File_Key& key, std::unordered_set<Include_Set::File_Key, Include_Set::File_Key_Hash>& spliced, std::vector<Token>& tokens) {
+	Lexed_File& file = *files[key];
+	for (const Include_Set::File_Key& include: file.includes) {
+		if (spliced.insert(include).second) {
+			splice_file(files, include, spliced, tokens);
+		}
+	}
+
+	tokens.insert(tokens.end(), file.tokens.begin() + file.body, file.tokens.end());
+}
+
+/**
+ * @brief First error over the graph in the order the sequential preprocessor
+ * meets them: the includes found before a file failed, then the file itself
+ */
+static std::string first_error(Lexed_Files& files, const Include_Set::File_Key& key, std::unordered_set<Include_Set::File_Key, Include_Set::File_Key_Hash>& visited) {
+	Lexed_File& file = *files[key];
+	for (const Include_Set::File_Key& include: file.includes) {
+		if (visited.insert(include).second) {
+			std::string error = first_error(files, include, visited);
+			if (!error.empty()) {
+				return error;
+			}
+		}
+	}
+
+	return file.error;
+}
+
+void Preprocessor::preprocess_includes(const std::string& filename, std::vector<Token>& tokens, ThreadPool& pool) {
+	// every file of the graph is lexed once, whoever finds it first submits it
+	Lexed_Files files;
+	std::mutex files_mutex;
+
+	// errors stay on the file, the earliest is reported once the pool is idle
+	std::function<void(std::string, bool, Lexed_File*)> lex_file = [&](std::string name, bool root, Lexed_File* file) {
+		file->error = Utils::capture_errors([&] {
+			file->tokens = root ? Lexer(name).take_tokens() : TokenCache::tokenize(name);
+
+			std::vector<std::string> includes;
+			file->body = parse_includes(file->tokens, includes);
+			for (const std::string& include: includes) {
+				Include_Set::File_Key key = Include_Set::key(include);
+				file->includes.push_back(key);
+
+				std::lock_guard<std::mutex> lock(files_mutex);
+				std::unique_ptr<Lexed_File>& found = files[key];
+				if (!found) {
+					found = std::make_unique<Lexed_File>();
+					pool.submit([&lex_file, include, found = found.get()] { lex_file(include, false, found); });
+				}
+			}
+		});
+	};
+
+	Include_Set::File_Key root = Include_Set::key(filename);
+	files[root] = std::make_unique<Lexed_File>();
+	Lexed_File* root_file = files[root].get();
+	pool.submit([&lex_file, filename, root_file] { lex_file(filename, true, root_file); });
+	pool.wait();
+
+	std::unordered_set<Include_Set::File_Key, Include_Set::File_Key_Hash> visited = {root};
+	std::string error = first_error(files, root, visited);
+	if (!error.empty()) {
+		Utils::report_error(error);
 	}
 
-	tokens.reserve(tokens.size() + toks.size());
-	tokens.insert(tokens.end(), toks.begin(), toks.end());
+	// same depth first order as the sequential preprocessor
+	std::unordered_set<Include_Set::File_Key, Include_Set::File_Key_Hash> spliced = {root};
+	splice_file(files, root, spliced, tokens);
 }
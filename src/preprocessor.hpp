@@ -1,8 +1,99 @@
 #pragma once
+#include <memory>
 #include <string>
+#include <unordered_set>
 #include "lexer.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * @brief Files already included, keyed by device and inode so different
+ * spellings of the same path ("std/string.aka", "./std/string.aka") and
+ * links are only included once
+ */
+class Include_Set {
+public:
+	typedef struct File_Key {
+		uint64_t device;
+		uint64_t inode;
+
+		bool operator==(const File_Key& other) const {
+			return device == other.device && inode == other.inode;
+		}
+	} File_Key;
+
+	struct File_Key_Hash {
+		size_t operator()(const File_Key& key) const {
+			return std::hash<uint64_t>()(key.inode * 0x9E3779B97F4A7C15ull ^ key.device);
+		}
+	};
+
+	/**
+	 * @brief Identity of filename, errors if it doesn't exist
+	 */
+	static File_Key key(const std::string& filename);
+
+private:
+	std::unordered_set<File_Key, File_Key_Hash> files;
+
+public:
+	/**
+	 * @brief Register filename as included
+	 *
+	 * @return true the first time the file is seen
+	 */
+	bool insert(const std::string& filename);
+};
 
 class Preprocessor {
+private:
+	typedef struct {
+		// the root file is scanned by lexer, included files come from the
+		// token cache already tokenized
+		std::unique_ptr<Lexer> lexer;
+		std::vector<Token> tokens;
+		size_t next;
+		// include directives are only allowed before any other token
+		bool in_header;
+	} Include_Frame;
+
+	// files being scanned, the innermost include on top
+	std::vector<Include_Frame> include_stack;
+	Include_Set included;
+
+	void push_file(const std::string& filename);
+	void push_include(const std::string& filename);
+	bool frame_token(Include_Frame& frame, Token& token);
+	Token expect_token(Include_Frame& frame, Token::Type token_type, const char* error_msg);
+	static void preprocess_file(const std::string& filename, bool root, Include_Set& included, std::vector<Token>& tokens);
+	static size_t parse_includes(const std::vector<Token>& tokens, std::vector<std::string>& includes);
+
 public:
-	static void preprocess_includes(const std::string& filename, std::vector<std::string>& filenames, std::vector<Token>& tokens);
-};
\ No newline at end of file
+	/**
+	 * @brief Streaming preprocessor over filename, includes are expanded
+	 * while the tokens are pulled through next_token
+	 */
+	Preprocessor(const std::string& filename);
+
+	/**
+	 * @brief Next token of the program with its includes expanded in place
+	 *
+	 * @param token
+	 * @return false once every file has been consumed
+	 */
+	bool next_token(Token& token);
+
+	/**
+	 * @brief Tokens of the whole program, every file is included once at the
+	 * point of its first include directive (depth first order)
+	 *
+	 * @param filename
+	 * @param tokens output, the program tokens are appended
+	 */
+	static void preprocess_includes(const std::string& filename, std::vector<Token>& tokens);
+
+	/**
+	 * @brief Same tokens as preprocess_includes, the files of the include
+	 * graph are lexed in parallel on pool and spliced once all of them are done
+	 */
+	static void preprocess_includes(const std::string& filename, std::vector<Token>& tokens, ThreadPool& pool);
+};
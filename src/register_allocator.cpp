@@ -0,0 +1,202 @@
+#include <algorithm>
+#include "register_allocator.hpp"
+
+// uses inside loops weigh this many times more per nesting level
+#define LOOP_WEIGHT 8
+#define MAX_WEIGHTED_DEPTH 6
+
+RegisterAllocator::RegisterAllocator(const Ir_Function& function) : function(function) {}
+
+Register_Allocation RegisterAllocator::allocate() {
+	Register_Allocation allocation = {};
+	build_intervals();
+	linear_scan(allocation);
+
+	for (const Live_Interval& interval: intervals) {
+		allocation.registers.push_back(interval.reg);
+		allocation.spilled += interval.reg == REG_SPILLED && interval.start != UINT32_MAX;
+	}
+
+	return allocation;
+}
+
+/**
+ * @brief Call f with the id of every allocated value instruction reads, then
+ * with the ones it writes and true
+ */
+template <typename F>
+static void for_each_access(const Ir_Function& function, const std::vector<bool>& rematerialized, const Ir_Instruction& instruction, F f) {
+	for_each_use(function, instruction, [&](Value value) {
+		if (!rematerialized[value]) {
+			f(value, false);
+		}
+	});
+
+	if (instruction.opcode == IR_OP_LOAD_LOCAL) {
+		f(function.values + instruction.imm, false);
+	} else if (instruction.opcode == IR_OP_STORE_LOCAL) {
+		f(function.values + instruction.imm, true);
+	}
+
+	if (instruction.dst != VALUE_NONE && !rematerialized[instruction.dst]) {
+		f(instruction.dst, true);
+	}
+}
+
+void RegisterAllocator::build_intervals() {
+	size_t ids = function.values + function.locals.size();
+	size_t words = (ids + 63) / 64;
+	size_t blocks = function.blocks.size();
+
+	rematerialized.assign(function.values, false);
+	for (const Ir_Block& block: function.blocks) {
+		for (const Ir_Instruction& instruction: block.instructions) {
+			if (instruction.opcode == IR_OP_CONST || instruction.opcode == IR_OP_STRING) {
+				rematerialized[instruction.dst] = true;
+			}
+		}
+	}
+
+	// values read before being written on each block, and written on it
+	std::vector<Bitset> uses(blocks, Bitset(words)), defs(blocks, Bitset(words));
+	for (size_t block = 0; block < blocks; block++) {
+		for (const Ir_Instruction& instruction: function.blocks[block].instructions) {
+			for_each_access(function, rematerialized, instruction, [&](uint32_t id, bool write) {
+				if (write) {
+					set_bit(defs[block], id);
+				} else if (!test_bit(defs[block], id)) {
+					set_bit(uses[block], id);
+				}
+			});
+		}
+	}
+
+	// live_in = uses + (live_out - defs), iterated backwards until stable
+	std::vector<Bitset> live_in(blocks, Bitset(words)), live_out(blocks, Bitset(words));
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t block = blocks; block-- > 0;) {
+			Bitset out(words);
+			for_each_successor(function.blocks[block].instructions.back(), [&](Block_Index successor) {
+				for (size_t word = 0; word < words; word++) {
+					out[word] |= live_in[successor][word];
+				}
+			});
+
+			for (size_t word = 0; word < words; word++) {
+				uint64_t in = uses[block][word] | (out[word] & ~defs[block][word]);
+				changed = changed || in != live_in[block][word];
+				live_in[block][word] = in;
+			}
+			live_out[block] = std::move(out);
+		}
+	}
+
+	// each block takes a position for its start, one per instruction and
+	// one for its end, intervals cover every position their value is live
+	intervals.assign(ids, {.start = UINT32_MAX, .end = 0, .weight = 0, .crosses_call = false, .reg = REG_SPILLED});
+	auto cover = [&](uint32_t id, uint32_t position) {
+		intervals[id].start = std::min(intervals[id].start, position);
+		intervals[id].end = std::max(intervals[id].end, position);
+	};
+	auto cover_set = [&](const Bitset& set, uint32_t position) {
+		for (size_t word = 0; word < words; word++) {
+			for (uint64_t bits = set[word]; bits != 0; bits &= bits - 1) {
+				cover(word * 64 + __builtin_ctzll(bits), position);
+			}
+		}
+	};
+
+	uint32_t position = 0;
+	for (size_t block = 0; block < blocks; block++) {
+		uint64_t weight = 1;
+		for (uint32_t depth = 0; depth < std::min(function.blocks[block].loop_depth, (uint32_t) MAX_WEIGHTED_DEPTH); depth++) {
+			weight *= LOOP_WEIGHT;
+		}
+
+		cover_set(live_in[block], position++);
+		for (const Ir_Instruction& instruction: function.blocks[block].instructions) {
+			for_each_access(function, rematerialized, instruction, [&](uint32_t id, bool) {
+				cover(id, position);
+				intervals[id].weight += weight;
+			});
+			if (instruction.opcode == IR_OP_CALL) {
+				calls.push_back(position);
+			}
+			position++;
+		}
+		cover_set(live_out[block], position++);
+	}
+
+	for (Live_Interval& interval: intervals) {
+		auto call = std::upper_bound(calls.begin(), calls.end(), interval.start);
+		interval.crosses_call = call != calls.end() && *call < interval.end;
+	}
+}
+
+void RegisterAllocator::linear_scan(Register_Allocation& allocation) {
+	std::vector<uint32_t> order;
+	for (uint32_t id = 0; id < intervals.size(); id++) {
+		if (intervals[id].start != UINT32_MAX) {
+			order.push_back(id);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+		return intervals[a].start < intervals[b].start;
+	});
+
+	std::vector<uint32_t> active;
+	std::vector<bool> used(allocatable_regs.size());
+	std::vector<bool> saved(CALLEE_SAVED_REGS);
+
+	for (uint32_t id: order) {
+		Live_Interval& current = intervals[id];
+
+		// release the registers of the intervals already finished, an
+		// instruction reads all its operands before writing its result so
+		// both can share a register
+		for (size_t i = 0; i < active.size();) {
+			if (intervals[active[i]].end <= current.start) {
+				used[intervals[active[i]].reg] = false;
+				active.erase(active.begin() + i);
+			} else {
+				i++;
+			}
+		}
+
+		// caller saved registers are preferred, they need no saving on the prologue
+		size_t allowed = current.crosses_call ? CALLEE_SAVED_REGS : allocatable_regs.size();
+		for (size_t reg = allowed; reg-- > 0;) {
+			if (!used[reg]) {
+				current.reg = reg;
+				break;
+			}
+		}
+
+		if (current.reg == REG_SPILLED) {
+			// take the register of the cheapest active interval if it costs less than this one
+			uint32_t* cheapest = nullptr;
+			for (uint32_t& other: active) {
+				if ((size_t) intervals[other].reg < allowed && (cheapest == nullptr || intervals[other].weight < intervals[*cheapest].weight)) {
+					cheapest = &other;
+				}
+			}
+
+			if (cheapest == nullptr || intervals[*cheapest].weight >= current.weight) {
+				continue;
+			}
+
+			current.reg = intervals[*cheapest].reg;
+			intervals[*cheapest].reg = REG_SPILLED;
+			active.erase(active.begin() + (cheapest - active.data()));
+		}
+
+		used[current.reg] = true;
+		active.push_back(id);
+		if (current.reg < CALLEE_SAVED_REGS && !saved[current.reg]) {
+			saved[current.reg] = true;
+			allocation.saved.push_back(current.reg);
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "ir.hpp"
+#include "x86.hpp"
+
+// Registers values can live on, the callee saved ones first. rax, rcx and rdx
+// are scratch for the instruction selection and the argument registers are
+// left out so calls never have to shuffle them. The builtins only clobber
+// r10 and r11 among these, so those two can't hold a value across a call.
+const std::vector<X86Register> allocatable_regs = {X86_RBX, X86_R12, X86_R13, X86_R14, X86_R15, X86_R10, X86_R11};
+#define CALLEE_SAVED_REGS 5
+
+// Value without register, it lives on its [rbp - N] slot
+#define REG_SPILLED -1
+
+typedef struct {
+	// positions of the first and last instruction the value must survive
+	uint32_t start;
+	uint32_t end;
+	// uses weighted by loop depth, the cheapest intervals are spilled first
+	uint64_t weight;
+	bool crosses_call;
+	int reg;
+} Live_Interval;
+
+typedef struct {
+	// index on allocatable_regs, or REG_SPILLED. Virtual registers first,
+	// then locals: local l is at function.values + l
+	std::vector<int> registers;
+	// callee saved registers the function has to preserve
+	std::vector<int> saved;
+	size_t spilled;
+} Register_Allocation;
+
+/**
+ * @brief Linear scan allocation of the virtual registers and locals of a
+ * function. Liveness is solved over the blocks, each value gets one interval
+ * covering everywhere it is live on the layout order. Constants and string
+ * addresses are never allocated, they are rematerialized on every use.
+ */
+class RegisterAllocator {
+private:
+	const Ir_Function& function;
+	std::vector<Live_Interval> intervals;
+	std::vector<uint32_t> calls;
+	// values defined by a constant or a string, they get no interval
+	std::vector<bool> rematerialized;
+
+	void build_intervals();
+	void linear_scan(Register_Allocation& allocation);
+
+public:
+	RegisterAllocator(const Ir_Function& function);
+
+	/**
+	 * @brief Choose where every value of the function lives
+	 */
+	Register_Allocation allocate();
+};
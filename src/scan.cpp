@@ -0,0 +1,248 @@
+#include <cstdint>
+#include "scan.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SCAN_SIMD
+#endif
+
+#define CLASS_BLANK 1
+#define CLASS_NAME 2
+#define CLASS_DIGIT 4
+
+static constexpr struct Char_Classes {
+	uint8_t table[256] = {};
+
+	constexpr Char_Classes() {
+		table[(uint8_t) ' '] = CLASS_BLANK;
+		table[(uint8_t) '\t'] = CLASS_BLANK;
+		table[(uint8_t) '\n'] = CLASS_BLANK;
+		table[(uint8_t) '\r'] = CLASS_BLANK;
+		for (int c = 'a'; c <= 'z'; c++) table[c] = CLASS_NAME;
+		for (int c = 'A'; c <= 'Z'; c++) table[c] = CLASS_NAME;
+		for (int c = '0'; c <= '9'; c++) table[c] = CLASS_NAME | CLASS_DIGIT;
+		table[(uint8_t) '_'] = CLASS_NAME;
+	}
+} char_classes;
+
+static inline bool has_class(char c, uint8_t cls) {
+	return char_classes.table[(uint8_t) c] & cls;
+}
+
+static const char* skip_class_scalar(const char* p, const char* end, uint8_t cls) {
+	while (p < end && has_class(*p, cls)) {
+		p++;
+	}
+	return p;
+}
+
+static const char* skip_blankspace_scalar(const char* p, const char* end, size_t& newlines, const char*& last_newline) {
+	for (; p < end && has_class(*p, CLASS_BLANK); p++) {
+		if (*p == '\n') {
+			newlines++;
+			last_newline = p;
+		}
+	}
+	return p;
+}
+
+static const char* skip_name_scalar(const char* p, const char* end) {
+	return skip_class_scalar(p, end, CLASS_NAME);
+}
+
+static const char* skip_number_scalar(const char* p, const char* end) {
+	return skip_class_scalar(p, end, CLASS_DIGIT);
+}
+
+static const char* find_quote_scalar(const char* p, const char* end, size_t& newlines, const char*& last_newline) {
+	for (; p < end && *p != '"'; p++) {
+		if (*p == '\n') {
+			newlines++;
+			last_newline = p;
+		}
+	}
+	return p;
+}
+
+#ifdef SCAN_SIMD
+// Counts the newlines of a block found before the stop position
+static inline void count_newlines(const char* block, uint32_t newline_mask, size_t& newlines, const char*& last_newline) {
+	if (newline_mask != 0) {
+		newlines += __builtin_popcount(newline_mask);
+		last_newline = block + 31 - __builtin_clz(newline_mask);
+	}
+}
+
+static inline uint32_t mask_before(uint32_t stop) {
+	return (uint32_t) ((1ull << stop) - 1);
+}
+
+#define SSE2_TARGET __attribute__((target("sse2"), always_inline)) static inline
+#define AVX2_TARGET __attribute__((target("avx2"), always_inline)) static inline
+
+SSE2_TARGET __m128i in_range_sse2(__m128i v, char lo, char hi) {
+	__m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(lo)), v);
+	__m128i le = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(hi)), v);
+	return _mm_and_si128(ge, le);
+}
+
+SSE2_TARGET uint32_t blank_mask_sse2(__m128i v) {
+	__m128i m = _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+		_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+	return _mm_movemask_epi8(m);
+}
+
+SSE2_TARGET uint32_t name_mask_sse2(__m128i v) {
+	__m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+	__m128i m = _mm_or_si128(
+		_mm_or_si128(in_range_sse2(lower, 'a', 'z'), in_range_sse2(v, '0', '9')),
+		_mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+	return _mm_movemask_epi8(m);
+}
+
+SSE2_TARGET uint32_t digit_mask_sse2(__m128i v) {
+	return _mm_movemask_epi8(in_range_sse2(v, '0', '9'));
+}
+
+SSE2_TARGET uint32_t char_mask_sse2(__m128i v, char c) {
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+
+AVX2_TARGET __m256i in_range_avx2(__m256i v, char lo, char hi) {
+	__m256i ge = _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(lo)), v);
+	__m256i le = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(hi)), v);
+	return _mm256_and_si256(ge, le);
+}
+
+AVX2_TARGET uint32_t blank_mask_avx2(__m256i v) {
+	__m256i m = _mm256_or_si256(
+		_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+		_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+	return _mm256_movemask_epi8(m);
+}
+
+AVX2_TARGET uint32_t name_mask_avx2(__m256i v) {
+	__m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+	__m256i m = _mm256_or_si256(
+		_mm256_or_si256(in_range_avx2(lower, 'a', 'z'), in_range_avx2(v, '0', '9')),
+		_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+	return _mm256_movemask_epi8(m);
+}
+
+AVX2_TARGET uint32_t digit_mask_avx2(__m256i v) {
+	return _mm256_movemask_epi8(in_range_avx2(v, '0', '9'));
+}
+
+AVX2_TARGET uint32_t char_mask_avx2(__m256i v, char c) {
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+}
+
+// Every kernel loads WIDTH bytes at a time, computes the mask of characters
+// that keep the scan going and stops at the first cleared bit. The remaining
+// tail shorter than a block goes through the scalar version.
+#define DEFINE_KERNELS(ISA, WIDTH, VEC, LOAD)                                                                 \
+	__attribute__((target(#ISA))) static const char* skip_blankspace_##ISA(const char* p, const char* end,     \
+		size_t& newlines, const char*& last_newline) {                                                        \
+		const uint32_t full = (uint32_t) ((1ull << WIDTH) - 1);                                               \
+		for (; p + WIDTH <= end; p += WIDTH) {                                                                 \
+			VEC v = LOAD((const VEC*) p);                                                                     \
+			uint32_t blank = blank_mask_##ISA(v);                                                             \
+			uint32_t newline = char_mask_##ISA(v, '\n');                                                      \
+			if (blank != full) {                                                                              \
+				uint32_t stop = __builtin_ctz(~blank);                                                        \
+				count_newlines(p, newline & mask_before(stop), newlines, last_newline);                       \
+				return p + stop;                                                                              \
+			}                                                                                                 \
+			count_newlines(p, newline, newlines, last_newline);                                               \
+		}                                                                                                     \
+		return skip_blankspace_scalar(p, end, newlines, last_newline);                                        \
+	}                                                                                                         \
+	__attribute__((target(#ISA))) static const char* skip_name_##ISA(const char* p, const char* end) {        \
+		const uint32_t full = (uint32_t) ((1ull << WIDTH) - 1);                                               \
+		for (; p + WIDTH <= end; p += WIDTH) {                                                                 \
+			uint32_t name = name_mask_##ISA(LOAD((const VEC*) p));                                            \
+			if (name != full) {                                                                               \
+				return p + __builtin_ctz(~name);                                                              \
+			}                                                                                                 \
+		}                                                                                                     \
+		return skip_name_scalar(p, end);                                                                      \
+	}                                                                                                         \
+	__attribute__((target(#ISA))) static const char* skip_number_##ISA(const char* p, const char* end) {      \
+		const uint32_t full = (uint32_t) ((1ull << WIDTH) - 1);                                               \
+		for (; p + WIDTH <= end; p += WIDTH) {                                                                 \
+			uint32_t digit = digit_mask_##ISA(LOAD((const VEC*) p));                                          \
+			if (digit != full) {                                                                              \
+				return p + __builtin_ctz(~digit);                                                             \
+			}                                                                                                 \
+		}                                                                                                     \
+		return skip_number_scalar(p, end);                                                                    \
+	}                                                                                                         \
+	__attribute__((target(#ISA))) static const char* find_quote_##ISA(const char* p, const char* end,          \
+		size_t& newlines, const char*& last_newline) {                                                        \
+		for (; p + WIDTH <= end; p += WIDTH) {                                                                 \
+			VEC v = LOAD((const VEC*) p);                                                                     \
+			uint32_t quote = char_mask_##ISA(v, '"');                                                         \
+			uint32_t newline = char_mask_##ISA(v, '\n');                                                      \
+			if (quote != 0) {                                                                                 \
+				uint32_t stop = __builtin_ctz(quote);                                                         \
+				count_newlines(p, newline & mask_before(stop), newlines, last_newline);                       \
+				return p + stop;                                                                              \
+			}                                                                                                 \
+			count_newlines(p, newline, newlines, last_newline);                                               \
+		}                                                                                                     \
+		return find_quote_scalar(p, end, newlines, last_newline);                                             \
+	}
+
+DEFINE_KERNELS(sse2, 16, __m128i, _mm_loadu_si128)
+DEFINE_KERNELS(avx2, 32, __m256i, _mm256_loadu_si256)
+#endif
+
+typedef struct {
+	const char* name;
+	const char* (*skip_blankspace)(const char*, const char*, size_t&, const char*&);
+	const char* (*skip_name)(const char*, const char*);
+	const char* (*skip_number)(const char*, const char*);
+	const char* (*find_quote)(const char*, const char*, size_t&, const char*&);
+} Scan_Kernels;
+
+static const Scan_Kernels scalar_kernels = {"scalar", skip_blankspace_scalar, skip_name_scalar, skip_number_scalar, find_quote_scalar};
+#ifdef SCAN_SIMD
+static const Scan_Kernels sse2_kernels = {"sse2", skip_blankspace_sse2, skip_name_sse2, skip_number_sse2, find_quote_sse2};
+static const Scan_Kernels avx2_kernels = {"avx2", skip_blankspace_avx2, skip_name_avx2, skip_number_avx2, find_quote_avx2};
+#endif
+
+static const Scan_Kernels* select_kernels() {
+#ifdef SCAN_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return &avx2_kernels;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return &sse2_kernels;
+	}
+#endif
+	return &scalar_kernels;
+}
+
+static const Scan_Kernels* kernels = select_kernels();
+
+const char* Scan::skip_blankspace(const char* p, const char* end, size_t& newlines, const char*& last_newline) {
+	return kernels->skip_blankspace(p, end, newlines, last_newline);
+}
+
+const char* Scan::skip_name(const char* p, const char* end) {
+	return kernels->skip_name(p, end);
+}
+
+const char* Scan::skip_number(const char* p, const char* end) {
+	return kernels->skip_number(p, end);
+}
+
+const char* Scan::find_quote(const char* p, const char* end, size_t& newlines, const char*& last_newline) {
+	return kernels->find_quote(p, end, newlines, last_newline);
+}
+
+const char* Scan::isa() {
+	return kernels->name;
+}
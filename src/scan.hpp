@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+
+/**
+ * @brief Character class scanning kernels used by the lexer. On x86-64 the
+ * AVX2 or SSE2 version is picked at startup through CPUID, otherwise a
+ * table driven scalar version is used.
+ */
+class Scan {
+public:
+	/**
+	 * @brief Skip blankspaces (' ', '\t', '\n', '\r')
+	 *
+	 * @param newlines incremented with every '\n' skipped
+	 * @param last_newline set to the last '\n' skipped, untouched if none
+	 * @return const char* first non blank character or end
+	 */
+	static const char* skip_blankspace(const char* p, const char* end, size_t& newlines, const char*& last_newline);
+
+	/**
+	 * @brief Skip name characters ([A-Za-z0-9_])
+	 */
+	static const char* skip_name(const char* p, const char* end);
+
+	/**
+	 * @brief Skip decimal digits
+	 */
+	static const char* skip_number(const char* p, const char* end);
+
+	/**
+	 * @brief Find the next '"' keeping track of newlines like skip_blankspace
+	 *
+	 * @return const char* the quote or end if not found
+	 */
+	static const char* find_quote(const char* p, const char* end, size_t& newlines, const char*& last_newline);
+
+	/**
+	 * @brief Name of the selected implementation: "avx2", "sse2" or "scalar"
+	 */
+	static const char* isa();
+};
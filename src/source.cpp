@@ -0,0 +1,57 @@
+#include <deque>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source.hpp"
+#include "utils.hpp"
+
+typedef struct {
+	std::string filename;
+	std::string_view content;
+} Source_File;
+
+// deque keeps references stable while new files are registered, lexers
+// running on the thread pool open files concurrently
+static std::deque<Source_File> files;
+static std::mutex files_mutex;
+
+uint32_t SourceTable::open(const std::string& filepath) {
+	int fd = ::open(filepath.c_str(), O_RDONLY);
+	if (fd < 0) {
+		Utils::error("File doesn't exists: " + filepath);
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		Utils::error("Couldn't stat file: " + filepath);
+	}
+
+	std::string_view content;
+	if (st.st_size > 0) {
+		void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			Utils::error("Couldn't map file: " + filepath);
+		}
+		content = std::string_view(static_cast<const char*>(data), st.st_size);
+	}
+	close(fd);
+
+	std::lock_guard<std::mutex> lock(files_mutex);
+	if (files.size() == MAX_LOC_FILES) {
+		Utils::error("Too many source files, the limit is " + std::to_string(MAX_LOC_FILES));
+	}
+	files.push_back({.filename = filepath, .content = content});
+	return files.size() - 1;
+}
+
+std::string_view SourceTable::content(uint32_t file_id) {
+	std::lock_guard<std::mutex> lock(files_mutex);
+	return files[file_id].content;
+}
+
+const std::string& SourceTable::filename(uint32_t file_id) {
+	std::lock_guard<std::mutex> lock(files_mutex);
+	return files[file_id].filename;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Process wide table of memory-mapped source files. Mappings stay
+ * alive for the whole compilation, so tokens can point straight into them.
+ */
+class SourceTable {
+public:
+	/**
+	 * @brief Map a file into memory and register it on the table
+	 *
+	 * @param filepath
+	 * @return uint32_t file id used by TokenLoc
+	 */
+	static uint32_t open(const std::string& filepath);
+	static std::string_view content(uint32_t file_id);
+	static const std::string& filename(uint32_t file_id);
+};
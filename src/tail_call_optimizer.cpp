@@ -0,0 +1,136 @@
+#include "tail_call_optimizer.hpp"
+
+TailCallOptimizer::TailCallOptimizer(Ir_Function& function) : function(function) {}
+
+/**
+ * @brief Whether block ends calling a function and returning its result
+ */
+static bool ends_in_tail_call(const Ir_Block& block) {
+	size_t size = block.instructions.size();
+	if (size < 2) {
+		return false;
+	}
+
+	const Ir_Instruction& call = block.instructions[size - 2];
+	const Ir_Instruction& ret = block.instructions[size - 1];
+	return call.opcode == IR_OP_CALL && ret.opcode == IR_OP_RET && ret.a != VALUE_NONE && ret.a == call.dst;
+}
+
+static Ir_Instruction new_instruction(IrOpcode opcode) {
+	Ir_Instruction instruction = {};
+	instruction.opcode = opcode;
+	instruction.type = IR_TYPE_I64;
+	instruction.dst = VALUE_NONE;
+	instruction.a = VALUE_NONE;
+	instruction.b = VALUE_NONE;
+	return instruction;
+}
+
+size_t TailCallOptimizer::loop_self_calls() {
+	std::vector<Block_Index> sites;
+	for (Block_Index block = 0; block < function.blocks.size(); block++) {
+		const Ir_Block& ir_block = function.blocks[block];
+		if (ends_in_tail_call(ir_block) && ir_block.instructions[ir_block.instructions.size() - 2].callee == function.name) {
+			sites.push_back(block);
+		}
+	}
+	if (sites.empty()) {
+		return 0;
+	}
+
+	// a new entry keeps the parameters on locals the loop reads them from,
+	// every block moves one place down
+	std::vector<Ir_Instruction> entry;
+	std::vector<Local_Index> argument_locals(function.arguments, 0);
+	std::vector<Ir_Instruction>& body = function.blocks[0].instructions;
+	for (size_t i = 0; i < body.size();) {
+		if (body[i].opcode != IR_OP_PARAM) {
+			i++;
+			continue;
+		}
+
+		Ir_Instruction param = body[i];
+		body.erase(body.begin() + i);
+		argument_locals[param.imm] = function.locals.size();
+		function.locals.push_back({.name = SYMBOL_NONE, .type = IR_TYPE_I64});
+
+		Ir_Instruction load = new_instruction(IR_OP_LOAD_LOCAL);
+		load.dst = function.values++;
+		load.imm = argument_locals[param.imm];
+		replace_uses(function, param.dst, load.dst);
+		body.insert(body.begin() + i, load);
+		i++;
+
+		Ir_Instruction store = new_instruction(IR_OP_STORE_LOCAL);
+		store.a = param.dst;
+		store.imm = argument_locals[param.imm];
+		entry.push_back(param);
+		entry.push_back(store);
+	}
+
+	Ir_Instruction jump = new_instruction(IR_OP_JMP);
+	jump.target = 1;
+	entry.push_back(jump);
+	insert_block(function, 0, {.instructions = entry, .loop_depth = 0});
+
+	// the arguments are all evaluated before storing any of them
+	for (Block_Index& site: sites) {
+		site++;
+		std::vector<Ir_Instruction>& instructions = function.blocks[site].instructions;
+		Ir_Instruction call = instructions[instructions.size() - 2];
+		instructions.resize(instructions.size() - 2);
+
+		for (const Ir_Instruction& instruction: function.blocks[0].instructions) {
+			if (instruction.opcode == IR_OP_PARAM) {
+				Ir_Instruction store = new_instruction(IR_OP_STORE_LOCAL);
+				store.a = function.call_args[call.args.first + instruction.imm];
+				store.imm = argument_locals[instruction.imm];
+				instructions.push_back(store);
+			}
+		}
+		instructions.push_back(jump);
+	}
+
+	// the blocks reaching back to the start are now inside a loop
+	std::vector<std::vector<Block_Index>> reverse(function.blocks.size());
+	for (Block_Index block = 0; block < function.blocks.size(); block++) {
+		for_each_successor(function.blocks[block].instructions.back(), [&](Block_Index successor) {
+			reverse[successor].push_back(block);
+		});
+	}
+	std::vector<bool> in_loop(function.blocks.size(), false);
+	std::vector<Block_Index> pending = sites;
+	for (Block_Index site: sites) {
+		in_loop[site] = true;
+	}
+	while (!pending.empty()) {
+		Block_Index block = pending.back();
+		pending.pop_back();
+		function.blocks[block].loop_depth++;
+		for (Block_Index predecessor: reverse[block]) {
+			if (predecessor != 0 && !in_loop[predecessor]) {
+				in_loop[predecessor] = true;
+				pending.push_back(predecessor);
+			}
+		}
+	}
+
+	return sites.size();
+}
+
+size_t TailCallOptimizer::mark_tail_calls() {
+	size_t tail_calls = 0;
+	for (Ir_Block& block: function.blocks) {
+		if (!ends_in_tail_call(block)) {
+			continue;
+		}
+
+		block.instructions.pop_back();
+		Ir_Instruction& call = block.instructions.back();
+		call.opcode = IR_OP_TAIL_CALL;
+		call.dst = VALUE_NONE;
+		tail_calls++;
+	}
+
+	return tail_calls;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "ir.hpp"
+
+/**
+ * @brief Keeps the stack from growing on calls in tail position, the ones
+ * whose result is returned right away. A function calling itself that way
+ * becomes a loop back to its start, other tail calls reuse the frame of the
+ * caller and jump to the callee.
+ */
+class TailCallOptimizer {
+private:
+	Ir_Function& function;
+
+public:
+	TailCallOptimizer(Ir_Function& function);
+
+	/**
+	 * @brief Replace the tail calls of the function to itself by storing
+	 * the arguments and jumping back to the block after the parameters
+	 * @return number of calls replaced
+	 */
+	size_t loop_self_calls();
+
+	/**
+	 * @brief Turn every call followed by the return of its result into a
+	 * tail call. Done once inlining is over, the inliner expects calls.
+	 * @return number of tail calls
+	 */
+	size_t mark_tail_calls();
+};
@@ -0,0 +1,104 @@
+#include "thread_pool.hpp"
+
+// queue of the worker running on this thread, -1 outside the pool
+static thread_local long current_worker = -1;
+static thread_local ThreadPool* current_pool = nullptr;
+
+ThreadPool::ThreadPool(size_t threads) : pending(0), queued(0), next_queue(0), stopping(false) {
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for (size_t i = 0; i < threads; i++) {
+		queues.push_back(std::make_unique<Worker_Queue>());
+	}
+	for (size_t i = 0; i < threads; i++) {
+		this->threads.emplace_back(&ThreadPool::worker_loop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread: threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::submit(Task task) {
+	size_t queue = current_pool == this ? current_worker : next_queue++ % queues.size();
+	pending++;
+	{
+		std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+		queues[queue]->tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		queued++;
+	}
+	wake.notify_one();
+}
+
+bool ThreadPool::take_task(size_t worker, Task& task) {
+	Worker_Queue& own = *queues[worker];
+	{
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	for (size_t i = 1; i < queues.size(); i++) {
+		Worker_Queue& victim = *queues[(worker + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::worker_loop(size_t worker) {
+	current_worker = worker;
+	current_pool = this;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			wake.wait(lock, [this] { return stopping || queued > 0; });
+			if (queued == 0) {
+				return;
+			}
+			queued--;
+		}
+
+		// a task is reserved for this worker, it is on some queue
+		Task task;
+		while (!take_task(worker, task)) {
+			std::this_thread::yield();
+		}
+		task();
+
+		if (--pending == 0) {
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			done.notify_all();
+		}
+	}
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(sleep_mutex);
+	done.wait(lock, [this] { return pending == 0; });
+}
+
+size_t ThreadPool::size() {
+	return threads.size();
+}
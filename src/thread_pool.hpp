@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> Task;
+
+/**
+ * @brief Work stealing pool, every worker has its own queue. Tasks submitted
+ * from a worker go to its queue (taken LIFO so the most recent, cache hot
+ * work runs first), idle workers steal the oldest task of the other queues.
+ */
+class ThreadPool {
+private:
+	typedef struct {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	} Worker_Queue;
+
+	std::vector<std::unique_ptr<Worker_Queue>> queues;
+	std::vector<std::thread> threads;
+
+	// submitted tasks not finished yet
+	std::atomic<size_t> pending;
+	// submitted tasks not taken by a worker yet, guarded by sleep_mutex
+	size_t queued;
+	std::atomic<size_t> next_queue;
+	bool stopping;
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	void worker_loop(size_t worker);
+	bool take_task(size_t worker, Task& task);
+
+public:
+	/**
+	 * @brief Pool running threads workers, 0 uses the hardware concurrency
+	 */
+	ThreadPool(size_t threads);
+	~ThreadPool();
+
+	/**
+	 * @brief Queue task, it can be called from inside another task
+	 */
+	void submit(Task task);
+
+	/**
+	 * @brief Block until every submitted task, including the ones submitted
+	 * by running tasks, has finished
+	 */
+	void wait();
+
+	size_t size();
+};
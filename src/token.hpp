@@ -1,16 +1,23 @@
 #pragma once
-#include <string>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#include "interner.hpp"
+
+#define MAX_LOC_COLUMN UINT16_MAX
+#define MAX_LOC_FILES (UINT16_MAX + 1)
 
 class TokenLoc {
 public:
-	size_t row;
-	size_t column;
-	std::string filename;
+	uint32_t row;
+	uint16_t column; // saturates at MAX_LOC_COLUMN
+	uint16_t file; // id on SourceTable
 
-	TokenLoc(size_t row, size_t column, std::string filename) 
-		: row(row), column(column), filename(filename) {}
+	TokenLoc(size_t row, size_t column, uint32_t file) 
+		: row(row), column(column < MAX_LOC_COLUMN ? column : MAX_LOC_COLUMN), file(file) {}
 
-	TokenLoc() {}
+	TokenLoc() : row(0), column(0), file(0) {}
 };	
 
 class Token {
@@ -49,20 +56,36 @@ public:
 		ARROW,
 		BANG_EQUALS,
 		LOWER_THAN_EQUALS,
+		GREATER_THAN_EQUALS,
+		LOGICAL_AND,
+		LOGICAL_OR,
+		BIT_AND,
+		BIT_OR,
+		BIT_XOR,
+		BIT_NOT,
+		SHIFT_LEFT,
+		SHIFT_RIGHT,
 		TOKEN_COUNTER,
 	};
-	Token();
+	Token() : symbol(SYMBOL_NONE), type(UNKNOWN) {}
 
 private:
-	Type type;
-	std::string value;
+	// points into the mapped source, see SourceTable
+	std::string_view value;
 	TokenLoc loc;
+	Symbol symbol; // NAME tokens only
+	Type type;
 
 public:
-	void set_type(Type type);
-	Type get_type();
-	void set_value(std::string value);
-	std::string get_value();
-	void set_loc(TokenLoc loc);
-	TokenLoc get_loc();
+	void set_type(Type type) { this->type = type; }
+	Type get_type() const { return type; }
+	void set_value(std::string_view value) { this->value = value; }
+	std::string_view get_value() const { return value; }
+	void set_loc(TokenLoc loc) { this->loc = loc; }
+	TokenLoc get_loc() const { return loc; }
+	void set_symbol(Symbol symbol) { this->symbol = symbol; }
+	Symbol get_symbol() const { return symbol; }
 };
+
+static_assert(std::is_trivially_copyable_v<Token>, "Token must stay trivially copyable");
+static_assert(sizeof(Token) == 32, "Token must stay packed");
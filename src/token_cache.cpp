@@ -0,0 +1,240 @@
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "token_cache.hpp"
+#include "interner.hpp"
+#include "lexer.hpp"
+#include "source.hpp"
+
+#define CACHE_MAGIC "AKATOKC"
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t token_types;
+	uint64_t lexer_hash;
+	uint64_t content_hash;
+	uint64_t content_size;
+	uint32_t token_count;
+	uint32_t name_count;
+} Cache_Header;
+
+// names and token values are (offset, length) slices of the source content
+typedef struct {
+	uint32_t offset;
+	uint32_t length;
+} Cached_Name;
+
+typedef struct {
+	uint32_t offset;
+	uint32_t length;
+	uint32_t row;
+	uint16_t column;
+	uint8_t type;
+	uint8_t padding;
+	// index on the name table, SYMBOL_NONE for tokens without a symbol
+	uint32_t name;
+} Cached_Token;
+
+static std::mutex directory_mutex;
+static bool directory_set = false;
+static std::string cache_directory;
+
+static std::string default_directory() {
+	if (const char* dir = getenv("AKA_CACHE_DIR")) {
+		return dir;
+	}
+	if (const char* home = getenv("HOME")) {
+		return std::string(home) + "/.cache/akalang";
+	}
+	return "";
+}
+
+static std::string directory() {
+	std::lock_guard<std::mutex> lock(directory_mutex);
+	if (!directory_set) {
+		cache_directory = default_directory();
+		directory_set = true;
+	}
+	return cache_directory;
+}
+
+void TokenCache::set_directory(const std::string& directory) {
+	std::lock_guard<std::mutex> lock(directory_mutex);
+	cache_directory = directory;
+	directory_set = true;
+}
+
+static uint64_t hash_content(std::string_view content) {
+	// 8 bytes per step, good enough to tell file versions apart
+	uint64_t hash = 0x9E3779B97F4A7C15ull ^ content.size();
+	size_t i = 0;
+	for (; i + 8 <= content.size(); i += 8) {
+		uint64_t word;
+		memcpy(&word, content.data() + i, 8);
+		hash = (hash ^ word) * 0xBF58476D1CE4E5B9ull;
+		hash ^= hash >> 31;
+	}
+	for (; i < content.size(); i++) {
+		hash = (hash ^ (unsigned char) content[i]) * 0x100000001B3ull;
+	}
+	return hash ^ (hash >> 29);
+}
+
+static uint64_t lexer_hash() {
+	static const uint64_t hash = hash_content(LEXER_BUILD);
+	return hash;
+}
+
+static std::string entry_path(const std::string& directory, uint64_t hash) {
+	// entries of different lexers live side by side
+	char name[32];
+	snprintf(name, sizeof(name), "/%016lx.tok", (unsigned long) (hash ^ lexer_hash()));
+	return directory + name;
+}
+
+static bool in_content(uint32_t offset, uint32_t length, std::string_view content) {
+	return (uint64_t) offset + length <= content.size();
+}
+
+static bool load(const std::string& path, uint32_t file_id, uint64_t hash, std::vector<Token>& tokens) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	void* data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(Cache_Header)) {
+		data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	std::string_view content = SourceTable::content(file_id);
+	const Cache_Header* header = static_cast<const Cache_Header*>(data);
+	bool valid = memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) == 0
+		&& header->version == TOKEN_CACHE_VERSION
+		&& header->token_types == Token::Type::TOKEN_COUNTER
+		&& header->lexer_hash == lexer_hash()
+		&& header->content_hash == hash
+		&& header->content_size == content.size()
+		&& (size_t) st.st_size == sizeof(Cache_Header) + header->name_count * sizeof(Cached_Name) + header->token_count * sizeof(Cached_Token);
+
+	const Cached_Name* names = reinterpret_cast<const Cached_Name*>(header + 1);
+	const Cached_Token* cached = reinterpret_cast<const Cached_Token*>(names + header->name_count);
+	// a damaged entry may still pass the header checks, every slice and index is checked before use
+	for (uint32_t i = 0; valid && i < header->name_count; i++) {
+		valid = in_content(names[i].offset, names[i].length, content);
+	}
+	for (uint32_t i = 0; valid && i < header->token_count; i++) {
+		const Cached_Token& from = cached[i];
+		valid = in_content(from.offset, from.length, content) && from.type < Token::Type::TOKEN_COUNTER
+			&& (from.name < header->name_count || from.name == SYMBOL_NONE);
+	}
+
+	if (valid) {
+		std::vector<Symbol> symbols(header->name_count);
+		for (uint32_t i = 0; i < header->name_count; i++) {
+			symbols[i] = Interner::intern(content.substr(names[i].offset, names[i].length));
+		}
+
+		tokens.resize(header->token_count);
+		for (uint32_t i = 0; i < header->token_count; i++) {
+			const Cached_Token& from = cached[i];
+			Token& token = tokens[i];
+			token.set_value(content.substr(from.offset, from.length));
+			token.set_loc(TokenLoc(from.row, from.column, file_id));
+			token.set_type((Token::Type) from.type);
+			token.set_symbol(from.name == SYMBOL_NONE ? SYMBOL_NONE : symbols[from.name]);
+		}
+	}
+
+	munmap(data, st.st_size);
+	return valid;
+}
+
+static void store(const std::string& directory, const std::string& path, uint32_t file_id, uint64_t hash, const std::vector<Token>& tokens) {
+	std::string_view content = SourceTable::content(file_id);
+
+	std::vector<Cached_Name> names;
+	std::unordered_map<Symbol, uint32_t> name_index;
+	std::vector<Cached_Token> cached(tokens.size());
+	for (size_t i = 0; i < tokens.size(); i++) {
+		const Token& token = tokens[i];
+		uint32_t offset = token.get_value().data() - content.data();
+		uint32_t name = SYMBOL_NONE;
+		if (token.get_symbol() != SYMBOL_NONE) {
+			auto [it, inserted] = name_index.insert({token.get_symbol(), names.size()});
+			if (inserted) {
+				names.push_back({offset, (uint32_t) token.get_value().size()});
+			}
+			name = it->second;
+		}
+
+		cached[i] = {
+			.offset = offset,
+			.length = (uint32_t) token.get_value().size(),
+			.row = token.get_loc().row,
+			.column = token.get_loc().column,
+			.type = (uint8_t) token.get_type(),
+			.padding = 0,
+			.name = name,
+		};
+	}
+
+	Cache_Header header = {
+		.magic = CACHE_MAGIC,
+		.version = TOKEN_CACHE_VERSION,
+		.token_types = Token::Type::TOKEN_COUNTER,
+		.lexer_hash = lexer_hash(),
+		.content_hash = hash,
+		.content_size = content.size(),
+		.token_count = (uint32_t) cached.size(),
+		.name_count = (uint32_t) names.size(),
+	};
+
+	// written aside and renamed, concurrent compilers never see half an entry
+	mkdir(directory.c_str(), 0755);
+	std::string temp = path + ".XXXXXX";
+	int fd = mkstemp(temp.data());
+	if (fd < 0) {
+		return;
+	}
+	fchmod(fd, 0644);
+
+	bool written = write(fd, &header, sizeof(header)) == sizeof(header)
+		&& write(fd, names.data(), names.size() * sizeof(Cached_Name)) == (ssize_t) (names.size() * sizeof(Cached_Name))
+		&& write(fd, cached.data(), cached.size() * sizeof(Cached_Token)) == (ssize_t) (cached.size() * sizeof(Cached_Token));
+	close(fd);
+
+	if (!written || rename(temp.c_str(), path.c_str()) < 0) {
+		unlink(temp.c_str());
+	}
+}
+
+std::vector<Token> TokenCache::tokenize(const std::string& filename) {
+	uint32_t file_id = SourceTable::open(filename);
+	std::string dir = directory();
+	std::string_view content = SourceTable::content(file_id);
+	if (dir.empty() || content.size() < TOKEN_CACHE_MIN_SIZE || content.size() > UINT32_MAX) {
+		return Lexer(file_id).take_tokens();
+	}
+
+	uint64_t hash = hash_content(content);
+	std::string path = entry_path(dir, hash);
+	std::vector<Token> tokens;
+	if (load(path, file_id, hash, tokens)) {
+		return tokens;
+	}
+
+	tokens = Lexer(file_id).take_tokens();
+	store(dir, path, file_id, hash, tokens);
+	return tokens;
+}
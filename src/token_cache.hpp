@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "token.hpp"
+
+// Bump whenever the cache layout changes
+#define TOKEN_CACHE_VERSION 1
+// Identifies the lexer the entries come from, the Makefile defines it as a
+// checksum of the sources deciding the lexer output. Other builds use their
+// build time, so they never load the entries of a different lexer.
+#ifndef LEXER_BUILD
+#define LEXER_BUILD __DATE__ " " __TIME__
+#endif
+// Smaller files lex faster than the cache entry can be opened and mapped
+#define TOKEN_CACHE_MIN_SIZE 2048
+
+/**
+ * @brief On-disk cache of the token stream of included files. Entries are
+ * named after the hash of the file content and of LEXER_BUILD, loading one
+ * is a single mmap plus interning its distinct names.
+ * Any cache failure silently falls back to lexing the file.
+ */
+class TokenCache {
+public:
+	/**
+	 * @brief Directory holding the cache entries, empty disables the cache.
+	 * Defaults to $AKA_CACHE_DIR or $HOME/.cache/akalang
+	 */
+	static void set_directory(const std::string& directory);
+
+	/**
+	 * @brief Tokens of filename, from the cache when there is a valid entry,
+	 * otherwise the file is lexed and the entry is written
+	 */
+	static std::vector<Token> tokenize(const std::string& filename);
+};
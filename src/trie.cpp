@@ -1,40 +1,39 @@
-#include <iostream>
 #include "trie.hpp"
-#include "utils.hpp"
 
-Trie::Trie() {
-    root = std::shared_ptr<Node>(new Node());
-    for (int i = 0; i < CHAR_AMOUNT; i++) {
-      root->childs[i] = std::shared_ptr<Node>(nullptr);
-    }
+static bool is_name_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
 }
 
-void Trie::add_keyword(std::string&& keyword, Token::Type type) {
-  std::shared_ptr<Node> last = root;
-  int size = keyword.size();
-
-  for (int i = 0; i < size; i++) {
-    if (get_child_node(last, keyword, i) == nullptr) {
-      get_child_node(last, keyword, i) = std::make_shared<Node>();
+Token::Type Trie::lookup(std::string_view code, long& index) const {
+  long size = code.size();
+  long i = index;
+  int state = 0;
+
+  long match_end = index;
+  Token::Type match = Token::Type::UNKNOWN;
+  while (i < size) {
+    unsigned char c = code[i] - FIRST_CHAR;
+    if (c >= CHAR_AMOUNT || transitions[state][c] == 0) {
+      break;
     }
 
-    last = get_child_node(last, keyword, i);
+    state = transitions[state][c];
+    i++;
+    if (accepting[state] != Token::Type::UNKNOWN) {
+      match = accepting[state];
+      match_end = i;
+    }
   }
 
-  last->type = type;
-}
-
-Token::Type Trie::lookup(std::string& code, long& index) {
-  std::shared_ptr<Node> actual_node = root;
-  long i = index;
-
-  while (get_child_node(actual_node, code, i) != nullptr && i < (int) code.size() && !Utils::is_blankspace(code[i])) {
-    actual_node = get_child_node(actual_node, code, i++);
+  if (match == Token::Type::UNKNOWN) {
+    return match;
   }
 
-  if (actual_node->type != Token::Type::UNKNOWN) {
-    index += i - index;
+  // a keyword immediately followed by a name character is part of a name
+  if (is_name_char(code[match_end - 1]) && match_end < size && is_name_char(code[match_end])) {
+    return Token::Type::UNKNOWN;
   }
 
-  return actual_node->type;
+  index = match_end;
+  return match;
 }
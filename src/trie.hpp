@@ -1,39 +1,70 @@
 #pragma once
+#include <cstdint>
+#include <string_view>
 #include "token.hpp"
-#include <memory>
 
-#define CHAR_AMOUNT 100
+// Printable characters handled by the recognizer: '!' .. '~'
+#define FIRST_CHAR '!'
+#define CHAR_AMOUNT ('~' - '!' + 1)
+#define MAX_STATES 128
 
-#define get_child_node(node, str, index) node->childs[static_cast<int>(str[index] - '!')]
-
-class Node {
-public:
+typedef struct {
+  std::string_view text;
   Token::Type type;
-  std::shared_ptr<Node> childs[CHAR_AMOUNT];
-};
+} Keyword;
 
+/**
+ * @brief Flat keyword/punctuator recognizer. The transition table is filled at
+ * compile time, so every lexer shares the same read-only instance.
+ */
 class Trie {
+private:
+  // transitions[state][char] = next state, 0 means there is no transition
+  uint8_t transitions[MAX_STATES][CHAR_AMOUNT] = {};
+  Token::Type accepting[MAX_STATES] = {};
+  int states = 1;
+
 public:
-  std::shared_ptr<Node> root;
+  template <size_t N>
+  constexpr Trie(const Keyword (&keywords)[N]) {
+    for (const Keyword& keyword: keywords) {
+      add_keyword(keyword.text, keyword.type);
+    }
+  }
 
-  /**
-   * @brief Construct a new Trie object, initializes root childs to std::shared_ptr<Node>(nullptr)
-   */
-  Trie();
-  
   /**
    * @brief Asign a keyword to a type on the Trie
-   * 
-   * @param keyword 
-   * @param type 
+   *
+   * @param keyword
+   * @param type
    */
-  void add_keyword(std::string&& keyword, Token::Type type);
+  constexpr void add_keyword(std::string_view keyword, Token::Type type) {
+    int state = 0;
+    for (char c: keyword) {
+      if (c < FIRST_CHAR || c > '~') {
+        throw "Trie: keywords must be printable characters";
+      }
+
+      uint8_t& next = transitions[state][c - FIRST_CHAR];
+      if (next == 0) {
+        if (states == MAX_STATES) {
+          throw "Trie: MAX_STATES exceeded";
+        }
+        next = states++;
+      }
+      state = next;
+    }
+
+    accepting[state] = type;
+  }
 
   /**
-   * @brief Lookup for the most longer keyword found in the text provided
-   * 
+   * @brief Lookup for the most longer keyword found in the text provided.
+   * Keywords made of letters only match when they are not followed by a
+   * name character, so "iffy" is left for the lexer as a name.
+   *
    * @param text
    * @return Token::Type, Token::Type::UNKNOWN if keyword wasn't found
    */
-  Token::Type lookup(std::string& text, long& index);
+  Token::Type lookup(std::string_view text, long& index) const;
 };
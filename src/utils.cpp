@@ -1,9 +1,9 @@
 #include <fstream>
 #include <string>
-#include <vector>
 #include <iostream>
 #include "utils.hpp"
 #include "colors.hpp"
+#include "source.hpp"
 
 std::string Utils::read_file(const std::string& filepath) {
 	std::fstream file(filepath, std::ios::in);
@@ -15,20 +15,45 @@ std::string Utils::read_file(const std::string& filepath) {
 	std::streampos size = file.tellg();
 	file.seekg(0, std::ios::beg);
 
-	std::vector<char> buf(size);
-	file.read(&buf[0], size);
+	std::string buf(size, '\0');
+	file.read(buf.data(), size);
 
-	return std::string(buf.begin(), buf.end());
+	return buf;
 }
 
+// Thrown by Utils::error back to capture_errors, with the message to report
+typedef struct {
+	std::string message;
+} Captured_Error;
+
+// Whether the thread is running a task inside capture_errors
+static thread_local bool capturing = false;
+
 void Utils::error(const std::string& message) {
-	std::cerr << Colors::RED << message << Colors::RESET << std::endl;
-	exit(1);
+	if (capturing) {
+		throw Captured_Error{message};
+	}
+	report_error(message);
 }
 
 void Utils::error(const std::string& message, TokenLoc token) {
-	std::cerr << Colors::RED << "(" << token.filename << ", " << token.row;
-	std::cerr << ":" << token.column << ") " << message << Colors::RESET << std::endl;
+	error("(" + SourceTable::filename(token.file) + ", " + std::to_string(token.row) + ":" + std::to_string(token.column) + ") " + message);
+}
+
+std::string Utils::capture_errors(const std::function<void()>& task) {
+	capturing = true;
+	try {
+		task();
+	} catch (const Captured_Error& error) {
+		capturing = false;
+		return error.message;
+	}
+	capturing = false;
+	return "";
+}
+
+void Utils::report_error(const std::string& error) {
+	std::cerr << Colors::RED << error << Colors::RESET << std::endl;
 	exit(1);
 }
 
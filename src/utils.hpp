@@ -1,11 +1,31 @@
 #pragma once
+#include <functional>
 #include <string>
 #include "token.hpp"
 
 class Utils{
 public:
 	static std::string read_file(const std::string& filepath);
+
+	/**
+	 * @brief Print message and exit, on a thread inside capture_errors the
+	 * message is handed back to it instead
+	 */
 	static void error(const std::string& message);
 	static void error(const std::string& message, TokenLoc token);
 	static bool is_blankspace(char c);
+
+	/**
+	 * @brief Run task without exiting from the thread running it, for pool
+	 * workers: exiting while other workers still use the process wide tables
+	 * is undefined, and which error comes first would depend on scheduling
+	 * @return the error task stopped on, empty when it finished
+	 */
+	static std::string capture_errors(const std::function<void()>& task);
+
+	/**
+	 * @brief Print an error returned by capture_errors and exit, called on
+	 * the earliest one in source order once the pool is idle
+	 */
+	static void report_error(const std::string& error);
 };
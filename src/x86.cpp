@@ -0,0 +1,180 @@
+#include "x86.hpp"
+
+static const char* register_names[][X86_REGISTER_COUNT] = {
+	{"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"},
+	{"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"},
+	{"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"}
+};
+
+static const char* condition_names[] = {"l", "g", "e", "ne", "le", "ge"};
+static_assert(std::size(condition_names) == X86_CC_COUNTER, "Unhandled X86_CC_COUNTER on condition_names at x86.cpp");
+
+static const char* opcode_names[] = {
+	nullptr, "mov", "movsxd", "movzx", "lea", "add", "sub", "imul", "and", "or", "xor",
+	"neg", "not", "shl", "sar", "shr", "cqo", "idiv", "cmp", "test", "set", "jmp", "j", "call", "ret", "push", "pop",
+	"cdqe", "syscall", "leave", "nop"
+};
+static_assert(std::size(opcode_names) == X86_OPCODE_COUNTER, "Unhandled X86_OPCODE_COUNTER on opcode_names at x86.cpp");
+
+X86_Operand x86_register(X86Register reg, uint8_t size) {
+	return {.kind = X86_OPERAND_REGISTER, .size = size, .reg = reg, .index = X86_RAX, .scale = 0, .imm = 0, .symbol = SYMBOL_NONE};
+}
+
+X86_Operand x86_immediate(int64_t imm) {
+	return {.kind = X86_OPERAND_IMMEDIATE, .size = 8, .reg = X86_RAX, .index = X86_RAX, .scale = 0, .imm = imm, .symbol = SYMBOL_NONE};
+}
+
+X86_Operand x86_memory(uint8_t size, X86Register base, int64_t displacement) {
+	return {.kind = X86_OPERAND_MEMORY, .size = size, .reg = base, .index = X86_RAX, .scale = 0, .imm = displacement, .symbol = SYMBOL_NONE};
+}
+
+X86_Operand x86_string(int64_t index) {
+	return {.kind = X86_OPERAND_STRING, .size = 8, .reg = X86_RAX, .index = X86_RAX, .scale = 0, .imm = index, .symbol = SYMBOL_NONE};
+}
+
+X86_Operand x86_label(int64_t block) {
+	return {.kind = X86_OPERAND_LABEL, .size = 8, .reg = X86_RAX, .index = X86_RAX, .scale = 0, .imm = block, .symbol = SYMBOL_NONE};
+}
+
+X86_Operand x86_function(Symbol name) {
+	return {.kind = X86_OPERAND_FUNCTION, .size = 8, .reg = X86_RAX, .index = X86_RAX, .scale = 0, .imm = 0, .symbol = name};
+}
+
+X86_Instruction x86_instruction(X86Opcode opcode, X86_Operand a, X86_Operand b) {
+	return {.opcode = opcode, .condition = X86_CC_E, .a = a, .b = b};
+}
+
+X86Condition x86_negate(X86Condition condition) {
+	static_assert(X86_CC_COUNTER == 6, "Unhandled X86_CC_COUNTER on x86_negate at x86.cpp");
+	switch (condition) {
+		case X86_CC_L: return X86_CC_GE;
+		case X86_CC_G: return X86_CC_LE;
+		case X86_CC_E: return X86_CC_NE;
+		case X86_CC_NE: return X86_CC_E;
+		case X86_CC_LE: return X86_CC_G;
+		default: return X86_CC_L;
+	}
+}
+
+bool x86_same_operand(const X86_Operand& a, const X86_Operand& b) {
+	if (a.kind != b.kind) {
+		return false;
+	}
+	switch (a.kind) {
+		case X86_OPERAND_REGISTER: return a.reg == b.reg && a.size == b.size;
+		case X86_OPERAND_MEMORY:
+			return a.reg == b.reg && a.imm == b.imm && a.size == b.size && a.scale == b.scale && (a.scale == 0 || a.index == b.index);
+		case X86_OPERAND_FUNCTION: return a.symbol == b.symbol;
+		default: return a.imm == b.imm;
+	}
+}
+
+bool x86_parse_register(std::string_view name, X86_Operand& operand) {
+	static const uint8_t sizes[] = {1, 4, 8};
+	for (size_t size = 0; size < std::size(sizes); size++) {
+		for (int reg = 0; reg < X86_REGISTER_COUNT; reg++) {
+			if (name == register_names[size][reg]) {
+				operand = x86_register((X86Register) reg, sizes[size]);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool x86_parse_condition(std::string_view name, X86Condition& condition) {
+	for (int i = 0; i < X86_CC_COUNTER; i++) {
+		if (name == condition_names[i]) {
+			condition = (X86Condition) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool x86_parse_opcode(std::string_view name, X86Opcode& opcode) {
+	for (int i = 1; i < X86_OPCODE_COUNTER; i++) {
+		if (i != X86_SETCC && i != X86_JCC && name == opcode_names[i]) {
+			opcode = (X86Opcode) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static const char* size_name(uint8_t size) {
+	switch (size) {
+		case 1: return "byte ";
+		case 4: return "dword ";
+		case 8: return "qword ";
+		default: return "";
+	}
+}
+
+static void print_operand(const X86_Operand& operand, OutputSink& out) {
+	static_assert(X86_OPERAND_COUNTER == 7, "Unhandled X86_OPERAND_COUNTER on print_operand at x86.cpp");
+	switch (operand.kind) {
+		case X86_OPERAND_REGISTER:
+			out.append(register_names[operand.size == 1 ? 0 : operand.size == 4 ? 1 : 2][operand.reg]);
+			break;
+		case X86_OPERAND_IMMEDIATE:
+			out.append_number(operand.imm);
+			break;
+		case X86_OPERAND_MEMORY:
+			out.append(size_name(operand.size)).append("[").append(register_names[2][operand.reg]);
+			if (operand.scale != 0) {
+				out.append(" + ").append(register_names[2][operand.index]).append("*").append_number(operand.scale);
+			}
+			if (operand.imm > 0) {
+				out.append(" + ").append_number(operand.imm);
+			} else if (operand.imm < 0) {
+				// displacements are 32 bits, negating them never overflows
+				out.append(" - ").append_number(-operand.imm);
+			}
+			out.append("]");
+			break;
+		case X86_OPERAND_STRING:
+			out.append("V").append_number(operand.imm);
+			break;
+		case X86_OPERAND_LABEL:
+			if (operand.imm == X86_RETURN_LABEL) {
+				out.append(".retpoint");
+			} else {
+				out.append(".L").append_number(operand.imm);
+			}
+			break;
+		case X86_OPERAND_FUNCTION:
+			out.append(Interner::name(operand.symbol));
+			break;
+		default:
+			break;
+	}
+}
+
+void x86_print(const std::vector<X86_Instruction>& code, OutputSink& out) {
+	for (const X86_Instruction& instruction: code) {
+		if (instruction.opcode == X86_LABEL) {
+			print_operand(instruction.a, out);
+			out.append(":\n");
+			continue;
+		}
+
+		out.append("\t").append(opcode_names[instruction.opcode]);
+		if (instruction.opcode == X86_SETCC || instruction.opcode == X86_JCC) {
+			out.append(condition_names[instruction.condition]);
+		}
+		if (instruction.a.kind != X86_OPERAND_NONE) {
+			out.append(' ');
+			print_operand(instruction.a, out);
+		}
+		if (instruction.b.kind != X86_OPERAND_NONE) {
+			out.append(", ");
+			print_operand(instruction.b, out);
+		}
+		bool shifts = instruction.opcode == X86_SHL || instruction.opcode == X86_SAR || instruction.opcode == X86_SHR;
+		if (shifts && instruction.b.kind == X86_OPERAND_NONE) {
+			out.append(", cl");
+		}
+		out.append('\n');
+	}
+}
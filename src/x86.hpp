@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "interner.hpp"
+#include "output_sink.hpp"
+
+// General purpose registers, in encoding order
+typedef enum {
+	X86_RAX, X86_RCX, X86_RDX, X86_RBX, X86_RSP, X86_RBP, X86_RSI, X86_RDI,
+	X86_R8, X86_R9, X86_R10, X86_R11, X86_R12, X86_R13, X86_R14, X86_R15,
+	X86_REGISTER_COUNT
+} X86Register;
+
+typedef enum {
+	X86_CC_L, X86_CC_G, X86_CC_E, X86_CC_NE, X86_CC_LE, X86_CC_GE,
+	X86_CC_COUNTER
+} X86Condition;
+
+typedef enum {
+	X86_OPERAND_NONE,
+	X86_OPERAND_REGISTER, // reg, size bytes of it
+	X86_OPERAND_IMMEDIATE, // imm
+	X86_OPERAND_MEMORY, // size bytes at [reg + index * scale + imm], size 0 for lea
+	X86_OPERAND_STRING, // address of the string literal imm
+	X86_OPERAND_LABEL, // block imm of the function, X86_RETURN_LABEL for its epilogue
+	X86_OPERAND_FUNCTION, // symbol
+	X86_OPERAND_COUNTER
+} X86OperandKind;
+
+#define X86_RETURN_LABEL -1
+
+typedef struct {
+	X86OperandKind kind;
+	// bytes read or written: 1, 4 or 8
+	uint8_t size;
+	X86Register reg;
+	// scaled index of memory operands, scale 0 without one
+	X86Register index;
+	uint8_t scale;
+	int64_t imm;
+	Symbol symbol;
+} X86_Operand;
+
+typedef enum {
+	X86_LABEL, // a: where jumps to a land, a function starts on its symbol
+	X86_MOV,
+	X86_MOVSXD,
+	X86_MOVZX,
+	X86_LEA,
+	X86_ADD,
+	X86_SUB,
+	X86_IMUL, // without b: rdx:rax = rax * a
+	X86_AND,
+	X86_OR,
+	X86_XOR,
+	X86_NEG,
+	X86_NOT,
+	X86_SHL, // shifts by b, by cl without it
+	X86_SAR,
+	X86_SHR,
+	X86_CQO,
+	X86_IDIV,
+	X86_CMP,
+	X86_TEST,
+	X86_SETCC,
+	X86_JMP,
+	X86_JCC,
+	X86_CALL,
+	X86_RET,
+	X86_PUSH,
+	X86_POP,
+	// only used by the builtin routines and the entry point
+	X86_CDQE,
+	X86_SYSCALL,
+	X86_LEAVE,
+	X86_NOP,
+	X86_OPCODE_COUNTER
+} X86Opcode;
+
+/**
+ * @brief Machine instruction as the backend selects it, a is the
+ * destination when there are two operands
+ */
+typedef struct {
+	X86Opcode opcode;
+	X86Condition condition;
+	X86_Operand a;
+	X86_Operand b;
+} X86_Instruction;
+
+X86_Operand x86_register(X86Register reg, uint8_t size = 8);
+X86_Operand x86_immediate(int64_t imm);
+X86_Operand x86_memory(uint8_t size, X86Register base, int64_t displacement = 0);
+X86_Operand x86_string(int64_t index);
+X86_Operand x86_label(int64_t block);
+X86_Operand x86_function(Symbol name);
+
+X86_Instruction x86_instruction(X86Opcode opcode, X86_Operand a = {}, X86_Operand b = {});
+
+/**
+ * @brief Condition true exactly when condition is false
+ */
+X86Condition x86_negate(X86Condition condition);
+
+bool x86_same_operand(const X86_Operand& a, const X86_Operand& b);
+
+/**
+ * @brief Register named name in NASM, of any size
+ * @return whether name is a register
+ */
+bool x86_parse_register(std::string_view name, X86_Operand& operand);
+
+/**
+ * @brief Condition named name after the set and j of setcc and jcc
+ */
+bool x86_parse_condition(std::string_view name, X86Condition& condition);
+
+/**
+ * @brief Opcode of the NASM mnemonic name, setcc and jcc aside
+ */
+bool x86_parse_opcode(std::string_view name, X86Opcode& opcode);
+
+/**
+ * @brief Append the NASM text of the instructions of a function to out
+ */
+void x86_print(const std::vector<X86_Instruction>& code, OutputSink& out);
@@ -0,0 +1,53 @@
+#!/bin/bash
+# Compile and run every tests/*.aka, comparing with tests/<name>.out: what
+# the program prints followed by its exit code, or what the compiler prints
+# and exits with when it has to reject the program.
+#
+# usage: tests/run.sh <compiler> [compiler options...] [--run]
+# Run from the root of the repository, where std/ and builtin/ are. With
+# --run last, programs are run from memory instead of from main.out.
+# Programs get "a b" as arguments and AKATEST=value on the environment.
+# Programs named tail_* run on a 256 KiB stack, their recursion only fits on
+# it when the calls became jumps.
+
+compiler=$1
+shift
+options=("$@")
+run=0
+if [ ${#options[@]} -gt 0 ] && [ "${options[-1]}" == "--run" ]; then
+	run=1
+	unset 'options[-1]'
+fi
+
+failed=0
+for source in tests/*.aka; do
+	name=${source%.aka}
+	stack=unlimited
+	if [[ $(basename "$source") == tail_* ]]; then
+		stack=256
+	fi
+	rm -f main.out
+
+	if [ $run == 1 ]; then
+		output=$( (ulimit -s $stack; AKATEST=value "$compiler" "$source" "${options[@]}" --run a b 2>&1); echo "exit=$?")
+	else
+		output=$("$compiler" "$source" "${options[@]}" 2>&1; echo "exit=$?")
+		if [ -f main.out ]; then
+			output=$( (ulimit -s $stack; AKATEST=value ./main.out a b 2>&1); echo "exit=$?")
+		fi
+	fi
+	# colors of the error messages
+	output=$(printf '%s' "$output" | sed 's/\x1b\[[0-9;]*m//g')
+
+	if [ "$output" != "$(cat "$name.out")" ]; then
+		echo "FAIL $source ${options[*]}"
+		diff <(printf '%s\n' "$output") "$name.out" | head -n 10
+		failed=1
+	fi
+done
+rm -f main.out
+
+if [ $failed == 0 ]; then
+	echo "All tests passed: $compiler $*"
+fi
+exit $failed